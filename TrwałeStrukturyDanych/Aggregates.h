@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+#include <limits>
+
+/// <summary>
+/// Brak agregatu poddrzewa. Drzewo z tym parametrem nie przechowuje agregatow w wezlach.
+/// </summary>
+struct NoAggregate
+{
+	typedef void Summary;
+};
+
+/// <summary>
+/// Projekcja zwracajaca cala wartosc przechowywana w drzewie.
+/// </summary>
+template<class Type>
+struct IdentityProjection
+{
+	typedef Type result_type;
+
+	Type const & operator () (Type const & value) const
+	{
+		return value;
+	}
+};
+
+/// <summary>
+/// Projekcja zwracajaca wartosc wpisu mapy.
+/// </summary>
+template<class Entry>
+struct MappedValue
+{
+	typedef typename Entry::second_type result_type;
+
+	result_type const & operator () (Entry const & entry) const
+	{
+		return entry.second;
+	}
+};
+
+/// <summary>
+/// Monoid sumy. Agregat drzewa musi udostepniac typ Summary oraz statyczne funkcje
+/// identity (element neutralny), lift (agregat pojedynczej wartosci) i combine (laczne zlozenie
+/// agregatu lewej czesci z agregatem prawej czesci).
+/// </summary>
+template<class Type, class Projection = IdentityProjection<Type>>
+struct SumAggregate
+{
+	typedef typename Projection::result_type Summary;
+
+	static Summary identity()
+	{
+		return Summary();
+	}
+
+	static Summary lift(Type const & value)
+	{
+		return Projection()(value);
+	}
+
+	static Summary combine(Summary const & lhs, Summary const & rhs)
+	{
+		return lhs + rhs;
+	}
+};
+
+/// <summary>
+/// Monoid minimum dla typow arytmetycznych.
+/// </summary>
+template<class Type, class Projection = IdentityProjection<Type>>
+struct MinAggregate
+{
+	typedef typename Projection::result_type Summary;
+
+	static Summary identity()
+	{
+		return std::numeric_limits<Summary>::max();
+	}
+
+	static Summary lift(Type const & value)
+	{
+		return Projection()(value);
+	}
+
+	static Summary combine(Summary const & lhs, Summary const & rhs)
+	{
+		return std::min(lhs, rhs);
+	}
+};
+
+/// <summary>
+/// Monoid maksimum dla typow arytmetycznych.
+/// </summary>
+template<class Type, class Projection = IdentityProjection<Type>>
+struct MaxAggregate
+{
+	typedef typename Projection::result_type Summary;
+
+	static Summary identity()
+	{
+		return std::numeric_limits<Summary>::lowest();
+	}
+
+	static Summary lift(Type const & value)
+	{
+		return Projection()(value);
+	}
+
+	static Summary combine(Summary const & lhs, Summary const & rhs)
+	{
+		return std::max(lhs, rhs);
+	}
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+typedef std::vector<unsigned char> ArchiveBytes;
+
+/// <summary>
+/// Zapisuje liczbe bez znaku w kodowaniu o zmiennej dlugosci: po 7 bitow na bajt, najstarszy bit oznacza kontynuacje.
+/// </summary>
+/// <param name="bytes">Bufor wyjsciowy.</param>
+/// <param name="value">Liczba.</param>
+inline void writeVarint(ArchiveBytes & bytes, std::uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		bytes.push_back(static_cast<unsigned char>(value | 0x80));
+		value >>= 7;
+	}
+	bytes.push_back(static_cast<unsigned char>(value));
+}
+
+/// <summary>
+/// Odczytuje liczbe zapisana przez writeVarint i przesuwa pozycje za nia.
+/// </summary>
+/// <param name="position">Pozycja w buforze.</param>
+/// <returns></returns>
+inline std::uint64_t readVarint(unsigned char const * & position)
+{
+	std::uint64_t value = 0;
+	int shift = 0;
+	while (*position & 0x80)
+	{
+		value |= std::uint64_t(*position++ & 0x7f) << shift;
+		shift += 7;
+	}
+	value |= std::uint64_t(*position++) << shift;
+	return value;
+}
+
+/// <summary>
+/// Kodowanie kluczy archiwum historii. Kazdy klucz zapisywany jest wzgledem poprzedniego klucza bloku,
+/// dlatego kodowanie jest zdefiniowane tylko dla typow, ktore da sie tak skompresowac.
+/// </summary>
+template<class Type, class = void>
+struct ArchiveCodec;
+
+/// <summary>
+/// Liczby calkowite zapisywane sa jako roznica wzgledem poprzedniego klucza w kodowaniu zygzakowym,
+/// wiec sasiednie klucze zajmuja zwykle jeden lub dwa bajty.
+/// </summary>
+template<class Type>
+struct ArchiveCodec<Type, typename std::enable_if<std::is_integral<Type>::value>::type>
+{
+	static void encode(Type const & previous, Type const & value, ArchiveBytes & bytes)
+	{
+		std::int64_t delta = static_cast<std::int64_t>(static_cast<std::uint64_t>(value) - static_cast<std::uint64_t>(previous));
+		writeVarint(bytes, (static_cast<std::uint64_t>(delta) << 1) ^ static_cast<std::uint64_t>(delta >> 63));
+	}
+
+	static Type decode(Type const & previous, unsigned char const * & position)
+	{
+		std::uint64_t zigzag = readVarint(position);
+		std::uint64_t delta = (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+		return static_cast<Type>(static_cast<std::uint64_t>(previous) + delta);
+	}
+};
+
+/// <summary>
+/// Napisy zapisywane sa z kodowaniem przedrostkowym: dlugosc wspolnego przedrostka z poprzednim kluczem,
+/// dlugosc i znaki pozostalej czesci.
+/// </summary>
+template<>
+struct ArchiveCodec<std::string>
+{
+	static void encode(std::string const & previous, std::string const & value, ArchiveBytes & bytes)
+	{
+		std::size_t common = 0;
+		while (common < previous.size() && common < value.size() && previous[common] == value[common])
+			++common;
+		writeVarint(bytes, common);
+		writeVarint(bytes, value.size() - common);
+		bytes.insert(bytes.end(), value.begin() + common, value.end());
+	}
+
+	static std::string decode(std::string const & previous, unsigned char const * & position)
+	{
+		std::size_t common = static_cast<std::size_t>(readVarint(position));
+		std::size_t suffix = static_cast<std::size_t>(readVarint(position));
+		std::string value(previous, 0, common);
+		value.append(reinterpret_cast<char const *>(position), suffix);
+		position += suffix;
+		return value;
+	}
+};
+
+/// <summary>
+/// Okresla, czy dla typu zdefiniowane jest kodowanie archiwum historii.
+/// </summary>
+template<class Type>
+struct IsArchivable : std::integral_constant<bool, std::is_integral<Type>::value || std::is_same<Type, std::string>::value>
+{
+};
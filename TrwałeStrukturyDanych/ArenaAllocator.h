@@ -0,0 +1,253 @@
+#pragma once
+#include "MappedArena.h"
+#include "SharedValue.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/// <summary>
+/// Niezmienny napis, ktorego znaki umieszczone sa w stercie pliku. Sam obiekt jest trywialnie kopiowalny
+/// (wskaznik i dlugosc), dlatego moze byc wartoscia drzewa zapisanego w pliku. Napis utworzony z std::string
+/// lub tablicy znakow jedynie na nie wskazuje - znaki sa kopiowane do pliku dopiero przy umieszczaniu
+/// wartosci w drzewie przez <see cref="ArenaValueAllocator"/>.
+/// </summary>
+class MappedString
+{
+	char const * _data;
+	std::size_t _size;
+
+public:
+	MappedString() : _data(nullptr), _size(0)
+	{
+	}
+
+	MappedString(char const * data, std::size_t size) : _data(data), _size(size)
+	{
+	}
+
+	MappedString(std::string const & text) : _data(text.data()), _size(text.size())
+	{
+	}
+
+	char const * data() const
+	{
+		return _data;
+	}
+
+	std::size_t size() const
+	{
+		return _size;
+	}
+
+	std::string str() const
+	{
+		return std::string(_data, _size);
+	}
+
+	int compare(MappedString const & rhs) const
+	{
+		std::size_t common = std::min(_size, rhs._size);
+		int result = common != 0 ? std::memcmp(_data, rhs._data, common) : 0;
+		if (result != 0)
+			return result;
+		return _size < rhs._size ? -1 : _size > rhs._size ? 1 : 0;
+	}
+
+	bool operator < (MappedString const & rhs) const
+	{
+		return compare(rhs) < 0;
+	}
+
+	bool operator == (MappedString const & rhs) const
+	{
+		return _size == rhs._size && (_size == 0 || std::memcmp(_data, rhs._data, _size) == 0);
+	}
+
+	bool operator != (MappedString const & rhs) const
+	{
+		return !(*this == rhs);
+	}
+
+	friend std::ostream & operator << (std::ostream & out, MappedString const & text)
+	{
+		return out.write(text._data, text._size);
+	}
+};
+
+/// <summary>
+/// Sposob umieszczania wartosci w stercie pliku. Wartosci trywialnie kopiowalne kopiowane sa bajt po bajcie,
+/// a inne typy nie moga byc przechowywane w pliku, bo ich wskazniki prowadzilyby poza niego.
+/// </summary>
+template<class Type>
+struct ArenaValue
+{
+	static_assert(std::is_trivially_copyable<Type>::value, "Only trivially copyable values and MappedString can be stored in a mapped arena");
+
+	static void construct(ArenaHeap *, Type * p, Type const & value)
+	{
+		new ((void*)p) Type(value);
+	}
+
+	static void destroy(ArenaHeap *, Type *)
+	{
+	}
+};
+
+/// <summary>
+/// Znaki napisu kopiowane sa do sterty pliku i zwalniane razem z wartoscia.
+/// </summary>
+template<>
+struct ArenaValue<MappedString>
+{
+	static void construct(ArenaHeap * heap, MappedString * p, MappedString const & value)
+	{
+		char * data = nullptr;
+		if (value.size() != 0)
+		{
+			data = static_cast<char*>(heap != nullptr ? heap->allocate(value.size()) : ::operator new(value.size()));
+			if (data == nullptr)
+				throw std::bad_alloc();
+			std::memcpy(data, value.data(), value.size());
+		}
+		new ((void*)p) MappedString(data, value.size());
+	}
+
+	static void destroy(ArenaHeap * heap, MappedString * p)
+	{
+		if (p->size() == 0)
+			return;
+		char * data = const_cast<char*>(p->data());
+		if (heap != nullptr)
+			heap->deallocate(data, p->size());
+		else
+			::operator delete(data);
+	}
+};
+
+/// <summary>
+/// Znaki napisu kopiowane sa przy kazdym umieszczeniu wartosci, dlatego kopie wezlow wspoldziela napis.
+/// </summary>
+template<>
+struct IsSharedValue<MappedString> : std::true_type
+{
+};
+
+/// <summary>
+/// Alokator standardowy przydzielajacy pamiec ze sterty pliku. Przechowuje jedynie wskaznik na sterte,
+/// ktora lezy w pliku pod stalym adresem, dlatego kontenery z tym alokatorem moga same lezec w pliku.
+/// Alokator bez sterty korzysta z operatora new, co pozwala tworzyc takie drzewa rowniez w zwyklej pamieci.
+/// </summary>
+template<class T>
+class ArenaAllocator
+{
+	template<class U>
+	friend class ArenaAllocator;
+
+	ArenaHeap * _heap;
+
+public:
+	typedef T value_type;
+
+	template<class U>
+	struct rebind
+	{
+		typedef ArenaAllocator<U> other;
+	};
+
+	ArenaAllocator() noexcept : _heap(nullptr)
+	{
+	}
+
+	explicit ArenaAllocator(ArenaHeap * heap) noexcept : _heap(heap)
+	{
+	}
+
+	template<class U>
+	ArenaAllocator(ArenaAllocator<U> const & other) noexcept : _heap(other._heap)
+	{
+	}
+
+	T * allocate(std::size_t n)
+	{
+		if (_heap == nullptr)
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+		void * p = _heap->allocate(n * sizeof(T));
+		if (p == nullptr)
+			throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T * p, std::size_t n)
+	{
+		if (_heap == nullptr)
+			::operator delete(p);
+		else
+			_heap->deallocate(p, n * sizeof(T));
+	}
+
+	template<class U, class... Args>
+	void construct(U * p, Args &&... args)
+	{
+		new ((void*)p) U(std::forward<Args>(args)...);
+	}
+
+	template<class U>
+	void destroy(U * p)
+	{
+		p->~U();
+	}
+
+	ArenaHeap * heap() const
+	{
+		return _heap;
+	}
+
+	template<class U>
+	bool operator == (ArenaAllocator<U> const & rhs) const
+	{
+		return _heap == rhs._heap;
+	}
+
+	template<class U>
+	bool operator != (ArenaAllocator<U> const & rhs) const
+	{
+		return _heap != rhs._heap;
+	}
+};
+
+/// <summary>
+/// Alokator wartosci drzewa w stercie pliku. Umieszcza i niszczy wartosci zgodnie z <see cref="ArenaValue"/>.
+/// </summary>
+template<class T>
+class ArenaValueAllocator : public ArenaAllocator<T>
+{
+public:
+	template<class U>
+	struct rebind
+	{
+		typedef ArenaValueAllocator<U> other;
+	};
+
+	ArenaValueAllocator() noexcept
+	{
+	}
+
+	explicit ArenaValueAllocator(ArenaHeap * heap) noexcept : ArenaAllocator<T>(heap)
+	{
+	}
+
+	void construct(T * p, T const & value)
+	{
+		ArenaValue<T>::construct(this->heap(), p, value);
+	}
+
+	void destroy(T * p)
+	{
+		ArenaValue<T>::destroy(this->heap(), p);
+	}
+};
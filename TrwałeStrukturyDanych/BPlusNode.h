@@ -0,0 +1,122 @@
+#pragma once
+#include <algorithm>
+#include <climits>
+
+/// <summary>
+/// Domyslna pojemnosc wezla B+drzewa: tyle kluczy, ile miesci sie w kilku liniach pamieci podrecznej, ale nie mniej niz 16.
+/// </summary>
+template<class Type>
+struct BPlusCapacity
+{
+	static const int value = 256 / sizeof(Type) < 16 ? 16 : static_cast<int>(256 / sizeof(Type));
+};
+
+/// <summary>
+/// Wezel trwalego B+drzewa. Kazdy wpis ma przedzial wersji [born, died), w ktorych istnieje,
+/// wiec wezel jest grubym wezlem z dziennikiem zmian na poziomie calego wezla: wstawienie dopisuje wpis,
+/// a usuniecie zamyka jego przedzial. Wpisy sa posortowane wg kluczy niezaleznie od wersji.
+/// W lisciach wpisy sa wartosciami, w wezlach wewnetrznych kluczami rozdzielajacymi z dzieckiem.
+/// </summary>
+template<class Type, int Capacity>
+class BPlusNode
+{
+	typedef BPlusNode<Type, Capacity>* NodePtr;
+
+	bool _leaf;
+	int _count;
+	Type _keys[Capacity];
+	int _born[Capacity];
+	int _died[Capacity];
+	NodePtr _children[Capacity];
+
+public:
+	/// <summary>
+	/// Koniec przedzialu wpisu, ktory istnieje w najnowszej wersji
+	/// </summary>
+	static const int LIVE = INT_MAX;
+
+	static const int CAPACITY = Capacity;
+
+	explicit BPlusNode(bool leaf) : _leaf(leaf), _count(0)
+	{
+	}
+
+	bool isLeaf() const
+	{
+		return _leaf;
+	}
+
+	int getCount() const
+	{
+		return _count;
+	}
+
+	bool isFull() const
+	{
+		return _count == Capacity;
+	}
+
+	Type const * getKeys() const
+	{
+		return _keys;
+	}
+
+	Type const & getKey(int index) const
+	{
+		return _keys[index];
+	}
+
+	NodePtr getChild(int index) const
+	{
+		return _children[index];
+	}
+
+	/// <summary>
+	/// Sprawdza, czy wpis istnieje we wskazanej wersji.
+	/// </summary>
+	/// <param name="index">Indeks wpisu.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	bool isAlive(int index, int version) const
+	{
+		return _born[index] <= version && version < _died[index];
+	}
+
+	/// <summary>
+	/// Zamyka przedzial wersji wpisu.
+	/// </summary>
+	/// <param name="index">Indeks wpisu.</param>
+	/// <param name="version">Pierwsza wersja, w ktorej wpis nie istnieje.</param>
+	void kill(int index, int version)
+	{
+		_died[index] = version;
+	}
+
+	/// <summary>
+	/// Wstawia wpis na wskazanej pozycji, przesuwajac dalsze wpisy. Wezel nie moze byc pelny.
+	/// </summary>
+	/// <param name="index">Pozycja zachowujaca porzadek kluczy.</param>
+	/// <param name="key">Klucz.</param>
+	/// <param name="child">Dziecko, nullptr w lisciu.</param>
+	/// <param name="version">Wersja, od ktorej wpis istnieje.</param>
+	void insert(int index, Type const & key, NodePtr child, int version)
+	{
+		std::move_backward(_keys + index, _keys + _count, _keys + _count + 1);
+		std::copy_backward(_born + index, _born + _count, _born + _count + 1);
+		std::copy_backward(_died + index, _died + _count, _died + _count + 1);
+		std::copy_backward(_children + index, _children + _count, _children + _count + 1);
+		_keys[index] = key;
+		_born[index] = version;
+		_died[index] = LIVE;
+		_children[index] = child;
+		++_count;
+	}
+
+	/// <summary>
+	/// Dopisuje wpis na koncu wezla.
+	/// </summary>
+	void append(Type const & key, NodePtr child, int version)
+	{
+		insert(_count, key, child, version);
+	}
+};
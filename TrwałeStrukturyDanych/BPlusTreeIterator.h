@@ -0,0 +1,132 @@
+#pragma once
+#include "NodeStack.h"
+#include <cstddef>
+#include <iterator>
+
+/// <summary>
+/// Iterator jednokierunkowy po wskazanej wersji trwalego B+drzewa.
+/// Liscie nie sa ze soba polaczone, bo kazda wersja ma inny uklad lisci, dlatego iterator
+/// przechowuje sciezke od korzenia jako pary wezel - indeks wpisu.
+/// </summary>
+template<class Type, class NodeType>
+class BPlusTreeIterator
+{
+	typedef NodeType* NodePtr;
+
+	/// <summary>
+	/// Wezel na sciezce i indeks biezacego wpisu w nim
+	/// </summary>
+	struct Frame
+	{
+		NodePtr node;
+		int index;
+	};
+
+	NodeStack<Frame, 16> stack;
+	int version;
+
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef Type value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef Type const * pointer;
+	typedef Type const & reference;
+
+	/// <summary>
+	/// Tworzy iterator konca.
+	/// </summary>
+	BPlusTreeIterator() : version(0)
+	{
+	}
+
+	/// <summary>
+	/// Tworzy iterator na pierwszy element wskazanej wersji.
+	/// </summary>
+	/// <param name="root">Korzen wersji.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	BPlusTreeIterator(NodePtr root, int version) : version(version)
+	{
+		if (root == nullptr)
+			return;
+		push(root, -1);
+		advance();
+	}
+
+	/// <summary>
+	/// Tworzy iterator ze sciezki zapisanej podczas wyszukiwania. Ostatni wpis sciezki wskazuje element w lisciu.
+	/// </summary>
+	/// <param name="nodes">Wezly sciezki od korzenia.</param>
+	/// <param name="indices">Indeksy wpisow w wezlach sciezki.</param>
+	/// <param name="depth">Dlugosc sciezki.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	BPlusTreeIterator(NodePtr const * nodes, int const * indices, int depth, int version) : version(version)
+	{
+		for (int i = 0; i < depth; ++i)
+			push(nodes[i], indices[i]);
+	}
+
+	reference operator * () const
+	{
+		Frame frame = stack.top();
+		return frame.node->getKey(frame.index);
+	}
+
+	pointer operator -> () const
+	{
+		return &**this;
+	}
+
+	BPlusTreeIterator & operator ++ ()
+	{
+		advance();
+		return *this;
+	}
+
+	BPlusTreeIterator operator ++ (int)
+	{
+		BPlusTreeIterator it(*this);
+		advance();
+		return it;
+	}
+
+	bool operator == (BPlusTreeIterator const & rhs) const
+	{
+		if (stack.empty() || rhs.stack.empty())
+			return stack.empty() && rhs.stack.empty();
+		Frame lhsTop = stack.top(), rhsTop = rhs.stack.top();
+		return lhsTop.node == rhsTop.node && lhsTop.index == rhsTop.index;
+	}
+
+	bool operator != (BPlusTreeIterator const & rhs) const
+	{
+		return !(*this == rhs);
+	}
+
+private:
+	void push(NodePtr node, int index)
+	{
+		Frame frame = { node, index };
+		stack.push(frame);
+	}
+
+	/// <summary>
+	/// Przechodzi do nastepnego wpisu istniejacego w wersji iteratora, schodzac do liscia.
+	/// </summary>
+	void advance()
+	{
+		while (!stack.empty())
+		{
+			Frame frame = stack.top();
+			stack.pop();
+			int next = frame.index + 1;
+			while (next < frame.node->getCount() && !frame.node->isAlive(next, version))
+				++next;
+			if (next == frame.node->getCount())
+				continue;
+			push(frame.node, next);
+			if (frame.node->isLeaf())
+				return;
+			push(frame.node->getChild(next), -1);
+		}
+	}
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+/// <summary>
+/// Odcisk ciagu wartosci w porzadku drzewa: wielomianowy skrot modulo liczba pierwsza 2^61 - 1
+/// wraz z potega podstawy odpowiadajaca dlugosci ciagu. Odcisk ciagu zalezy tylko od jego elementow i ich
+/// kolejnosci, a nie od ksztaltu drzewa, dlatego rowne zbiory maja rowne odciski w kazdej wersji i w kazdym drzewie.
+/// Rozne zbiory maja rowne odciski z prawdopodobienstwem rzedu n / 2^61.
+/// </summary>
+struct Fingerprint
+{
+	static const std::uint64_t MODULUS = (std::uint64_t(1) << 61) - 1;
+	static const std::uint64_t BASE = 0x1F3D5B79A2C4E687ull % MODULUS;
+
+	std::uint64_t hash;
+	std::uint64_t power;
+
+	bool operator == (Fingerprint const & rhs) const
+	{
+		return hash == rhs.hash && power == rhs.power;
+	}
+
+	bool operator != (Fingerprint const & rhs) const
+	{
+		return !(*this == rhs);
+	}
+
+	static std::uint64_t reduce(std::uint64_t value)
+	{
+		value = (value & MODULUS) + (value >> 61);
+		return value >= MODULUS ? value - MODULUS : value;
+	}
+
+	/// <summary>
+	/// Mnozy modulo 2^61 - 1 liczby mniejsze od modulu, bez arytmetyki 128-bitowej:
+	/// czynniki dzielone sa na polowki, a 2^61 przystaje do jedynki.
+	/// </summary>
+	static std::uint64_t multiply(std::uint64_t lhs, std::uint64_t rhs)
+	{
+		std::uint64_t const LOW31 = (std::uint64_t(1) << 31) - 1;
+		std::uint64_t const LOW30 = (std::uint64_t(1) << 30) - 1;
+		std::uint64_t lhsHigh = lhs >> 31, lhsLow = lhs & LOW31;
+		std::uint64_t rhsHigh = rhs >> 31, rhsLow = rhs & LOW31;
+		std::uint64_t middle = lhsHigh * rhsLow + lhsLow * rhsHigh;
+		std::uint64_t result = ((lhsHigh * rhsHigh) << 1) + (middle >> 30) + ((middle & LOW30) << 31) + lhsLow * rhsLow;
+		return reduce(result);
+	}
+};
+
+/// <summary>
+/// Monoid odciskow (patrz Aggregates.h). Drzewo z tym agregatem przechowuje w kazdym wezle odcisk poddrzewa,
+/// wiec odcisk wersji jest agregatem korzenia, a odcisk przedzialu kluczy wyznaczany jest w czasie O(glebokosci).
+/// Hash musi dawac rowne skroty dla wartosci rownych; dla map skrot obejmuje klucz i wartosc (EntryHash).
+/// </summary>
+template<class Type, class Hash = std::hash<Type>>
+struct FingerprintAggregate
+{
+	typedef Fingerprint Summary;
+
+	static Summary identity()
+	{
+		Summary summary = { 0, 1 };
+		return summary;
+	}
+
+	static Summary lift(Type const & value)
+	{
+		// mieszanie rozprasza skroty bliskie sobie, np. identycznosc std::hash dla liczb
+		std::uint64_t hash = static_cast<std::uint64_t>(Hash()(value)) * 0x9E3779B97F4A7C15ull;
+		Summary summary = { Fingerprint::reduce((hash ^ (hash >> 29)) & ~(std::uint64_t(1) << 63)), Fingerprint::BASE };
+		return summary;
+	}
+
+	static Summary combine(Summary const & lhs, Summary const & rhs)
+	{
+		Summary summary = { Fingerprint::reduce(Fingerprint::multiply(lhs.hash, rhs.power) + rhs.hash),
+			Fingerprint::multiply(lhs.power, rhs.power) };
+		return summary;
+	}
+};
+
+/// <summary>
+/// Skrot wpisu mapy obejmujacy klucz i wartosc.
+/// </summary>
+template<class Entry>
+struct EntryHash
+{
+	std::size_t operator () (Entry const & entry) const
+	{
+		std::size_t key = std::hash<typename std::remove_const<typename Entry::first_type>::type>()(entry.first);
+		std::size_t value = std::hash<typename Entry::second_type>()(entry.second);
+		return key ^ (value + 0x9E3779B9 + (key << 6) + (key >> 2));
+	}
+};
@@ -0,0 +1,232 @@
+#pragma once
+#include "ThreeWayOrder.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Funkcja skrotu zgodna z funktorem porzadku: wartosci rownowazne w porzadku musza miec rowny skrot.
+/// Wersja ogolna nie zna takiej funkcji. Funktor porzadku deklaruje ja metoda hash.
+/// </summary>
+template<class OrderFunctor, class Key, class = void>
+struct OrderHash
+{
+	static const bool HASHABLE = false;
+};
+
+template<class OrderFunctor, class Key>
+struct OrderHash<OrderFunctor, Key,
+	decltype(void(std::declval<OrderFunctor const &>().hash(std::declval<Key const &>())))>
+{
+	static const bool HASHABLE = true;
+
+	static std::size_t hash(OrderFunctor const & orderFunctor, Key const & key)
+	{
+		return orderFunctor.hash(key);
+	}
+};
+
+/// <summary>
+/// Skrot wartosci drzewa. Bez metody hash w funktorze porzadku uzywany jest std::hash, o ile jest zdefiniowany;
+/// jest on zgodny z porzadkiem, w ktorym rownowaznosc oznacza rownosc, np. std::less.
+/// </summary>
+template<class OrderFunctor, class Type, class = void>
+struct StandardHash
+{
+	static const bool HASHABLE = false;
+};
+
+template<class OrderFunctor, class Type>
+struct StandardHash<OrderFunctor, Type,
+	decltype(void(std::declval<std::hash<Type> const &>()(std::declval<Type const &>())))>
+{
+	static const bool HASHABLE = true;
+
+	static std::size_t hash(OrderFunctor const &, Type const & value)
+	{
+		return std::hash<Type>()(value);
+	}
+};
+
+template<class OrderFunctor, class Type>
+struct ValueHash : std::conditional<OrderHash<OrderFunctor, Type>::HASHABLE,
+	OrderHash<OrderFunctor, Type>, StandardHash<OrderFunctor, Type>>::type
+{
+};
+
+/// <summary>
+/// Indeks haszujacy aktualnej wersji drzewa: zbior wskaznikow na wartosci w wezlach, wyszukiwanych po kluczu.
+/// Tablica z adresowaniem otwartym i probkowaniem liniowym przechowuje obok wskaznika skrot wartosci,
+/// dlatego wyszukiwanie odczytuje zwykle jedna linie tablicy i wartosc, z ktora skrot sie zgadza.
+/// Usuwanie przesuwa kolejne wpisy wstecz, wiec tablica nie zawiera znacznikow usuniecia.
+/// </summary>
+template<class Type, class OrderFunctor>
+class HeadIndex
+{
+	struct Slot
+	{
+		std::size_t hash;
+		Type const * value;
+	};
+
+	static const std::size_t MIN_CAPACITY = 16;
+
+	OrderFunctor _orderFunctor;
+	std::vector<Slot> _slots;
+	std::size_t _size;
+
+	/// <summary>
+	/// Miesza bity skrotu, bo std::hash dla liczb calkowitych jest zwykle identycznoscia.
+	/// </summary>
+	static std::size_t mix(std::size_t hash)
+	{
+		std::uint64_t mixed = static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+		return static_cast<std::size_t>(mixed ^ (mixed >> 32));
+	}
+
+	/// <summary>
+	/// Skrot kluczy, ktorych nie mozna wyszukiwac w indeksie. Drzewo nie prowadzi wtedy indeksu ani go nie czyta.
+	/// </summary>
+	struct NoHash
+	{
+		template<class Key>
+		static std::size_t hash(OrderFunctor const &, Key const &)
+		{
+			return 0;
+		}
+	};
+
+	template<class Key>
+	struct Hasher : std::conditional<std::is_same<Key, Type>::value, ValueHash<OrderFunctor, Type>, OrderHash<OrderFunctor, Key>>::type
+	{
+	};
+
+	template<class Key>
+	static std::size_t hashOf(OrderFunctor const & orderFunctor, Key const & key)
+	{
+		return mix(std::conditional<Hasher<Key>::HASHABLE, Hasher<Key>, NoHash>::type::hash(orderFunctor, key));
+	}
+
+	std::size_t mask() const
+	{
+		return _slots.size() - 1;
+	}
+
+	template<class Key>
+	std::size_t position(Key const & key, std::size_t hash) const
+	{
+		std::size_t i = hash & mask();
+		while (_slots[i].value != nullptr && (_slots[i].hash != hash || compareWith(_orderFunctor, key, *_slots[i].value) != 0))
+			i = (i + 1) & mask();
+		return i;
+	}
+
+	void grow()
+	{
+		std::vector<Slot> slots(_slots.empty() ? MIN_CAPACITY : 2 * _slots.size(), Slot{ 0, nullptr });
+		slots.swap(_slots);
+		for (Slot const & slot : slots)
+		{
+			if (slot.value == nullptr)
+				continue;
+			std::size_t i = slot.hash & mask();
+			while (_slots[i].value != nullptr)
+				i = (i + 1) & mask();
+			_slots[i] = slot;
+		}
+	}
+
+public:
+	/// <summary>
+	/// Okresla, czy klucz mozna wyszukiwac w indeksie.
+	/// </summary>
+	template<class Key>
+	struct Hashable : std::integral_constant<bool, Hasher<Key>::HASHABLE>
+	{
+	};
+
+	HeadIndex() : _size(0)
+	{
+	}
+
+	/// <summary>
+	/// Wyszukuje wartosc rownowazna kluczowi.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <returns>Wskaznik na wartosc albo nullptr, jezeli jej nie ma.</returns>
+	template<class Key>
+	Type const * find(Key const & key) const
+	{
+		if (_size == 0)
+			return nullptr;
+		return _slots[position(key, hashOf(_orderFunctor, key))].value;
+	}
+
+	/// <summary>
+	/// Zapisuje wartosc, zastepujac wskaznik na wartosc rownowazna, jezeli juz jest w indeksie.
+	/// </summary>
+	/// <param name="value">Wskaznik na wartosc w wezle aktualnej wersji.</param>
+	void assign(Type const * value)
+	{
+		// zapelnienie tablicy nie przekracza trzech czwartych
+		if (4 * (_size + 1) > 3 * _slots.size())
+			grow();
+		std::size_t hash = hashOf(_orderFunctor, *value);
+		std::size_t i = position(*value, hash);
+		if (_slots[i].value == nullptr)
+			++_size;
+		_slots[i] = Slot{ hash, value };
+	}
+
+	/// <summary>
+	/// Usuwa wartosc rownowazna podanej.
+	/// </summary>
+	/// <param name="value">Wartosc.</param>
+	void erase(Type const & value)
+	{
+		if (_size == 0)
+			return;
+		std::size_t i = position(value, hashOf(_orderFunctor, value));
+		if (_slots[i].value == nullptr)
+			return;
+		--_size;
+		// kolejne wpisy ciagu przesuwane sa na zwolnione miejsce, jezeli nie leza na swojej pozycji poczatkowej lub przed nia
+		for (std::size_t j = (i + 1) & mask(); _slots[j].value != nullptr; j = (j + 1) & mask())
+		{
+			std::size_t home = _slots[j].hash & mask();
+			if (((j - home) & mask()) >= ((j - i) & mask()))
+			{
+				_slots[i] = _slots[j];
+				i = j;
+			}
+		}
+		_slots[i] = Slot{ 0, nullptr };
+	}
+
+	void clear()
+	{
+		_slots.clear();
+		_size = 0;
+	}
+
+	/// <summary>
+	/// Zastepuje zawartosc indeksu podanymi wartosciami.
+	/// </summary>
+	/// <param name="first">Poczatek wartosci, np. iterator wersji drzewa.</param>
+	/// <param name="last">Koniec wartosci.</param>
+	template<class Iterator>
+	void assign(Iterator first, Iterator last)
+	{
+		clear();
+		for (; first != last; ++first)
+			assign(&*first);
+	}
+
+	std::size_t size() const
+	{
+		return _size;
+	}
+};
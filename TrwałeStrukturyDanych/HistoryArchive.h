@@ -0,0 +1,341 @@
+#pragma once
+#include "ArchiveCodec.h"
+#include "HistoryArchiveIterator.h"
+#include "LifetimeIndex.h"
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+/// <summary>
+/// Skompresowane archiwum starych wersji drzewa, tylko do odczytu.
+/// Zamiast wezli kazdej wersji przechowuje posortowane klucze wraz z przedzialami wersji, w ktorych istnialy.
+/// Klucze podzielone sa na bloki po BLOCK_SIZE; pierwszy klucz bloku zapisany jest wprost i sluzy do wyszukiwania
+/// binarnego, a pozostale klucze oraz przedzialy sa kodowane roznicowo (patrz ArchiveCodec.h).
+/// Bloki rozpakowywane sa dopiero przy odczycie, ostatnio rozpakowany blok jest zapamietywany.
+/// Wyszukiwanie kosztuje O(log b + BLOCK_SIZE), a iteracja przechodzi po wszystkich kluczach archiwum.
+/// </summary>
+template<class Type, class OrderFunctor = std::less<Type>>
+class HistoryArchive
+{
+public:
+	typedef std::vector<VersionRange> Ranges;
+	typedef HistoryArchiveIterator<Type, HistoryArchive> iterator;
+
+	/// <summary>
+	/// Rozpakowany blok archiwum. Przedzialy klucza i-tego to ranges[ends[i - 1]] do ranges[ends[i]].
+	/// </summary>
+	struct DecodedBlock
+	{
+		int index;
+		std::vector<Type> keys;
+		std::vector<std::size_t> ends;
+		Ranges ranges;
+
+		Ranges::const_iterator rangesBegin(std::size_t i) const
+		{
+			return ranges.begin() + (i == 0 ? 0 : ends[i - 1]);
+		}
+
+		Ranges::const_iterator rangesEnd(std::size_t i) const
+		{
+			return ranges.begin() + ends[i];
+		}
+
+		bool isAlive(std::size_t i, int version) const
+		{
+			for (auto it = rangesBegin(i), last = rangesEnd(i); it != last && it->from <= version; ++it)
+				if (version < it->to)
+					return true;
+			return false;
+		}
+	};
+
+private:
+	friend iterator;
+
+	typedef ArchiveCodec<Type> Codec;
+
+	/// <summary>
+	/// Liczba kluczy w bloku
+	/// </summary>
+	static const int BLOCK_SIZE = 64;
+
+	struct Block
+	{
+		Type firstKey;
+		std::size_t offset;
+		int count;
+	};
+
+	std::vector<Block> _blocks;
+	ArchiveBytes _bytes;
+
+	/// <summary>
+	/// Pierwsza wersja, ktora nie nalezy do archiwum
+	/// </summary>
+	int _version;
+
+	/// <summary>
+	/// Ostatni klucz dopisany do archiwum
+	/// </summary>
+	Type _last;
+
+	OrderFunctor orderFunctor;
+
+public:
+	HistoryArchive() : _version(0)
+	{
+	}
+
+	/// <summary>
+	/// Dopisuje klucz wraz z przedzialami wersji. Klucze musza byc dopisywane rosnaco, a przedzialy skonczone i posortowane.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="first">Pierwszy przedzial.</param>
+	/// <param name="last">Koniec przedzialow.</param>
+	template<class RangeIter>
+	void append(Type const & key, RangeIter first, RangeIter last)
+	{
+		if (_blocks.empty() || _blocks.back().count == BLOCK_SIZE)
+		{
+			Block block = { key, _bytes.size(), 0 };
+			_blocks.push_back(block);
+		}
+		else
+		{
+			Codec::encode(_last, key, _bytes);
+		}
+		++_blocks.back().count;
+		_last = key;
+		writeVarint(_bytes, std::distance(first, last));
+		int previous = 0;
+		for (; first != last; ++first)
+		{
+			writeVarint(_bytes, first->from - previous);
+			writeVarint(_bytes, first->to - first->from);
+			previous = first->to;
+		}
+	}
+
+	/// <summary>
+	/// Konczy budowe archiwum.
+	/// </summary>
+	/// <param name="version">Pierwsza wersja, ktora nie nalezy do archiwum.</param>
+	void seal(int version)
+	{
+		_version = version;
+		_bytes.shrink_to_fit();
+		_blocks.shrink_to_fit();
+	}
+
+	/// <summary>
+	/// Tworzy archiwum zawierajace klucze tego archiwum oraz podane wpisy. Dla klucza obecnego w obu zrodlach
+	/// przedzialy archiwum uzupelniane sa czescia przedzialow wpisu od wersji getVersion(), a przedzial
+	/// przechodzacy przez te wersje jest sklejany z przedzialem archiwum konczacym sie na niej.
+	/// </summary>
+	/// <param name="entries">Posortowane pary wskaznik na klucz - przedzialy.</param>
+	/// <param name="version">Pierwsza wersja, ktora nie nalezy do nowego archiwum.</param>
+	/// <returns></returns>
+	template<class Entries>
+	HistoryArchive merge(Entries const & entries, int version) const
+	{
+		HistoryArchive result;
+		DecodedBlock block;
+		auto entry = entries.begin();
+		for (int b = 0; b < blockCount(); ++b)
+		{
+			decodeBlock(b, block);
+			for (std::size_t i = 0; i < block.keys.size(); ++i)
+			{
+				for (; entry != entries.end() && orderFunctor(*entry->first, block.keys[i]); ++entry)
+					result.append(*entry->first, entry->second.begin(), entry->second.end());
+				if (entry != entries.end() && !orderFunctor(block.keys[i], *entry->first))
+				{
+					Ranges ranges(block.rangesBegin(i), block.rangesEnd(i));
+					for (VersionRange const & range : entry->second)
+					{
+						if (range.to <= _version)
+							continue;
+						int from = std::max(range.from, _version);
+						if (!ranges.empty() && ranges.back().to == from)
+							ranges.back().to = range.to;
+						else
+							ranges.push_back(VersionRange(from, range.to));
+					}
+					result.append(block.keys[i], ranges.begin(), ranges.end());
+					++entry;
+				}
+				else
+				{
+					result.append(block.keys[i], block.rangesBegin(i), block.rangesEnd(i));
+				}
+			}
+		}
+		for (; entry != entries.end(); ++entry)
+			result.append(*entry->first, entry->second.begin(), entry->second.end());
+		result.seal(version);
+		return result;
+	}
+
+	/// <summary>
+	/// Zwraca iterator na pierwszy klucz wskazanej wersji.
+	/// </summary>
+	/// <param name="version">Wersja.</param>
+	/// <returns></returns>
+	iterator begin(int version) const
+	{
+		return iterator(this, 0, 0, version);
+	}
+
+	iterator end() const
+	{
+		return iterator();
+	}
+
+	/// <summary>
+	/// Wyszukuje klucz we wskazanej wersji.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="version">Wersja.</param>
+	/// <returns>Iterator na klucz albo iterator konca, jezeli klucz nie istnial w wersji.</returns>
+	template<class Key>
+	iterator find(Key const & key, int version) const
+	{
+		DecodedBlock block;
+		std::size_t position;
+		if (!locate(key, block, position) || !block.isAlive(position, version))
+			return end();
+		return iterator(this, block.index, position, version);
+	}
+
+	/// <summary>
+	/// Sprawdza, czy klucz istnial we wskazanej wersji.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="version">Wersja.</param>
+	/// <returns></returns>
+	template<class Key>
+	bool contains(Key const & key, int version) const
+	{
+		DecodedBlock block;
+		std::size_t position;
+		return locate(key, block, position) && block.isAlive(position, version);
+	}
+
+	/// <summary>
+	/// Zwraca zarchiwizowane przedzialy wersji, w ktorych klucz istnial.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <returns></returns>
+	template<class Key>
+	Ranges lifetime(Key const & key) const
+	{
+		DecodedBlock block;
+		std::size_t position;
+		if (!locate(key, block, position))
+			return Ranges();
+		return Ranges(block.rangesBegin(position), block.rangesEnd(position));
+	}
+
+	/// <summary>
+	/// Sprawdza, czy klucz istnial w ktorejkolwiek z zarchiwizowanych wersji od first do last wlacznie.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="first">Pierwsza wersja.</param>
+	/// <param name="last">Ostatnia wersja.</param>
+	/// <returns></returns>
+	template<class Key>
+	bool existedBetween(Key const & key, int first, int last) const
+	{
+		DecodedBlock block;
+		std::size_t position;
+		if (!locate(key, block, position))
+			return false;
+		for (auto it = block.rangesBegin(position), rangesEnd = block.rangesEnd(position); it != rangesEnd && it->from <= last; ++it)
+			if (first < it->to)
+				return true;
+		return false;
+	}
+
+	/// <summary>
+	/// Zwraca pierwsza wersje, ktora nie nalezy do archiwum.
+	/// </summary>
+	/// <returns></returns>
+	int getVersion() const
+	{
+		return _version;
+	}
+
+	/// <summary>
+	/// Zwraca liczbe bajtow zajmowanych przez skompresowane klucze i indeks blokow.
+	/// </summary>
+	/// <returns></returns>
+	std::size_t memory() const
+	{
+		return _bytes.capacity() + _blocks.capacity() * sizeof(Block);
+	}
+
+	void clear()
+	{
+		_blocks.clear();
+		_bytes.clear();
+		_version = 0;
+	}
+
+private:
+	int blockCount() const
+	{
+		return static_cast<int>(_blocks.size());
+	}
+
+	/// <summary>
+	/// Rozpakowuje blok archiwum.
+	/// </summary>
+	/// <param name="index">Indeks bloku.</param>
+	/// <param name="block">Bufor na rozpakowany blok.</param>
+	void decodeBlock(int index, DecodedBlock & block) const
+	{
+		Block const & source = _blocks[index];
+		block.index = index;
+		block.keys.clear();
+		block.ends.clear();
+		block.ranges.clear();
+		unsigned char const * position = _bytes.data() + source.offset;
+		for (int i = 0; i < source.count; ++i)
+		{
+			block.keys.push_back(i == 0 ? source.firstKey : Codec::decode(block.keys.back(), position));
+			int count = static_cast<int>(readVarint(position));
+			int previous = 0;
+			for (int r = 0; r < count; ++r)
+			{
+				int from = previous + static_cast<int>(readVarint(position));
+				previous = from + static_cast<int>(readVarint(position));
+				block.ranges.push_back(VersionRange(from, previous));
+			}
+			block.ends.push_back(block.ranges.size());
+		}
+	}
+
+	/// <summary>
+	/// Wyszukuje klucz, rozpakowujac jego blok do bufora wywolujacego. Archiwum nie ma wspolnego bufora,
+	/// wiec rownoczesne odczyty nie zmieniaja jego stanu.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="block">Bufor na rozpakowany blok klucza.</param>
+	/// <param name="position">Pozycja klucza w bloku.</param>
+	/// <returns>False, jezeli klucza nie ma w archiwum.</returns>
+	template<class Key>
+	bool locate(Key const & key, DecodedBlock & block, std::size_t & position) const
+	{
+		auto it = std::upper_bound(_blocks.begin(), _blocks.end(), key,
+			[this](Key const & value, Block const & block) { return orderFunctor(value, block.firstKey); });
+		if (it == _blocks.begin())
+			return false;
+		decodeBlock(static_cast<int>(it - _blocks.begin()) - 1, block);
+		auto found = std::lower_bound(block.keys.begin(), block.keys.end(), key, orderFunctor);
+		if (found == block.keys.end() || orderFunctor(key, *found))
+			return false;
+		position = found - block.keys.begin();
+		return true;
+	}
+};
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstddef>
+#include <iterator>
+
+/// <summary>
+/// Iterator jednokierunkowy po wskazanej wersji archiwum historii.
+/// Rozpakowuje bloki archiwum dopiero przy wejsciu do nich i pomija klucze, ktore nie istnialy w wersji iteratora.
+/// </summary>
+template<class Type, class Archive>
+class HistoryArchiveIterator
+{
+	typedef typename Archive::DecodedBlock DecodedBlock;
+
+	Archive const * archive;
+	DecodedBlock block;
+	std::size_t position;
+	int version;
+
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef Type value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef Type const * pointer;
+	typedef Type const & reference;
+
+	/// <summary>
+	/// Tworzy iterator konca.
+	/// </summary>
+	HistoryArchiveIterator() : archive(nullptr), position(0), version(0)
+	{
+		block.index = -1;
+	}
+
+	/// <summary>
+	/// Tworzy iterator na klucz o podanej pozycji w bloku. Jezeli klucz nie istnial w wersji, przechodzi do nastepnego.
+	/// </summary>
+	/// <param name="archive">Archiwum.</param>
+	/// <param name="blockIndex">Indeks bloku.</param>
+	/// <param name="position">Pozycja klucza w bloku.</param>
+	/// <param name="version">Wersja.</param>
+	HistoryArchiveIterator(Archive const * archive, int blockIndex, std::size_t position, int version)
+		: archive(archive), position(position), version(version)
+	{
+		block.index = -1;
+		if (blockIndex >= archive->blockCount())
+		{
+			this->archive = nullptr;
+			return;
+		}
+		archive->decodeBlock(blockIndex, block);
+		skipMissing();
+	}
+
+	reference operator * () const
+	{
+		return block.keys[position];
+	}
+
+	pointer operator -> () const
+	{
+		return &**this;
+	}
+
+	HistoryArchiveIterator & operator ++ ()
+	{
+		++position;
+		skipMissing();
+		return *this;
+	}
+
+	HistoryArchiveIterator operator ++ (int)
+	{
+		HistoryArchiveIterator it(*this);
+		++*this;
+		return it;
+	}
+
+	bool operator == (HistoryArchiveIterator const & rhs) const
+	{
+		if (archive == nullptr || rhs.archive == nullptr)
+			return archive == rhs.archive;
+		return block.index == rhs.block.index && position == rhs.position;
+	}
+
+	bool operator != (HistoryArchiveIterator const & rhs) const
+	{
+		return !(*this == rhs);
+	}
+
+private:
+	/// <summary>
+	/// Przechodzi do pierwszego klucza istniejacego w wersji iteratora, rozpakowujac kolejne bloki.
+	/// </summary>
+	void skipMissing()
+	{
+		while (true)
+		{
+			while (position < block.keys.size() && !block.isAlive(position, version))
+				++position;
+			if (position < block.keys.size())
+				return;
+			if (block.index + 1 >= archive->blockCount())
+			{
+				archive = nullptr;
+				return;
+			}
+			archive->decodeBlock(block.index + 1, block);
+			position = 0;
+		}
+	}
+};
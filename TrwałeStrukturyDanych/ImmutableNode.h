@@ -0,0 +1,55 @@
+#pragma once
+#include "Node.h"
+
+/// <summary>
+/// Niezmienny wezel drzewa modyfikowanego metoda kopiowania sciezki.
+/// Nie ma pola zmiany, wiec odczyt dzieci i wartosci nie sprawdza wersji - parametr version
+/// jest przyjmowany jedynie dla zgodnosci z <see cref="Node"/> i iteratorem.
+/// Dzieci sa ustawiane tylko przy tworzeniu wezla, zanim stanie sie on czescia ktorejkolwiek wersji.
+/// Wartosc nie zmienia sie, wiec prefiks klucza napisowego zawsze ja opisuje.
+/// </summary>
+template<class Type, class Summary = void>
+class ImmutableNode : public NodeKeyPrefix<Type, NodeSummary<Summary>>
+{
+	typedef ImmutableNode<Type, Summary>* NodePtr;
+
+	NodePtr _leftChild;
+	NodePtr _rightChild;
+	Type * _value;
+
+public:
+	ImmutableNode(Type & value) : _leftChild(nullptr), _rightChild(nullptr), _value(&value)
+	{
+		this->setKeyPrefix(value);
+	}
+
+	NodePtr getLeftChild(int) const
+	{
+		return _leftChild;
+	}
+
+	NodePtr getRightChild(int) const
+	{
+		return _rightChild;
+	}
+
+	Type * getValue(int) const
+	{
+		return _value;
+	}
+
+	bool hasKeyPrefix(int) const
+	{
+		return true;
+	}
+
+	void setLeftChild(NodePtr child)
+	{
+		_leftChild = child;
+	}
+
+	void setRightChild(NodePtr child)
+	{
+		_rightChild = child;
+	}
+};
@@ -0,0 +1,184 @@
+#pragma once
+#include "ThreeWayOrder.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/// <summary>
+/// Prefiks napisu zachowujacy porzadek: pierwsze osiem bajtow zapisane od najstarszego bajtu liczby,
+/// dzieki czemu porownanie liczb bez znaku odpowiada porownaniu leksykograficznemu napisow.
+/// Dlugosc jest liczba bajtow napisu w prefiksie, wiec krotkie napisy porownywane sa w calosci.
+/// </summary>
+struct StringPrefix
+{
+	static const std::uint32_t SIZE = sizeof(std::uint64_t);
+
+	std::uint64_t bytes;
+	std::uint32_t length;
+
+	static StringPrefix of(std::string const & text)
+	{
+		StringPrefix prefix;
+		prefix.bytes = 0;
+		prefix.length = text.size() < SIZE ? static_cast<std::uint32_t>(text.size()) : SIZE;
+		for (std::uint32_t i = 0; i < prefix.length; ++i)
+			prefix.bytes |= static_cast<std::uint64_t>(static_cast<unsigned char>(text[i])) << (8 * (SIZE - 1 - i));
+		return prefix;
+	}
+
+	/// <summary>
+	/// Porownuje napisy na podstawie samych prefiksow. Wynik jest rozstrzygajacy, jezeli prefiksy sie roznia
+	/// albo ktorys napis jest krotszy niz prefiks; w przeciwnym razie trzeba porownac dalsze znaki napisow.
+	/// </summary>
+	/// <param name="lhs">Prefiks pierwszego napisu.</param>
+	/// <param name="rhs">Prefiks drugiego napisu.</param>
+	/// <returns>Liczba ujemna, zero albo dodatnia, jak w std::string::compare.</returns>
+	static int compare(StringPrefix const & lhs, StringPrefix const & rhs)
+	{
+		if (lhs.bytes != rhs.bytes)
+			return lhs.bytes < rhs.bytes ? -1 : 1;
+		// krotszy napis miesci sie w prefiksie w calosci, a dluzszy ma na tych pozycjach zera
+		return static_cast<int>(lhs.length) - static_cast<int>(rhs.length);
+	}
+};
+
+/// <summary>
+/// Prefiks klucza przechowywany w wezle. Ogolnie wezel nie przechowuje prefiksu i nie zajmuje dodatkowej pamieci.
+/// Parametr Base jest pozostala czescia wezla (agregatem poddrzewa), dzieki czemu wezel ma jedna klase bazowa.
+/// </summary>
+template<class Type, class Base>
+class NodeKeyPrefix : public Base
+{
+protected:
+	void setKeyPrefix(Type const &)
+	{
+	}
+};
+
+/// <summary>
+/// Wezel z kluczem napisowym przechowuje prefiks swojej wartosci, dzieki czemu wiekszosc porownan
+/// podczas zejscia nie siega do znakow napisu na stercie.
+/// </summary>
+template<class Base>
+class NodeKeyPrefix<std::string, Base> : public Base
+{
+	StringPrefix _keyPrefix;
+
+public:
+	StringPrefix const & getKeyPrefix() const
+	{
+		return _keyPrefix;
+	}
+
+protected:
+	void setKeyPrefix(std::string const & value)
+	{
+		_keyPrefix = StringPrefix::of(value);
+	}
+};
+
+/// <summary>
+/// Klucz wyszukiwania porownywany z wartosciami wezlow podczas zejscia od korzenia.
+/// Wersja ogolna porownuje klucz z wartoscia wezla funktorem porzadku, jednym wywolaniem,
+/// jezeli funktor jest trojwartosciowy (patrz ThreeWayOrder.h).
+/// Klucz mozna przypisywac, dzieki czemu wyszukiwanie wsadowe trzyma klucze w stalej tablicy.
+/// </summary>
+template<class Key, class Type, class OrderFunctor>
+class KeyProbe
+{
+	Key const * _key;
+	OrderFunctor const * _orderFunctor;
+
+public:
+	KeyProbe() : _key(nullptr), _orderFunctor(nullptr)
+	{
+	}
+
+	KeyProbe(Key const & key, OrderFunctor const & orderFunctor) : _key(&key), _orderFunctor(&orderFunctor)
+	{
+	}
+
+	/// <summary>
+	/// Porownuje klucz z wartoscia wezla w podanej wersji.
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns>Liczba ujemna, gdy klucz jest mniejszy, zero, gdy sa rownowazne, dodatnia, gdy klucz jest wiekszy.</returns>
+	template<class NodePtr>
+	int compare(NodePtr node, int version) const
+	{
+		return compareWith(*_orderFunctor, *_key, *node->getValue(version));
+	}
+
+	/// <summary>
+	/// Sprawdza, czy porownanie z wezlem odczyta wartosc spod wskaznika wezla.
+	/// Wyszukiwanie wsadowe pobiera wczesniej tylko te wartosci, ktore beda odczytane.
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	template<class NodePtr>
+	bool readsValue(NodePtr, int) const
+	{
+		return true;
+	}
+
+	/// <summary>
+	/// Sprawdza, czy klucz jest mniejszy od wartosci wezla w podanej wersji.
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	template<class NodePtr>
+	bool less(NodePtr node, int version) const
+	{
+		return (*_orderFunctor)(*_key, *node->getValue(version));
+	}
+};
+
+/// <summary>
+/// Klucz napisowy w porzadku rosnacym porownywany jest najpierw z prefiksem zapisanym w wezle.
+/// Pelne porownanie napisow nastepuje tylko wtedy, gdy prefiksy sa rowne, albo gdy wartosc wezla
+/// w podanej wersji pochodzi z pola zmiany i prefiks jej nie opisuje.
+/// </summary>
+template<>
+class KeyProbe<std::string, std::string, std::less<std::string>>
+{
+	std::string const * _key;
+	StringPrefix _prefix;
+
+public:
+	KeyProbe() : _key(nullptr)
+	{
+	}
+
+	KeyProbe(std::string const & key, std::less<std::string> const &) : _key(&key), _prefix(StringPrefix::of(key))
+	{
+	}
+
+	template<class NodePtr>
+	int compare(NodePtr node, int version) const
+	{
+		if (!node->hasKeyPrefix(version))
+			return _key->compare(*node->getValue(version));
+		StringPrefix const & prefix = node->getKeyPrefix();
+		if (_prefix.bytes != prefix.bytes || _prefix.length < StringPrefix::SIZE || prefix.length < StringPrefix::SIZE)
+			return StringPrefix::compare(_prefix, prefix);
+		return _key->compare(StringPrefix::SIZE, std::string::npos, *node->getValue(version), StringPrefix::SIZE, std::string::npos);
+	}
+
+	template<class NodePtr>
+	bool readsValue(NodePtr node, int version) const
+	{
+		if (!node->hasKeyPrefix(version))
+			return true;
+		StringPrefix const & prefix = node->getKeyPrefix();
+		return _prefix.bytes == prefix.bytes && _prefix.length == StringPrefix::SIZE && prefix.length == StringPrefix::SIZE;
+	}
+
+	template<class NodePtr>
+	bool less(NodePtr node, int version) const
+	{
+		return compare(node, version) < 0;
+	}
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <functional>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PERSISTENT_TREE_SSE2
+#include <emmintrin.h>
+#endif
+
+/// <summary>
+/// Wyszukiwanie pozycji w posortowanej tablicy kluczy wezla.
+/// Wersja ogolna wyszukuje binarnie z uzyciem funktora porzadku.
+/// </summary>
+template<class Type, class OrderFunctor>
+struct KeySearch
+{
+	/// <summary>
+	/// Zwraca indeks pierwszego klucza nie mniejszego niz podany.
+	/// </summary>
+	static int lowerBound(Type const * keys, int count, Type const & key, OrderFunctor const & orderFunctor)
+	{
+		return static_cast<int>(std::lower_bound(keys, keys + count, key, orderFunctor) - keys);
+	}
+
+	/// <summary>
+	/// Zwraca indeks pierwszego klucza wiekszego niz podany.
+	/// </summary>
+	static int upperBound(Type const * keys, int count, Type const & key, OrderFunctor const & orderFunctor)
+	{
+		return static_cast<int>(std::upper_bound(keys, keys + count, key, orderFunctor) - keys);
+	}
+};
+
+#ifdef PERSISTENT_TREE_SSE2
+/// <summary>
+/// Wspolna czesc wyszukiwania SSE2: zlicza klucze mniejsze od podanego, porownujac cztery klucze naraz.
+/// Klucze sa posortowane, wiec liczenie konczy sie na pierwszej czworce, w ktorej nie wszystkie klucze sa mniejsze.
+/// </summary>
+struct SimdKeyCount
+{
+	static int bits(int mask)
+	{
+		static const int counts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+		return counts[mask];
+	}
+
+	static int countLess(int const * keys, int count, int key)
+	{
+		__m128i needle = _mm_set1_epi32(key);
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(keys + i));
+			int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(block, needle)));
+			if (mask != 0xF)
+				return i + bits(mask);
+		}
+		while (i < count && keys[i] < key)
+			++i;
+		return i;
+	}
+
+	static int countLess(float const * keys, int count, float key)
+	{
+		__m128 needle = _mm_set1_ps(key);
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			int mask = _mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(keys + i), needle));
+			if (mask != 0xF)
+				return i + bits(mask);
+		}
+		while (i < count && keys[i] < key)
+			++i;
+		return i;
+	}
+
+	static int countNotGreater(float const * keys, int count, float key)
+	{
+		__m128 needle = _mm_set1_ps(key);
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			int mask = _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(keys + i), needle));
+			if (mask != 0xF)
+				return i + bits(mask);
+		}
+		while (i < count && keys[i] <= key)
+			++i;
+		return i;
+	}
+};
+
+/// <summary>
+/// Wyszukiwanie SSE2 dla kluczy int w porzadku rosnacym.
+/// </summary>
+template<>
+struct KeySearch<int, std::less<int>>
+{
+	static int lowerBound(int const * keys, int count, int key, std::less<int> const &)
+	{
+		return SimdKeyCount::countLess(keys, count, key);
+	}
+
+	static int upperBound(int const * keys, int count, int key, std::less<int> const &)
+	{
+		// klucze nie wieksze niz key to klucze mniejsze niz key + 1
+		return key == INT_MAX ? count : SimdKeyCount::countLess(keys, count, key + 1);
+	}
+};
+
+/// <summary>
+/// Wyszukiwanie SSE2 dla kluczy float w porzadku rosnacym.
+/// </summary>
+template<>
+struct KeySearch<float, std::less<float>>
+{
+	static int lowerBound(float const * keys, int count, float key, std::less<float> const &)
+	{
+		return SimdKeyCount::countLess(keys, count, key);
+	}
+
+	static int upperBound(float const * keys, int count, float key, std::less<float> const &)
+	{
+		return SimdKeyCount::countNotGreater(keys, count, key);
+	}
+};
+#endif
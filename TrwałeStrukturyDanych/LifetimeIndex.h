@@ -0,0 +1,155 @@
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <vector>
+
+/// <summary>
+/// Przedzial wersji [from, to), w ktorych klucz istnial w drzewie.
+/// </summary>
+struct VersionRange
+{
+	/// <summary>
+	/// Koniec przedzialu klucza, ktory nadal istnieje w najnowszej wersji
+	/// </summary>
+	static const int LIVE = INT_MAX;
+
+	int from;
+	int to;
+
+	VersionRange(int from, int to) : from(from), to(to)
+	{
+	}
+};
+
+/// <summary>
+/// Indeks czasu zycia kluczy. Dla kazdego klucza przechowuje posortowane, rozlaczne przedzialy wersji,
+/// w ktorych klucz istnial, dzieki czemu pytania o historie klucza nie wymagaja schodzenia po drzewach.
+/// Klucze nie sa kopiowane - indeks przechowuje wskazniki na wartosci w wezlach drzewa.
+/// </summary>
+template<class Type, class OrderFunctor>
+class LifetimeIndex
+{
+	/// <summary>
+	/// Porzadek na wskaznikach do wartosci, pozwalajacy wyszukiwac po samej wartosci lub kluczu.
+	/// </summary>
+	struct PointerOrder
+	{
+		typedef void is_transparent;
+
+		OrderFunctor orderFunctor;
+
+		bool operator () (Type const * lhs, Type const * rhs) const
+		{
+			return orderFunctor(*lhs, *rhs);
+		}
+
+		template<class Key>
+		bool operator () (Type const * lhs, Key const & rhs) const
+		{
+			return orderFunctor(*lhs, rhs);
+		}
+
+		template<class Key>
+		bool operator () (Key const & lhs, Type const * rhs) const
+		{
+			return orderFunctor(lhs, *rhs);
+		}
+	};
+
+	typedef std::vector<VersionRange> Ranges;
+
+	std::map<Type const *, Ranges, PointerOrder> _ranges;
+
+public:
+	/// <summary>
+	/// Zapisuje poczatek istnienia klucza.
+	/// </summary>
+	/// <param name="value">Wskaznik na wartosc w drzewie.</param>
+	/// <param name="version">Wersja, w ktorej klucz zostal wstawiony.</param>
+	void open(Type const * value, int version)
+	{
+		_ranges[value].push_back(VersionRange(version, VersionRange::LIVE));
+	}
+
+	/// <summary>
+	/// Zapisuje koniec istnienia klucza.
+	/// </summary>
+	/// <param name="value">Wartosc klucza.</param>
+	/// <param name="version">Wersja, w ktorej klucz zostal usuniety.</param>
+	void close(Type const & value, int version)
+	{
+		auto it = _ranges.find(value);
+		if (it != _ranges.end() && !it->second.empty() && it->second.back().to == VersionRange::LIVE)
+			it->second.back().to = version;
+	}
+
+	/// <summary>
+	/// Zwraca przedzialy wersji, w ktorych klucz istnial.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <returns></returns>
+	template<class Key>
+	Ranges const & lifetime(Key const & key) const
+	{
+		static const Ranges empty;
+		auto it = _ranges.find(key);
+		return it != _ranges.end() ? it->second : empty;
+	}
+
+	/// <summary>
+	/// Sprawdza, czy klucz istnial w ktorejkolwiek z wersji od first do last wlacznie.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="first">Pierwsza wersja.</param>
+	/// <param name="last">Ostatnia wersja.</param>
+	/// <returns></returns>
+	template<class Key>
+	bool existedBetween(Key const & key, int first, int last) const
+	{
+		Ranges const & ranges = lifetime(key);
+		// pierwszy przedzial, ktory nie skonczyl sie przed wersja first
+		auto it = std::upper_bound(ranges.begin(), ranges.end(), first,
+			[](int version, VersionRange const & range) { return version < range.to; });
+		return it != ranges.end() && it->from <= last;
+	}
+
+	/// <summary>
+	/// Wywoluje funkcje dla kazdego klucza i jego przedzialow w porzadku kluczy.
+	/// </summary>
+	/// <param name="function">Funkcja przyjmujaca wskaznik na wartosc i przedzialy.</param>
+	template<class Function>
+	void forEach(Function function) const
+	{
+		for (auto const & entry : _ranges)
+			function(entry.first, entry.second);
+	}
+
+	/// <summary>
+	/// Zostawia w indeksie tylko klucze istniejace w ktorejkolwiek wersji od podanej. Pozostale klucze sa usuwane,
+	/// a wskazniki zostawionych kluczy przenoszone na wartosci zwrocone przez lookup dla wersji, w ktorej klucz istnial.
+	/// Pozwala zwolnic wezly, ktore naleza tylko do wersji starszych niz podana.
+	/// </summary>
+	/// <param name="version">Pierwsza zostawiana wersja.</param>
+	/// <param name="lookup">Funkcja zwracajaca wskaznik na wartosc klucza w podanej wersji.</param>
+	template<class Lookup>
+	void retain(int version, Lookup lookup)
+	{
+		std::map<Type const *, Ranges, PointerOrder> retained(_ranges.key_comp());
+		for (auto & entry : _ranges)
+		{
+			Ranges & ranges = entry.second;
+			// pierwszy przedzial, ktory nie skonczyl sie przed podana wersja
+			auto it = std::upper_bound(ranges.begin(), ranges.end(), version,
+				[](int version, VersionRange const & range) { return version < range.to; });
+			if (it != ranges.end())
+				retained.emplace_hint(retained.end(), lookup(*entry.first, std::max(it->from, version)), std::move(ranges));
+		}
+		_ranges.swap(retained);
+	}
+
+	void clear()
+	{
+		_ranges.clear();
+	}
+};
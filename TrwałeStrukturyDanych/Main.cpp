@@ -1,6 +1,7 @@
 #include <iostream>
 #include <cstdio>
 #include "PersistentTree.h"
+#include "PersistentBPlusTree.h"
 #include <chrono>
 #include <algorithm>
 #include <array>
@@ -127,6 +128,48 @@ void stringTests()
 	clk2 = high_resolution_clock::now();
 	time_span = duration_cast<duration<double>>(clk2 - clk1);
 	cout << "Usuwanie z drzewa stringow: " << time_span.count() << " sekund" << endl << endl;
+
+	// ----- PersistentBPlusTree
+	// Wstawianie
+	PersistentBPlusTree<string> bplusTree;
+	seed = std::chrono::system_clock::now().time_since_epoch().count();
+	shuffle(vec.begin(), vec.end(), std::default_random_engine(seed));
+	clk1 = high_resolution_clock::now();
+	for (auto x : vec) {
+		bplusTree.insert(x);
+	}
+	clk2 = high_resolution_clock::now();
+	time_span = duration_cast<duration<double>>(clk2 - clk1);
+	cout << "Wstawianie do B+drzewa stringow: " << time_span.count() << " sekund" << endl;
+
+	// Pamiec
+	size = sizeof(PersistentBPlusTree<string>) + (PersistentBPlusTree<string>::NODE_SIZE * bplusTree.size_of_history());
+	cout << "B+drzewo zajmuje: " << size << " bajtow" << endl;
+
+	// Wyszukiwanie
+	vec100k.clear();
+	seed = std::chrono::system_clock::now().time_since_epoch().count();
+	shuffle(vec.begin(), vec.end(), std::default_random_engine(seed));
+	vec100k.insert(vec100k.begin(), vec.begin(), vec.begin() + 100000);
+	shuffle(vec100k.begin(), vec100k.end(), std::default_random_engine(seed));
+	clk1 = high_resolution_clock::now();
+	for (auto x : vec100k) {
+		bplusTree.find(x);
+	}
+	clk2 = high_resolution_clock::now();
+	time_span = duration_cast<duration<double>>(clk2 - clk1);
+	cout << "Wyszukiwanie 100k w B+drzewie stringow: " << time_span.count() << " sekund" << endl;
+
+	// Usuwanie
+	seed = std::chrono::system_clock::now().time_since_epoch().count();
+	shuffle(vec.begin(), vec.end(), std::default_random_engine(seed));
+	clk1 = high_resolution_clock::now();
+	for (auto x : vec) {
+		bplusTree.erase(x);
+	}
+	clk2 = high_resolution_clock::now();
+	time_span = duration_cast<duration<double>>(clk2 - clk1);
+	cout << "Usuwanie z B+drzewa stringow: " << time_span.count() << " sekund" << endl << endl;
 }
 
 // ===== Testy na intach ===== //
@@ -223,12 +266,118 @@ void intTests()
 	clk2 = high_resolution_clock::now();
 	time_span = duration_cast<duration<double>>(clk2 - clk1);
 	cout << "Usuwanie z drzewa intow: " << time_span.count() << " sekund" << endl << endl;
+
+	// ----- PersistentBPlusTree
+	// Wstawianie
+	PersistentBPlusTree<int> bplusTree;
+	seed = std::chrono::system_clock::now().time_since_epoch().count();
+	shuffle(vec.begin(), vec.end(), std::default_random_engine(seed));
+	clk1 = high_resolution_clock::now();
+	for (auto x : vec) {
+		bplusTree.insert(x);
+	}
+	clk2 = high_resolution_clock::now();
+	time_span = duration_cast<duration<double>>(clk2 - clk1);
+	cout << "Wstawianie do B+drzewa intow: " << time_span.count() << " sekund" << endl;
+
+	// Pamiec
+	size = sizeof(PersistentBPlusTree<int>) + (PersistentBPlusTree<int>::NODE_SIZE * bplusTree.size_of_history());
+	cout << "B+drzewo zajmuje: " << size << " bajtow" << endl;
+
+	// Wyszukiwanie
+	vec100k.clear();
+	seed = std::chrono::system_clock::now().time_since_epoch().count();
+	shuffle(vec.begin(), vec.end(), std::default_random_engine(seed));
+	vec100k.insert(vec100k.begin(), vec.begin(), vec.begin() + 100000);
+	shuffle(vec100k.begin(), vec100k.end(), std::default_random_engine(seed));
+	clk1 = high_resolution_clock::now();
+	for (auto x : vec100k) {
+		bplusTree.find(x);
+	}
+	clk2 = high_resolution_clock::now();
+	time_span = duration_cast<duration<double>>(clk2 - clk1);
+	cout << "Wyszukiwanie 100k w B+drzewie intow: " << time_span.count() << " sekund" << endl;
+
+	// Usuwanie
+	seed = std::chrono::system_clock::now().time_since_epoch().count();
+	shuffle(vec.begin(), vec.end(), std::default_random_engine(seed));
+	clk1 = high_resolution_clock::now();
+	for (auto x : vec) {
+		bplusTree.erase(x);
+	}
+	clk2 = high_resolution_clock::now();
+	time_span = duration_cast<duration<double>>(clk2 - clk1);
+	cout << "Usuwanie z B+drzewa intow: " << time_span.count() << " sekund" << endl << endl;
+}
+
+// ===== Porownanie strategii trwalosci ===== //
+template<class Tree>
+void persistenceTest(string const & name, vector<int> & vec)
+{
+	// Zapis
+	Tree tree;
+	unsigned int seed = std::chrono::system_clock::now().time_since_epoch().count();
+	shuffle(vec.begin(), vec.end(), std::default_random_engine(seed));
+	high_resolution_clock::time_point clk1 = high_resolution_clock::now();
+	for (auto x : vec) {
+		tree.insert(x);
+	}
+	high_resolution_clock::time_point clk2 = high_resolution_clock::now();
+	duration<double> time_span = duration_cast<duration<double>>(clk2 - clk1);
+	cout << "Wstawianie intow (" << name << "): " << time_span.count() << " sekund" << endl;
+
+	// Pamiec: wezly wraz z wartosciami
+	auto size = sizeof(Tree) + ((Tree::NODE_SIZE + sizeof(int)) * tree.size_of_history());
+	cout << "Drzewo (" << name << ") zajmuje: " << size << " bajtow" << endl;
+
+	// Odczyt aktualnej i historycznej wersji
+	vector<int> vec100k(vec.begin(), vec.begin() + 100000);
+	shuffle(vec100k.begin(), vec100k.end(), std::default_random_engine(seed));
+	int versions[] = { tree.getCurrentVersion(), tree.getCurrentVersion() / 2 };
+	for (int version : versions)
+	{
+		int found = 0;
+		clk1 = high_resolution_clock::now();
+		for (auto x : vec100k) {
+			found += tree.contains(x, version);
+		}
+		clk2 = high_resolution_clock::now();
+		time_span = duration_cast<duration<double>>(clk2 - clk1);
+		cout << "Wyszukiwanie 100k w wersji " << version << " (" << name << "): " << time_span.count() << " sekund, znaleziono " << found << endl;
+	}
+
+	// Usuwanie
+	clk1 = high_resolution_clock::now();
+	for (auto x : vec) {
+		tree.erase(x);
+	}
+	clk2 = high_resolution_clock::now();
+	time_span = duration_cast<duration<double>>(clk2 - clk1);
+	cout << "Usuwanie intow (" << name << "): " << time_span.count() << " sekund" << endl;
+	cout << "Wezlow w historii (" << name << "): " << tree.size_of_history() << endl;
+
+	// Usuwanie historii
+	tree.purge();
+	cout << "Wezlow po usunieciu historii (" << name << "): " << tree.size_of_history() << endl << endl;
+}
+
+void persistenceTests()
+{
+	int million = 1000000;
+	vector<int> vec(million);
+	for (int i = 0; i < million; i++)
+	{
+		vec[i] = i;
+	}
+	persistenceTest<PersistentTree<int>>("kopiowanie wezlow", vec);
+	persistenceTest<PersistentTree<int, std::less<int>, NoAggregate, PathCopying>>("kopiowanie sciezki", vec);
 }
 
 int main()
 {
 	stringTests();
 	intTests();
+	persistenceTests();
 	getchar();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,378 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// Sterta umieszczona na poczatku pliku odwzorowanego w pamieci. Caly stan alokatora - wskaznik szczytu,
+/// listy wolnych blokow i korzen danych uzytkownika - jest czescia pliku, wiec po ponownym otwarciu
+/// sterta dziala dalej bez odtwarzania. Male bloki trafiaja na listy wg klas rozmiaru co 16 bajtow,
+/// duze na jedna liste przeszukiwana do pierwszego pasujacego bloku.
+/// Dostep jest chroniony blokada wirujaca, bo operacje na zbiorach alokuja wezly z wielu watkow naraz.
+/// </summary>
+struct ArenaHeap
+{
+	static const std::uint64_t MAGIC = 0x50545245454d4150ull;
+
+	/// <summary>
+	/// Wyrownanie i ziarno rozmiaru blokow
+	/// </summary>
+	static const std::size_t GRANULE = 16;
+
+	/// <summary>
+	/// Liczba klas rozmiaru malych blokow
+	/// </summary>
+	static const std::size_t SMALL_CLASSES = 32;
+
+	/// <summary>
+	/// Wolny blok na liscie duzych blokow
+	/// </summary>
+	struct LargeBlock
+	{
+		std::size_t size;
+		LargeBlock * next;
+	};
+
+	std::uint64_t magic;
+	std::uint64_t base;
+	std::uint64_t capacity;
+	std::uint64_t top;
+	std::atomic<bool> locked;
+	void * small[SMALL_CLASSES];
+	LargeBlock * large;
+	void * root;
+
+	/// <summary>
+	/// Przydziela blok o podanym rozmiarze.
+	/// </summary>
+	/// <param name="bytes">Rozmiar w bajtach.</param>
+	/// <returns>Blok albo nullptr, jezeli plik jest pelny.</returns>
+	void * allocate(std::size_t bytes)
+	{
+		bytes = roundUp(bytes);
+		Lock lock(*this);
+		std::size_t index = bytes / GRANULE - 1;
+		if (index < SMALL_CLASSES)
+		{
+			void * block = small[index];
+			if (block != nullptr)
+			{
+				small[index] = *static_cast<void**>(block);
+				return block;
+			}
+		}
+		else
+		{
+			for (LargeBlock ** link = &large; *link != nullptr; link = &(*link)->next)
+			{
+				LargeBlock * block = *link;
+				if (block->size < bytes)
+					continue;
+				*link = block->next;
+				if (block->size > bytes)
+					release(reinterpret_cast<char*>(block) + bytes, block->size - bytes);
+				return block;
+			}
+		}
+		if (top + bytes > capacity)
+			return nullptr;
+		void * block = reinterpret_cast<char*>(this) + top;
+		top += bytes;
+		return block;
+	}
+
+	/// <summary>
+	/// Zwalnia blok przydzielony przez allocate.
+	/// </summary>
+	/// <param name="block">Blok.</param>
+	/// <param name="bytes">Rozmiar podany przy przydziale.</param>
+	void deallocate(void * block, std::size_t bytes)
+	{
+		if (block == nullptr)
+			return;
+		Lock lock(*this);
+		release(block, roundUp(bytes));
+	}
+
+private:
+	/// <summary>
+	/// Blokada wirujaca na czas operacji na listach wolnych blokow.
+	/// </summary>
+	struct Lock
+	{
+		ArenaHeap & heap;
+
+		explicit Lock(ArenaHeap & heap) : heap(heap)
+		{
+			while (heap.locked.exchange(true, std::memory_order_acquire)) {}
+		}
+
+		~Lock()
+		{
+			heap.locked.store(false, std::memory_order_release);
+		}
+	};
+
+	static std::size_t roundUp(std::size_t bytes)
+	{
+		return bytes == 0 ? GRANULE : (bytes + GRANULE - 1) / GRANULE * GRANULE;
+	}
+
+	void release(void * block, std::size_t bytes)
+	{
+		std::size_t index = bytes / GRANULE - 1;
+		if (index < SMALL_CLASSES)
+		{
+			*static_cast<void**>(block) = small[index];
+			small[index] = block;
+		}
+		else
+		{
+			LargeBlock * free = static_cast<LargeBlock*>(block);
+			free->size = bytes;
+			free->next = large;
+			large = free;
+		}
+	}
+};
+
+/// <summary>
+/// Plik odwzorowany w pamieci, w ktorym umieszczana jest sterta <see cref="ArenaHeap"/>.
+/// Plik jest zawsze odwzorowywany pod tym samym adresem, zapisanym w naglowku przy jego utworzeniu,
+/// dlatego zwykle wskazniki miedzy obiektami w pliku pozostaja poprawne po ponownym otwarciu,
+/// a otwarcie nie wymaga przechodzenia po danych - strony sa wczytywane dopiero przy dostepie.
+/// Pojemnosc pliku ustalana jest przy tworzeniu; plik jest rzadki, wiec zajmuje tylko zapisane strony.
+/// </summary>
+class MappedArena
+{
+	ArenaHeap * _heap;
+	std::size_t _size;
+#ifdef _WIN32
+	HANDLE _file;
+	HANDLE _mapping;
+#else
+	int _file;
+#endif
+
+public:
+	/// <summary>
+	/// Domyslna pojemnosc nowego pliku
+	/// </summary>
+	static const std::size_t DEFAULT_CAPACITY = std::size_t(1) << (sizeof(void*) == 8 ? 34 : 28);
+
+	MappedArena() : _heap(nullptr), _size(0)
+#ifdef _WIN32
+		, _file(INVALID_HANDLE_VALUE), _mapping(nullptr)
+#else
+		, _file(-1)
+#endif
+	{
+	}
+
+	~MappedArena()
+	{
+		close();
+	}
+
+	MappedArena(MappedArena const &) = delete;
+	MappedArena & operator = (MappedArena const &) = delete;
+
+	/// <summary>
+	/// Otwiera plik sterty albo tworzy nowy, jezeli plik nie istnieje lub jest pusty.
+	/// </summary>
+	/// <param name="path">Sciezka pliku.</param>
+	/// <param name="capacity">Pojemnosc nowego pliku w bajtach, ignorowana przy otwieraniu istniejacego.</param>
+	/// <returns>False, jezeli pliku nie da sie otworzyc albo odwzorowac pod zapisanym adresem.</returns>
+	bool open(char const * path, std::size_t capacity = DEFAULT_CAPACITY)
+	{
+		close();
+		ArenaHeap header;
+		std::memset(static_cast<void*>(&header), 0, sizeof(header));
+		bool created;
+		if (!openFile(path, capacity, header, created) || !mapFile(reinterpret_cast<void*>(static_cast<std::uintptr_t>(header.base))))
+		{
+			close();
+			return false;
+		}
+		if (created)
+		{
+			std::memset(static_cast<void*>(_heap), 0, sizeof(ArenaHeap));
+			new (&_heap->locked) std::atomic<bool>(false);
+			_heap->magic = ArenaHeap::MAGIC;
+			_heap->base = reinterpret_cast<std::uintptr_t>(_heap);
+			_heap->capacity = _size;
+			_heap->top = (sizeof(ArenaHeap) + ArenaHeap::GRANULE - 1) / ArenaHeap::GRANULE * ArenaHeap::GRANULE;
+		}
+		else if (_heap->base != reinterpret_cast<std::uintptr_t>(_heap))
+		{
+			close();
+			return false;
+		}
+		_heap->locked.store(false);
+		return true;
+	}
+
+	/// <summary>
+	/// Zapisuje zmienione strony na dysk.
+	/// </summary>
+	/// <returns></returns>
+	bool flush()
+	{
+		if (_heap == nullptr)
+			return false;
+#ifdef _WIN32
+		return FlushViewOfFile(_heap, 0) && FlushFileBuffers(_file);
+#else
+		return msync(_heap, _size, MS_SYNC) == 0;
+#endif
+	}
+
+	/// <summary>
+	/// Zamyka plik. Obiekty umieszczone w pliku nie moga byc uzywane po zamknieciu.
+	/// </summary>
+	void close()
+	{
+#ifdef _WIN32
+		if (_heap != nullptr)
+			UnmapViewOfFile(_heap);
+		if (_mapping != nullptr)
+			CloseHandle(_mapping);
+		if (_file != INVALID_HANDLE_VALUE)
+			CloseHandle(_file);
+		_mapping = nullptr;
+		_file = INVALID_HANDLE_VALUE;
+#else
+		if (_heap != nullptr)
+			munmap(_heap, _size);
+		if (_file >= 0)
+			::close(_file);
+		_file = -1;
+#endif
+		_heap = nullptr;
+		_size = 0;
+	}
+
+	bool isOpen() const
+	{
+		return _heap != nullptr;
+	}
+
+	/// <summary>
+	/// Zwraca sterte pliku.
+	/// </summary>
+	/// <returns></returns>
+	ArenaHeap * heap() const
+	{
+		return _heap;
+	}
+
+	/// <summary>
+	/// Zwraca obiekt zapisany jako korzen pliku albo nullptr dla nowego pliku.
+	/// </summary>
+	/// <returns></returns>
+	void * root() const
+	{
+		return _heap->root;
+	}
+
+	void setRoot(void * root)
+	{
+		_heap->root = root;
+	}
+
+private:
+	/// <summary>
+	/// Adres, pod ktorym odwzorowywany jest nowy plik. Wybrany w rzadko uzywanej czesci przestrzeni adresowej,
+	/// zeby ponowne odwzorowanie pod tym samym adresem w innym procesie bylo mozliwe.
+	/// </summary>
+	static void * preferredBase()
+	{
+		return sizeof(void*) == 8 ? reinterpret_cast<void*>(static_cast<std::uintptr_t>(0x200000000000ull)) : nullptr;
+	}
+
+#ifdef _WIN32
+	bool openFile(char const * path, std::size_t capacity, ArenaHeap & header, bool & created)
+	{
+		_file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (_file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(_file, &size))
+			return false;
+		created = size.QuadPart == 0;
+		if (created)
+		{
+			header.base = reinterpret_cast<std::uintptr_t>(preferredBase());
+			_size = capacity;
+			return true;
+		}
+		DWORD read = 0;
+		if (!ReadFile(_file, &header, sizeof(header), &read, nullptr) || read != sizeof(header) || header.magic != ArenaHeap::MAGIC)
+			return false;
+		_size = static_cast<std::size_t>(size.QuadPart);
+		return true;
+	}
+
+	bool mapFile(void * base)
+	{
+		std::uint64_t size = _size;
+		_mapping = CreateFileMappingA(_file, nullptr, PAGE_READWRITE, DWORD(size >> 32), DWORD(size), nullptr);
+		if (_mapping == nullptr)
+			return false;
+		_heap = static_cast<ArenaHeap*>(MapViewOfFileEx(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, _size, base));
+		if (_heap == nullptr && base != nullptr)
+			_heap = static_cast<ArenaHeap*>(MapViewOfFileEx(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, _size, nullptr));
+		return _heap != nullptr;
+	}
+#else
+	bool openFile(char const * path, std::size_t capacity, ArenaHeap & header, bool & created)
+	{
+		_file = ::open(path, O_RDWR | O_CREAT, 0644);
+		if (_file < 0)
+			return false;
+		struct stat status;
+		if (fstat(_file, &status) != 0)
+			return false;
+		created = status.st_size == 0;
+		if (created)
+		{
+			header.base = reinterpret_cast<std::uintptr_t>(preferredBase());
+			_size = capacity;
+			return ftruncate(_file, static_cast<off_t>(capacity)) == 0;
+		}
+		if (pread(_file, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) || header.magic != ArenaHeap::MAGIC)
+			return false;
+		_size = static_cast<std::size_t>(status.st_size);
+		return true;
+	}
+
+	bool mapFile(void * base)
+	{
+		int flags = MAP_SHARED;
+#ifdef MAP_FIXED_NOREPLACE
+		if (base != nullptr)
+			flags |= MAP_FIXED_NOREPLACE;
+#endif
+		void * address = mmap(base, _size, PROT_READ | PROT_WRITE, flags, _file, 0);
+		if (address == MAP_FAILED)
+			address = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _file, 0);
+		if (address == MAP_FAILED)
+			return false;
+		_heap = static_cast<ArenaHeap*>(address);
+		return true;
+	}
+#endif
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+/// <summary>
+/// Nieblokujaca kolejka wielu producentow i jednego konsumenta (algorytm Wjukowa).
+/// Producent wykonuje jedna wymiane atomowa glowy kolejki, wiec producenci nie czekaja na siebie nawzajem.
+/// Metody pop i empty moze wywolywac tylko jeden watek konsumenta.
+/// </summary>
+template<class T>
+class MpscQueue
+{
+	struct Cell
+	{
+		std::atomic<Cell*> next;
+		T value;
+
+		Cell() : next(nullptr), value()
+		{
+		}
+
+		explicit Cell(T value) : next(nullptr), value(std::move(value))
+		{
+		}
+	};
+
+	/// <summary>
+	/// Ostatnio dodana komorka, modyfikowana przez producentow
+	/// </summary>
+	std::atomic<Cell*> _head;
+
+	/// <summary>
+	/// Najstarsza komorka, uzywana tylko przez konsumenta
+	/// </summary>
+	Cell * _tail;
+
+	/// <summary>
+	/// Pusta komorka, dzieki ktorej kolejka nigdy nie jest pusta strukturalnie
+	/// </summary>
+	Cell _stub;
+
+public:
+	MpscQueue() : _head(&_stub), _tail(&_stub)
+	{
+	}
+
+	~MpscQueue()
+	{
+		T value;
+		while (pop(value)) {}
+	}
+
+	MpscQueue(MpscQueue const &) = delete;
+	MpscQueue & operator = (MpscQueue const &) = delete;
+
+	/// <summary>
+	/// Dodaje wartosc na koniec kolejki. Moze byc wywolywana z wielu watkow naraz.
+	/// </summary>
+	/// <param name="value">Wartosc.</param>
+	void push(T value)
+	{
+		link(new Cell(std::move(value)));
+	}
+
+	/// <summary>
+	/// Pobiera wartosc z poczatku kolejki.
+	/// </summary>
+	/// <param name="value">Pobrana wartosc.</param>
+	/// <returns>False, jezeli kolejka jest pusta albo producent jeszcze nie dopial dodawanej komorki.</returns>
+	bool pop(T & value)
+	{
+		Cell * tail = _tail;
+		Cell * next = tail->next.load(std::memory_order_acquire);
+		if (tail == &_stub)
+		{
+			if (next == nullptr)
+				return false;
+			_tail = next;
+			tail = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+		if (next == nullptr)
+		{
+			if (tail != _head.load(std::memory_order_acquire))
+				return false;
+			// ostatnia komorka moze zostac zwolniona dopiero, gdy za nia stoi komorka pusta
+			_stub.next.store(nullptr, std::memory_order_relaxed);
+			link(&_stub);
+			next = tail->next.load(std::memory_order_acquire);
+			if (next == nullptr)
+				return false;
+		}
+		_tail = next;
+		value = std::move(tail->value);
+		delete tail;
+		return true;
+	}
+
+	/// <summary>
+	/// Sprawdza, czy kolejka jest pusta. Wynik jest wiazacy tylko dla konsumenta.
+	/// </summary>
+	/// <returns></returns>
+	bool empty() const
+	{
+		return _tail == &_stub && _stub.next.load(std::memory_order_acquire) == nullptr && _head.load() == &_stub;
+	}
+
+private:
+	void link(Cell * cell)
+	{
+		Cell * previous = _head.exchange(cell);
+		previous->next.store(cell, std::memory_order_release);
+	}
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include "KeyPrefix.h"
+#include <atomic>
 #include <memory>
 
 /// <summary>
@@ -9,13 +11,43 @@ enum class ChangeType
 	None, LeftChild, RightChild, Value
 };
 
+/// <summary>
+/// Agregat poddrzewa przechowywany w wezle.
+/// </summary>
+template<class Summary>
+class NodeSummary
+{
+	Summary _summary;
+
+public:
+	Summary const & getSummary() const
+	{
+		return _summary;
+	}
+
+	void setSummary(Summary const & summary)
+	{
+		_summary = summary;
+	}
+};
+
+/// <summary>
+/// Wezel bez agregatu nie zajmuje dodatkowej pamieci.
+/// </summary>
+template<>
+class NodeSummary<void>
+{
+};
+
 /// <summary>
 /// Struktura reprezentujaca pojedynczy wezel w historii drzewa
+/// Parametr Summary okresla typ agregatu poddrzewa, void oznacza jego brak.
+/// Wezel z kluczem napisowym przechowuje dodatkowo prefiks swojej wartosci (patrz KeyPrefix.h).
 /// </summary>
-template<class Type>
-class Node
+template<class Type, class Summary = void>
+class Node : public NodeKeyPrefix<Type, NodeSummary<Summary>>
 {
-	typedef Node<Type>* NodePtr;
+	typedef Node<Type, Summary>* NodePtr;
 public:
 	template<class Type>	
 	union ChangeField
@@ -28,8 +60,8 @@ public:
 	};
 
 private:
-	// pole zmiany
-	ChangeType _changeType;
+	// pole zmiany, typ jest zapisywany jako ostatni, co publikuje zmiane dla czytelnikow z innych watkow
+	std::atomic<ChangeType> _changeType;
 	int _changeTime;
 	ChangeField<Type> _change;
 	// pole drzewa
@@ -47,6 +79,7 @@ public:
 	{
 		init();
 		setValue(&value);
+		this->setKeyPrefix(value);
 	}
 
 	~Node()
@@ -61,7 +94,7 @@ public:
 	void init()
 	{
 		// brak zmiany
-		_changeType = ChangeType::None;
+		_changeType.store(ChangeType::None, std::memory_order_relaxed);
 		_changeTime = 0;
 		// wezel bez dzieci i z wartoscia
 		_rightChild = _leftChild = nullptr;
@@ -74,7 +107,7 @@ public:
 	/// <returns></returns>
 	NodePtr getLeftChild(int version) const
 	{
-		NodePtr left = _changeType == ChangeType::LeftChild && version >= _changeTime ? _change.child : _leftChild;
+		NodePtr left = getChangeType() == ChangeType::LeftChild && version >= _changeTime ? _change.child : _leftChild;
 		return left;
 	}
 
@@ -85,7 +118,7 @@ public:
 	/// <returns></returns>
 	NodePtr getRightChild(int version) const
 	{
-		NodePtr right = _changeType == ChangeType::RightChild && version >= _changeTime ? _change.child : _rightChild;
+		NodePtr right = getChangeType() == ChangeType::RightChild && version >= _changeTime ? _change.child : _rightChild;
 		return right;
 	}
 
@@ -95,10 +128,21 @@ public:
 	/// <returns></returns>
 	Type * getValue(int version)
 	{
-		Type * value = _changeType == ChangeType::Value && version >= _changeTime ? _change.value : _value;
+		Type * value = getChangeType() == ChangeType::Value && version >= _changeTime ? _change.value : _value;
 		return value;
 	}
 
+	/// <summary>
+	/// Sprawdza, czy prefiks klucza opisuje wartosc wezla w podanej wersji.
+	/// Prefiks wyznaczany jest z wartosci poczatkowej, wiec nie opisuje wartosci z pola zmiany.
+	/// </summary>
+	/// <param name="version">Wersja.</param>
+	/// <returns></returns>
+	bool hasKeyPrefix(int version) const
+	{
+		return getChangeType() != ChangeType::Value || version < _changeTime;
+	}
+
 	void setLeftChild(NodePtr child)
 	{
 		_leftChild = child;
@@ -122,9 +166,9 @@ public:
 	/// <param name="time">Wersja drzewa.</param>
 	void setChange(ChangeType type, NodePtr child, int time)
 	{
-		_changeType = type;
 		_changeTime = time;
 		_change.child = child;
+		_changeType.store(type, std::memory_order_release);
 	}
 
 	/// <summary>
@@ -135,14 +179,14 @@ public:
 	/// <param name="time">Wersja drzewa.</param>
 	void setChange(ChangeType type, Type & value, int time)
 	{
-		_changeType = type;
 		_changeTime = time;
 		_change.value = &value;
+		_changeType.store(type, std::memory_order_release);
 	}
 
-	ChangeType getChangeType()
+	ChangeType getChangeType() const
 	{
-		return _changeType;
+		return _changeType.load(std::memory_order_acquire);
 	}
 
 	int getChangeTime()
@@ -1,25 +1,32 @@
 #pragma once
+#include <atomic>
 #include <cstddef>
+#include <memory>
 #include "Node.h"
 
 /// <summary>
 /// Alokator dla wezlow drzewa o szablonowyn parametrze T.
+/// Liczniki sa atomowe, bo operacje na zbiorach alokuja wezly z wielu watkow naraz.
+/// Pamiec przydzielana jest przez alokator Allocator, co pozwala umiescic wezly np. w pliku odwzorowanym w pamieci.
 /// </summary>
-template <class T>
+template <class T, class NodeValue = Node<T>, class Allocator = std::allocator<NodeValue>>
 class NodeAllocator
 {
-	typedef Node<T> NodeValue;
+	/// <summary>
+	/// Alokator pamieci wezlow
+	/// </summary>
+	Allocator _memory;
 
 	/// <summary>
 	/// Liczba zaalokowanych wezlow
 	/// </summary>
-	int _nodeCounter;
+	std::atomic<int> _nodeCounter;
 
 
 	/// <summary>
 	/// Suma zaalokowanej pamieci w bajtach
 	/// </summary>
-	std::size_t _totalSize;
+	std::atomic<std::size_t> _totalSize;
 
 public:
 	/// <summary>
@@ -29,6 +36,14 @@ public:
 	{
 	}
 
+	/// <summary>
+	/// Konstruktor klasy <see cref="NodeAllocator"/> przydzielajacy pamiec podanym alokatorem.
+	/// </summary>
+	/// <param name="memory">Alokator pamieci wezlow.</param>
+	explicit NodeAllocator(Allocator const & memory) noexcept : _memory(memory), _nodeCounter(0), _totalSize(0)
+	{
+	}
+
 	/// <summary>
 	/// Alokuje pamiec na wskazana liczbe wezlow
 	/// </summary>
@@ -38,7 +53,7 @@ public:
 	NodeValue * allocate(std::size_t n, void const * = 0)
 	{
 		auto size = n * sizeof(NodeValue);
-		NodeValue * t = (NodeValue*)malloc(size);
+		NodeValue * t = _memory.allocate(n);
 		_totalSize += size;
 		return t;
 	}
@@ -53,7 +68,7 @@ public:
 		if (p)
 		{
 			_totalSize -= sizeof(*p);
-			free(p);
+			_memory.deallocate(p, 1);
 		}
 	}
 
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <algorithm>
+
+/// <summary>
+/// Stos wskaznikow na wezly z buforem wbudowanym w obiekt.
+/// Dopoki glebokosc sciezki nie przekracza pojemnosci bufora, stos nie alokuje pamieci,
+/// dopiero bardzo glebokie drzewa powoduja przejscie na pamiec ze sterty.
+/// </summary>
+template<class NodePtr, std::size_t InlineCapacity = 64>
+class NodeStack
+{
+	/// <summary>
+	/// Bufor wbudowany.
+	/// </summary>
+	NodePtr _inline[InlineCapacity];
+
+	/// <summary>
+	/// Aktualny bufor, wbudowany albo zaalokowany na stercie.
+	/// </summary>
+	NodePtr * _data;
+
+	/// <summary>
+	/// Liczba elementow na stosie.
+	/// </summary>
+	std::size_t _size;
+
+	/// <summary>
+	/// Pojemnosc aktualnego bufora.
+	/// </summary>
+	std::size_t _capacity;
+
+public:
+	NodeStack() : _data(_inline), _size(0), _capacity(InlineCapacity)
+	{
+	}
+
+	/// <summary>
+	/// Konstruktor kopiujacy. Kopiuje jedynie zajeta czesc bufora.
+	/// </summary>
+	/// <param name="origin">Stos zrodlowy.</param>
+	NodeStack(NodeStack const & origin) : _data(_inline), _size(0), _capacity(InlineCapacity)
+	{
+		assign(origin);
+	}
+
+	NodeStack & operator = (NodeStack const & origin)
+	{
+		if (this != &origin)
+		{
+			_size = 0;
+			assign(origin);
+		}
+		return *this;
+	}
+
+	~NodeStack()
+	{
+		if (_data != _inline)
+			delete[] _data;
+	}
+
+	/// <summary>
+	/// Umieszcza wezel na szczycie stosu.
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	void push(NodePtr node)
+	{
+		if (_size == _capacity)
+			reserve(_capacity * 2);
+		_data[_size++] = node;
+	}
+
+	/// <summary>
+	/// Zdejmuje wezel ze szczytu stosu.
+	/// </summary>
+	void pop()
+	{
+		--_size;
+	}
+
+	/// <summary>
+	/// Zwraca wezel ze szczytu stosu.
+	/// </summary>
+	/// <returns></returns>
+	NodePtr top() const
+	{
+		return _data[_size - 1];
+	}
+
+	bool empty() const
+	{
+		return _size == 0;
+	}
+
+	std::size_t size() const
+	{
+		return _size;
+	}
+
+	void clear()
+	{
+		_size = 0;
+	}
+
+private:
+	/// <summary>
+	/// Kopiuje zawartosc innego stosu, powiekszajac bufor tylko wtedy, gdy jest to konieczne.
+	/// </summary>
+	/// <param name="origin">Stos zrodlowy.</param>
+	void assign(NodeStack const & origin)
+	{
+		if (origin._size > _capacity)
+			reserve(origin._size);
+		std::copy(origin._data, origin._data + origin._size, _data);
+		_size = origin._size;
+	}
+
+	/// <summary>
+	/// Przenosi zawartosc stosu do bufora na stercie o podanej pojemnosci.
+	/// </summary>
+	/// <param name="capacity">Nowa pojemnosc.</param>
+	void reserve(std::size_t capacity)
+	{
+		NodePtr * data = new NodePtr[capacity];
+		std::copy(_data, _data + _size, data);
+		if (_data != _inline)
+			delete[] _data;
+		_data = data;
+		_capacity = capacity;
+	}
+};
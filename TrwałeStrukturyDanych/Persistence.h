@@ -0,0 +1,35 @@
+#pragma once
+#include "ImmutableNode.h"
+#include "Node.h"
+
+/// <summary>
+/// Strategia trwalosci metoda kopiowania wezlow: zmiana trafia do pola zmiany wezla,
+/// a wezel jest kopiowany dopiero wtedy, gdy to pole jest zajete. Zamortyzowany koszt pamieci
+/// to O(1) na zmiane, ale kazdy odczyt dziecka lub wartosci porownuje wersje z czasem zmiany.
+/// </summary>
+struct NodeCopying
+{
+	static const bool IMMUTABLE_NODES = false;
+
+	template<class Type, class Summary>
+	struct NodeOf
+	{
+		typedef Node<Type, Summary> type;
+	};
+};
+
+/// <summary>
+/// Strategia trwalosci metoda kopiowania sciezki: kazda zmiana kopiuje sciezke od korzenia,
+/// a wezly po utworzeniu nie sa juz modyfikowane. Kosztuje O(glebokosc) pamieci na zmiane,
+/// ale odczyt nie sprawdza wersji, a wezel jest mniejszy.
+/// </summary>
+struct PathCopying
+{
+	static const bool IMMUTABLE_NODES = true;
+
+	template<class Type, class Summary>
+	struct NodeOf
+	{
+		typedef ImmutableNode<Type, Summary> type;
+	};
+};
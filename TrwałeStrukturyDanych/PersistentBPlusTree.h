@@ -0,0 +1,404 @@
+#pragma once
+#include "BPlusNode.h"
+#include "BPlusTreeIterator.h"
+#include "KeySearch.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Trwale B+drzewo z szerokimi wezlami, alternatywa dla <see cref="PersistentTree"/> o tym samym wersjonowanym interfejsie.
+/// Wezel przechowuje wiele kluczy, wiec zejscie do liscia kosztuje kilka chybien w pamieci podrecznej zamiast jednego na poziom.
+/// Wpisy wezlow maja przedzialy wersji (patrz BPlusNode): wstawienie dopisuje wpis do wezla, a usuniecie zamyka jego przedzial,
+/// wiec zmiana zwykle modyfikuje jeden wezel w miejscu. Pelny wezel jest kopiowany razem z zywymi wpisami (podzial wersji),
+/// a kopia ze zbyt duza liczba wpisow jest dzielona na dwa wezly (podzial klucza), co propaguje zmiane do rodzica.
+/// Typ wartosci musi miec konstruktor domyslny.
+/// </summary>
+template<class Type, class OrderFunctor = std::less<Type>, int Capacity = BPlusCapacity<Type>::value>
+class PersistentBPlusTree
+{
+	typedef BPlusNode<Type, Capacity> NodeType;
+	typedef NodeType* NodePtr;
+	typedef std::vector<std::pair<int, NodePtr>> RootVec;
+	typedef KeySearch<Type, OrderFunctor> Search;
+
+	/// <summary>
+	/// Identyfikator pierwszej wersji drzewa
+	/// </summary>
+	static const int FIRST_VERSION = 0;
+
+	/// <summary>
+	/// Identyfikator przekierowujacy do aktualnej wersji drzewa
+	/// </summary>
+	static const int CURRENT_VERSION = -1;
+
+	/// <summary>
+	/// Liczba wpisow kopii wezla, powyzej ktorej kopia dzielona jest na dwa wezly.
+	/// Po kazdej kopii w wezle zostaje co najmniej jedna czwarta wolnych miejsc.
+	/// </summary>
+	static const int SPLIT_THRESHOLD = Capacity * 3 / 4;
+
+	/// <summary>
+	/// Maksymalna wysokosc drzewa
+	/// </summary>
+	static const int MAX_DEPTH = 32;
+
+	/// <summary>
+	/// Wpis dodawany do kopii wezla
+	/// </summary>
+	struct Entry
+	{
+		Type key;
+		NodePtr child;
+	};
+
+	/// <summary>
+	/// Sciezka od korzenia do liscia: wezly wewnetrzne i indeksy wpisow, ktorymi zejscie poszlo dalej
+	/// </summary>
+	struct Path
+	{
+		NodePtr nodes[MAX_DEPTH + 1];
+		int indices[MAX_DEPTH + 1];
+		int depth;
+	};
+
+	/// <summary>
+	/// Aktualna wersja drzewa
+	/// </summary>
+	int _version;
+
+	/// <summary>
+	/// Punkty wejscia do drzewa. Nowy wpis powstaje tylko wtedy, gdy zmienia sie korzen
+	/// </summary>
+	RootVec _root;
+
+	/// <summary>
+	/// Obiekt funktora porzadku
+	/// </summary>
+	OrderFunctor orderFunctor;
+
+	/// <summary>
+	/// Wszystkie wezly drzewa, zwalniane razem z nim
+	/// </summary>
+	std::vector<std::unique_ptr<NodeType>> _nodes;
+
+public:
+	typedef BPlusTreeIterator<Type, NodeType> const_iterator;
+	typedef const_iterator iterator;
+
+	/// <summary>
+	/// Rozmiar pojedynczego wezla w bajtach
+	/// </summary>
+	static const std::size_t NODE_SIZE = sizeof(NodeType);
+
+	/// <summary>
+	/// Tworzy nowe, puste drzewo bez historii.
+	/// </summary>
+	PersistentBPlusTree() : _version(FIRST_VERSION)
+	{
+	}
+
+	PersistentBPlusTree(PersistentBPlusTree const &) = delete;
+	PersistentBPlusTree & operator = (PersistentBPlusTree const &) = delete;
+
+	/// <summary>
+	/// Zwraca iterator na poczatek wskazanej wersji drzewa.
+	/// </summary>
+	/// <param name="version">Wersja drzewa. Brak parametru oznacza wersje aktualna</param>
+	/// <returns></returns>
+	const_iterator begin(int version = CURRENT_VERSION) const
+	{
+		NodePtr root = getRoot(version);
+		return const_iterator(root, version);
+	}
+
+	const_iterator end(int = CURRENT_VERSION) const
+	{
+		return const_iterator();
+	}
+
+	/// <summary>
+	/// Wyszukuje podana wartosc w drzewie o wskazanej wersji.
+	/// Jezeli wartosci nie ma w drzewie o podanej wersji, zwracany jest iterator na koniec drzewa.
+	/// </summary>
+	/// <param name="value">Wartosc do wyszukania.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	const_iterator find(Type const & value, int version = CURRENT_VERSION) const
+	{
+		Path path;
+		NodePtr leaf = descend(value, version, path);
+		int index = leaf != nullptr ? findInLeaf(leaf, value, version) : -1;
+		if (index < 0)
+			return end();
+		path.nodes[path.depth] = leaf;
+		path.indices[path.depth] = index;
+		return const_iterator(path.nodes, path.indices, path.depth + 1, version);
+	}
+
+	/// <summary>
+	/// Sprawdza, czy podana wartosc znajduje sie w drzewie o wskazanej wersji.
+	/// </summary>
+	/// <param name="value">Wartosc do wyszukania.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	bool contains(Type const & value, int version = CURRENT_VERSION) const
+	{
+		Path path;
+		NodePtr leaf = descend(value, version, path);
+		return leaf != nullptr && findInLeaf(leaf, value, version) >= 0;
+	}
+
+	/// <summary>
+	/// Umieszcza nowy element w drzewie. Skutkuje utworzeniem nowej wersji drzewa.
+	/// </summary>
+	/// <param name="value">Wartosc do umieszczenia.</param>
+	/// <returns>False, jezeli wartosc juz istnieje.</returns>
+	bool insert(Type const & value)
+	{
+		Path path;
+		int version = _version;
+		NodePtr leaf = descend(value, version, path);
+		if (leaf != nullptr && findInLeaf(leaf, value, version) >= 0)
+			return false;
+		int next = version + 1;
+		if (leaf == nullptr)
+		{
+			NodePtr root = createNode(true);
+			root->append(value, nullptr, next);
+			_root.push_back(std::pair<int, NodePtr>(next, root));
+		}
+		else if (!leaf->isFull())
+		{
+			leaf->insert(Search::upperBound(leaf->getKeys(), leaf->getCount(), value, orderFunctor), value, nullptr, next);
+		}
+		else
+		{
+			Entry entry = { value, nullptr };
+			std::vector<Entry> entries(1, entry);
+			replaceNode(path, path.depth, leaf, entries, next);
+		}
+		confirmChange();
+		return true;
+	}
+
+	/// <summary>
+	/// Usuwa element o podanej wartosci z drzewa. Zamyka jedynie przedzial wersji wpisu w lisciu.
+	/// Skutkuje utworzeniem nowej wersji drzewa.
+	/// </summary>
+	/// <param name="value">Wartosc do usuniecia.</param>
+	/// <returns>False, jezeli wartosci nie ma w drzewie.</returns>
+	bool erase(Type const & value)
+	{
+		Path path;
+		int version = _version;
+		NodePtr leaf = descend(value, version, path);
+		int index = leaf != nullptr ? findInLeaf(leaf, value, version) : -1;
+		if (index < 0)
+			return false;
+		leaf->kill(index, version + 1);
+		confirmChange();
+		return true;
+	}
+
+	/// <summary>
+	/// Zlicza liczbe elementow we wskazanej wersji drzewa.
+	/// </summary>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	int size(int version = CURRENT_VERSION) const
+	{
+		int count = 0;
+		for (const_iterator it = begin(version), last = end(version); it != last; ++it, ++count) {}
+		return count;
+	}
+
+	/// <summary>
+	/// Zwraca numer najnowszej wersji drzewa.
+	/// </summary>
+	/// <returns></returns>
+	int getCurrentVersion() const
+	{
+		return _version;
+	}
+
+	/// <summary>
+	/// Zwraca liczbe wszystkich wezlow zaalokowanych w drzewie.
+	/// </summary>
+	/// <returns></returns>
+	int size_of_history() const
+	{
+		return static_cast<int>(_nodes.size());
+	}
+
+private:
+	/// <summary>
+	/// Schodzi od korzenia wskazanej wersji do liscia, ktorego zakres obejmuje wartosc.
+	/// </summary>
+	/// <param name="value">Wartosc.</param>
+	/// <param name="version">Wersja drzewa. CURRENT_VERSION jest zamieniana na numer aktualnej wersji.</param>
+	/// <param name="path">Sciezka zejscia.</param>
+	/// <returns>Lisc albo nullptr dla pustej wersji.</returns>
+	NodePtr descend(Type const & value, int & version, Path & path) const
+	{
+		path.depth = 0;
+		NodePtr node = getRoot(version);
+		while (node != nullptr && !node->isLeaf())
+		{
+			int index = route(node, value, version);
+			path.nodes[path.depth] = node;
+			path.indices[path.depth] = index;
+			++path.depth;
+			node = node->getChild(index);
+		}
+		return node;
+	}
+
+	/// <summary>
+	/// Wybiera dziecko wezla wewnetrznego: ostatni zywy wpis z kluczem nie wiekszym niz wartosc,
+	/// a dla wartosci mniejszej od wszystkich kluczy pierwszy zywy wpis.
+	/// Zywe wpisy wersji dziela przestrzen kluczy, wiec wpisy martwe mozna pominac.
+	/// </summary>
+	/// <param name="node">Wezel wewnetrzny.</param>
+	/// <param name="value">Wartosc.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns>Indeks wpisu.</returns>
+	int route(NodePtr node, Type const & value, int version) const
+	{
+		int position = Search::upperBound(node->getKeys(), node->getCount(), value, orderFunctor);
+		for (int i = position - 1; i >= 0; --i)
+		{
+			if (node->isAlive(i, version))
+				return i;
+		}
+		int i = position;
+		while (!node->isAlive(i, version))
+			++i;
+		return i;
+	}
+
+	/// <summary>
+	/// Wyszukuje zywy wpis rownowazny wartosci w lisciu.
+	/// </summary>
+	/// <param name="leaf">Lisc.</param>
+	/// <param name="value">Wartosc.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns>Indeks wpisu albo -1.</returns>
+	int findInLeaf(NodePtr leaf, Type const & value, int version) const
+	{
+		int count = leaf->getCount();
+		for (int i = Search::lowerBound(leaf->getKeys(), count, value, orderFunctor); i < count && !orderFunctor(value, leaf->getKey(i)); ++i)
+		{
+			if (leaf->isAlive(i, version))
+				return i;
+		}
+		return -1;
+	}
+
+	/// <summary>
+	/// Zastepuje pelny wezel kopia jego zywych wpisow uzupelniona o nowe wpisy, w razie potrzeby dzielac kopie na dwa wezly.
+	/// Wpis rodzica wskazujacy na stary wezel jest zamykany, a nowe wezly trafiaja do rodzica, co moze wymagac jego kopii.
+	/// </summary>
+	/// <param name="path">Sciezka zejscia.</param>
+	/// <param name="level">Poziom zastepowanego wezla na sciezce.</param>
+	/// <param name="node">Zastepowany wezel.</param>
+	/// <param name="added">Nowe wpisy, posortowane.</param>
+	/// <param name="next">Tworzona wersja.</param>
+	void replaceNode(Path const & path, int level, NodePtr node, std::vector<Entry> const & added, int next)
+	{
+		std::vector<Entry> entries;
+		entries.reserve(node->getCount() + added.size());
+		for (int i = 0; i < node->getCount(); ++i)
+		{
+			if (node->isAlive(i, next))
+			{
+				Entry entry = { node->getKey(i), node->getChild(i) };
+				entries.push_back(entry);
+			}
+		}
+		for (Entry const & entry : added)
+		{
+			auto position = std::upper_bound(entries.begin(), entries.end(), entry,
+				[this](Entry const & lhs, Entry const & rhs) { return orderFunctor(lhs.key, rhs.key); });
+			entries.insert(position, entry);
+		}
+		std::size_t half = entries.size() > static_cast<std::size_t>(SPLIT_THRESHOLD) ? entries.size() / 2 : entries.size();
+		std::vector<Entry> replacements;
+		replacements.push_back(buildNode(node->isLeaf(), entries.begin(), entries.begin() + half, next));
+		if (half < entries.size())
+			replacements.push_back(buildNode(node->isLeaf(), entries.begin() + half, entries.end(), next));
+		// pierwszy klucz wezla wewnetrznego moze byc wiekszy niz najmniejsza wartosc w jego poddrzewie,
+		// bo do skrajnie lewego dziecka trafiaja tez wartosci mniejsze od jego klucza, dlatego
+		// pierwsza kopia zachowuje klucz starego wpisu, o ile jest mniejszy
+		if (level > 0)
+		{
+			Type const & oldKey = path.nodes[level - 1]->getKey(path.indices[level - 1]);
+			if (orderFunctor(oldKey, replacements[0].key))
+				replacements[0].key = oldKey;
+		}
+
+		if (level == 0)
+		{
+			NodePtr root = replacements[0].child;
+			if (replacements.size() > 1)
+				root = buildNode(false, replacements.begin(), replacements.end(), next).child;
+			_root.push_back(std::pair<int, NodePtr>(next, root));
+			return;
+		}
+		NodePtr parent = path.nodes[level - 1];
+		parent->kill(path.indices[level - 1], next);
+		if (parent->getCount() + static_cast<int>(replacements.size()) > Capacity)
+		{
+			replaceNode(path, level - 1, parent, replacements, next);
+			return;
+		}
+		for (Entry const & entry : replacements)
+			parent->insert(Search::upperBound(parent->getKeys(), parent->getCount(), entry.key, orderFunctor), entry.key, entry.child, next);
+	}
+
+	/// <summary>
+	/// Tworzy wezel z podanych wpisow.
+	/// </summary>
+	/// <returns>Wpis rodzica dla nowego wezla: pierwszy klucz i wezel.</returns>
+	template<class Iter>
+	Entry buildNode(bool leaf, Iter first, Iter last, int next)
+	{
+		NodePtr node = createNode(leaf);
+		for (Iter it = first; it != last; ++it)
+			node->append(it->key, it->child, next);
+		Entry entry = { first->key, node };
+		return entry;
+	}
+
+	NodePtr createNode(bool leaf)
+	{
+		_nodes.push_back(std::unique_ptr<NodeType>(new NodeType(leaf)));
+		return _nodes.back().get();
+	}
+
+	/// <summary>
+	/// Potwierdzenie zmiany w historii.
+	/// </summary>
+	void confirmChange()
+	{
+		++_version;
+	}
+
+	/// <summary>
+	/// Zwraca korzen drzewa o wskazanej wersji, wyszukujac go binarnie.
+	/// </summary>
+	/// <param name="version">Wersja. CURRENT_VERSION jest zamieniana na numer aktualnej wersji.</param>
+	/// <returns></returns>
+	NodePtr getRoot(int & version) const
+	{
+		if (version == CURRENT_VERSION)
+			version = _version;
+		auto it = std::upper_bound(_root.begin(), _root.end(), version,
+			[](int version, std::pair<int, NodePtr> const & entry) { return version < entry.first; });
+		if (it == _root.begin())
+			return nullptr;
+		return (it - 1)->second;
+	}
+};
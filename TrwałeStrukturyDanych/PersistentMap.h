@@ -0,0 +1,349 @@
+#pragma once
+#include "PersistentTree.h"
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+/// <summary>
+/// Trwala mapa klucz -> wartosc zbudowana na drzewie <see cref="PersistentTree"/>.
+/// Zmiana wartosci istniejacego klucza jest zapisywana w polu zmiany wezla,
+/// wiec kosztuje O(log n) czasu i zamortyzowane O(1) pamieci na wersje.
+/// Parametr Aggregate okresla monoid agregatu nad wpisami mapy, np. SumAggregate&lt;Entry, MappedValue&lt;Entry&gt;&gt;.
+/// Parametr Persistence okresla strategie trwalosci drzewa (patrz Persistence.h).
+/// </summary>
+template<class Key, class Value, class OrderFunctor = std::less<Key>, class Aggregate = NoAggregate, class Persistence = NodeCopying>
+class PersistentMap
+{
+public:
+	typedef std::pair<const Key, Value> Entry;
+
+private:
+	/// <summary>
+	/// Funktor porzadku porownujacy wpisy mapy wylacznie po kluczu.
+	/// Pozwala tez porownywac wpis z samym kluczem, dzieki czemu wyszukiwanie nie tworzy wpisu tymczasowego.
+	/// Metoda compare porownuje klucze trojwartosciowo (patrz ThreeWayOrder.h), a metoda hash haszuje sam klucz
+	/// dla indeksu aktualnej wersji (patrz HeadIndex.h), o ile klucz ma skrot.
+	/// </summary>
+	struct EntryOrder
+	{
+		typedef void is_transparent;
+
+		OrderFunctor orderFunctor;
+
+		bool operator () (Entry const & lhs, Entry const & rhs) const
+		{
+			return orderFunctor(lhs.first, rhs.first);
+		}
+
+		bool operator () (Key const & lhs, Entry const & rhs) const
+		{
+			return orderFunctor(lhs, rhs.first);
+		}
+
+		bool operator () (Entry const & lhs, Key const & rhs) const
+		{
+			return orderFunctor(lhs.first, rhs);
+		}
+
+		int compare(Entry const & lhs, Entry const & rhs) const
+		{
+			return compareWith(orderFunctor, lhs.first, rhs.first);
+		}
+
+		int compare(Key const & lhs, Entry const & rhs) const
+		{
+			return compareWith(orderFunctor, lhs, rhs.first);
+		}
+
+		int compare(Entry const & lhs, Key const & rhs) const
+		{
+			return compareWith(orderFunctor, lhs.first, rhs);
+		}
+
+		template<class Hashed = Key>
+		typename std::enable_if<ValueHash<OrderFunctor, Hashed>::HASHABLE, std::size_t>::type hash(Entry const & entry) const
+		{
+			return ValueHash<OrderFunctor, Hashed>::hash(orderFunctor, entry.first);
+		}
+
+		template<class Hashed = Key>
+		typename std::enable_if<ValueHash<OrderFunctor, Hashed>::HASHABLE, std::size_t>::type hash(Key const & key) const
+		{
+			return ValueHash<OrderFunctor, Hashed>::hash(orderFunctor, key);
+		}
+	};
+
+	typedef PersistentTree<Entry, EntryOrder, Aggregate, Persistence> Tree;
+
+	/// <summary>
+	/// Drzewo przechowujace wpisy mapy
+	/// </summary>
+	Tree _tree;
+
+public:
+	typedef typename Tree::const_iterator const_iterator;
+	typedef typename Tree::Summary Summary;
+	typedef typename Tree::const_reverse_iterator const_reverse_iterator;
+
+	/// <summary>
+	/// Identyfikator przekierowujacy do aktualnej wersji mapy
+	/// </summary>
+	static const int CURRENT_VERSION = -1;
+
+	/// <summary>
+	/// Wstawia nowy klucz z wartoscia. Skutkuje utworzeniem nowej wersji mapy.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="value">Wartosc.</param>
+	/// <returns>False, jezeli klucz juz istnieje.</returns>
+	bool insert(Key const & key, Value const & value)
+	{
+		return _tree.insert(Entry(key, value));
+	}
+
+	/// <summary>
+	/// Przypisuje wartosc do klucza. Dla istniejacego klucza nowa wartosc jest zapisywana w polu zmiany wezla,
+	/// bez usuwania i ponownego wstawiania. Skutkuje utworzeniem nowej wersji mapy.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="value">Wartosc.</param>
+	/// <returns>True, jezeli klucz zostal wstawiony, false, jezeli zmieniono wartosc istniejacego klucza.</returns>
+	bool assign(Key const & key, Value const & value)
+	{
+		Entry entry(key, value);
+		if (_tree.replace(entry))
+			return false;
+		return _tree.insert(entry);
+	}
+
+	/// <summary>
+	/// Usuwa klucz z mapy. Skutkuje utworzeniem nowej wersji mapy.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <returns>False, jezeli klucza nie ma w mapie.</returns>
+	bool erase(Key const & key)
+	{
+		return _tree.erase(key);
+	}
+
+	/// <summary>
+	/// Usuwa zawartosc mapy i zapisuje ten stan jako nowa wersje
+	/// </summary>
+	void clear()
+	{
+		_tree.clear();
+	}
+
+	/// <summary>
+	/// Usuwa wszystkie klucze z przedzialu [from, to) i zapisuje wynik jako jedna nowa wersje mapy.
+	/// </summary>
+	/// <param name="from">Poczatek przedzialu (wlacznie).</param>
+	/// <param name="to">Koniec przedzialu (wylacznie).</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int eraseRange(Key const & from, Key const & to)
+	{
+		return _tree.eraseRange(from, to);
+	}
+
+	/// <summary>
+	/// Dzieli aktualna wersje mapy na dwie nowe wersje: z kluczami mniejszymi od podanego i z pozostalymi.
+	/// </summary>
+	/// <param name="key">Klucz podzialu.</param>
+	/// <returns>Numery wersji z lewa i prawa czescia.</returns>
+	std::pair<int, int> split(Key const & key)
+	{
+		return _tree.split(key);
+	}
+
+	/// <summary>
+	/// Zapisuje jako nowa wersje zlaczenie dwoch wersji mapy, z ktorych pierwsza ma jedynie klucze mniejsze od kluczy drugiej.
+	/// </summary>
+	/// <param name="left">Wersja z mniejszymi kluczami.</param>
+	/// <param name="right">Wersja z wiekszymi kluczami.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int join(int left, int right)
+	{
+		return _tree.join(left, right);
+	}
+
+	/// <summary>
+	/// Wyszukuje klucz w mapie o wskazanej wersji. Wpis wskazywany przez iterator ma wartosc z tej wersji.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="version">Wersja mapy.</param>
+	/// <returns></returns>
+	const_iterator find(Key const & key, int version = CURRENT_VERSION) const
+	{
+		return _tree.find(key, version);
+	}
+
+	/// <summary>
+	/// Zwraca wartosc klucza w mapie o wskazanej wersji.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="version">Wersja mapy.</param>
+	/// <returns>Wskaznik na wartosc albo nullptr, jezeli klucza nie ma w tej wersji.</returns>
+	Value const * lookup(Key const & key, int version = CURRENT_VERSION) const
+	{
+		Entry const * entry = _tree.lookup(key, version);
+		return entry != nullptr ? &entry->second : nullptr;
+	}
+
+	bool contains(Key const & key, int version = CURRENT_VERSION) const
+	{
+		return _tree.contains(key, version);
+	}
+
+	const_iterator begin(int version = CURRENT_VERSION) const
+	{
+		return _tree.begin(version);
+	}
+
+	const_iterator end(int version = CURRENT_VERSION) const
+	{
+		return _tree.end(version);
+	}
+
+	const_reverse_iterator rbegin(int version = CURRENT_VERSION) const
+	{
+		return const_reverse_iterator(end(version));
+	}
+
+	const_reverse_iterator rend(int version = CURRENT_VERSION) const
+	{
+		return const_reverse_iterator(begin(version));
+	}
+
+	/// <summary>
+	/// Zlicza liczbe kluczy we wskazanej wersji mapy.
+	/// </summary>
+	/// <param name="version">Wersja mapy.</param>
+	/// <returns></returns>
+	int size(int version = CURRENT_VERSION) const
+	{
+		return _tree.size(version);
+	}
+
+	/// <summary>
+	/// Zwraca agregat wszystkich wpisow wskazanej wersji mapy. Dostepne dla map z agregatem.
+	/// </summary>
+	/// <param name="version">Wersja mapy.</param>
+	/// <returns></returns>
+	Summary aggregate(int version = CURRENT_VERSION) const
+	{
+		return _tree.aggregate(version);
+	}
+
+	/// <summary>
+	/// Zwraca agregat wpisow o kluczach z przedzialu [from, to) we wskazanej wersji mapy. Dostepne dla map z agregatem.
+	/// </summary>
+	/// <param name="from">Poczatek przedzialu (wlacznie).</param>
+	/// <param name="to">Koniec przedzialu (wylacznie).</param>
+	/// <param name="version">Wersja mapy.</param>
+	/// <returns></returns>
+	Summary rangeAggregate(Key const & from, Key const & to, int version = CURRENT_VERSION) const
+	{
+		return _tree.rangeAggregate(from, to, version);
+	}
+
+	/// <summary>
+	/// Zwraca numer najnowszej wersji mapy.
+	/// </summary>
+	/// <returns></returns>
+	int getCurrentVersion() const
+	{
+		return _tree.getCurrentVersion();
+	}
+
+	/// <summary>
+	/// Przypisuje znacznik czasu lub identyfikator commitu aktualnej wersji mapy.
+	/// </summary>
+	/// <param name="timestamp">Znacznik czasu.</param>
+	/// <returns>False, jezeli znacznik jest wczesniejszy niz znacznik poprzedniej wersji.</returns>
+	bool stamp(Timestamp timestamp)
+	{
+		return _tree.stamp(timestamp);
+	}
+
+	/// <summary>
+	/// Zwraca najnowsza wersje oznaczona znacznikiem nie pozniejszym niz podany.
+	/// </summary>
+	/// <param name="timestamp">Znacznik czasu.</param>
+	/// <returns></returns>
+	int versionAt(Timestamp timestamp) const
+	{
+		return _tree.versionAt(timestamp);
+	}
+
+	const_iterator find(Key const & key, Timestamp timestamp) const
+	{
+		return find(key, versionAt(timestamp));
+	}
+
+	Value const * lookup(Key const & key, Timestamp timestamp) const
+	{
+		return lookup(key, versionAt(timestamp));
+	}
+
+	const_iterator begin(Timestamp timestamp) const
+	{
+		return begin(versionAt(timestamp));
+	}
+
+	const_iterator end(Timestamp timestamp) const
+	{
+		return end(versionAt(timestamp));
+	}
+
+	int size(Timestamp timestamp) const
+	{
+		return size(versionAt(timestamp));
+	}
+
+	/// <summary>
+	/// Wlacza prowadzenie indeksu czasu zycia kluczy.
+	/// </summary>
+	void enableLifetimeIndex()
+	{
+		_tree.enableLifetimeIndex();
+	}
+
+	/// <summary>
+	/// Wlacza indeks haszujacy aktualnej wersji, przyspieszajacy contains i lookup dla aktualnej wersji mapy.
+	/// </summary>
+	void enableHeadIndex()
+	{
+		_tree.enableHeadIndex();
+	}
+
+	/// <summary>
+	/// Zwraca posortowane przedzialy wersji, w ktorych klucz istnial w mapie.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <returns></returns>
+	std::vector<VersionRange> const & lifetime(Key const & key) const
+	{
+		return _tree.lifetime(key);
+	}
+
+	/// <summary>
+	/// Sprawdza, czy klucz istnial w ktorejkolwiek z wersji od first do last wlacznie.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="first">Pierwsza wersja.</param>
+	/// <param name="last">Ostatnia wersja.</param>
+	/// <returns></returns>
+	bool existedBetween(Key const & key, int first, int last) const
+	{
+		return _tree.existedBetween(key, first, last);
+	}
+
+	/// <summary>
+	/// Zwraca liczbe wszystkich wezlow zaalokowanych w mapie.
+	/// </summary>
+	/// <returns></returns>
+	int size_of_history()
+	{
+		return _tree.size_of_history();
+	}
+};
@@ -1,9 +1,33 @@
 #pragma once
 #include "PersistentTreeIterator.h"
+#include "Prefetch.h"
 #include "NodeAllocator.h"
+#include "NodeStack.h"
+#include "TaskPool.h"
 #include "Node.h"
+#include "KeyPrefix.h"
+#include "ThreeWayOrder.h"
+#include "Aggregates.h"
+#include "Fingerprint.h"
+#include "HeadIndex.h"
+#include "HistoryArchive.h"
+#include "LifetimeIndex.h"
+#include "Persistence.h"
+#include "SharedValue.h"
+#include "Storage.h"
+#include "VersionIndex.h"
+#include "VersionStatistics.h"
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
 #include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include <unordered_set>
 
@@ -11,12 +35,30 @@
 /// Klasa reprezentujaca trwale drzewo poszukiwan binarnych.
 /// Zastosowany algorytm to metoda Sleatora, Tarjana i innych
 /// Parametr szablonowy Type okresla typ danych, jaki przechowywany w drzewie oraz funkcje porzadku
+/// Parametr Aggregate okresla monoid agregatu poddrzewa przechowywanego w kazdym wezle (patrz Aggregates.h).
+/// Parametr Persistence okresla strategie trwalosci (patrz Persistence.h): NodeCopying z polem zmiany w wezle
+/// albo PathCopying z niezmiennymi wezlami. Obie strategie maja ten sam interfejs i iterator.
+/// Drzewo z agregatem zawsze modyfikowane jest przez kopiowanie sciezki, bo kazda zmiana zmienia agregaty
+/// wszystkich przodkow, a wezel ma tylko jedno pole zmiany.
+/// Parametr Storage okresla miejsce przechowywania drzewa (patrz Storage.h): HeapStorage w pamieci procesu
+/// albo MappedStorage w pliku odwzorowanym w pamieci.
 /// </summary>
-template<class Type, class OrderFunctor = std::less<Type>>
+template<class Type, class OrderFunctor = std::less<Type>, class Aggregate = NoAggregate, class Persistence = NodeCopying, class Storage = HeapStorage>
 class PersistentTree
 {	
-	typedef Node<Type>* NodePtr;
-	typedef std::vector<std::pair<int, NodePtr>> RootVec;
+public:
+	typedef typename Aggregate::Summary Summary;
+
+private:
+	typedef typename Persistence::template NodeOf<Type, Summary>::type NodeType;
+	typedef NodeType* NodePtr;
+	typedef typename Storage::template AllocatorOf<std::pair<int, NodePtr>>::type RootAllocator;
+	typedef std::vector<std::pair<int, NodePtr>, RootAllocator> RootVec;
+	typedef typename Storage::template AllocatorOf<NodeType>::type NodeMemory;
+	typedef NodeAllocator<Type, NodeType, NodeMemory> NodeAllocatorType;
+	typedef typename Storage::template ValueAllocatorOf<Type>::type ValueAllocator;
+	typedef SharedValue<Type> SharedValues;
+	typedef typename Storage::template AllocatorOf<typename SharedValues::Block>::type BlockAllocator;
 
 	/// <summary>
 	/// Identyfikator pierwszej wersji drzewa
@@ -28,15 +70,41 @@ class PersistentTree
 	/// </summary>
 	static const int CURRENT_VERSION = -1;
 
+	/// <summary>
+	/// Stan drzewa potrzebny do odtworzenia wszystkich wersji. Drzewo w pliku odwzorowanym w pamieci
+	/// przechowuje go w tym pliku, wiec ponowne otwarcie wymaga jedynie odczytania wskaznika na stan.
+	/// </summary>
+	struct State
+	{
+		int version;
+		RootVec root;
+		NodeAllocatorType allocator;
+
+		explicit State(ArenaHeap * heap) : version(FIRST_VERSION), root(Storage::template allocator<RootAllocator>(heap)),
+			allocator(Storage::template allocator<NodeMemory>(heap))
+		{
+		}
+	};
+
+	/// <summary>
+	/// Stan drzewa przechowywanego w pamieci procesu
+	/// </summary>
+	State _ownState;
+
+	/// <summary>
+	/// Okresla, czy stan drzewa lezy w pliku odwzorowanym w pamieci. Takie drzewo nie zwalnia wezlow przy zniszczeniu
+	/// </summary>
+	bool _mapped;
+
 	/// <summary>
 	/// Aktualna wersja drzewa. Zaczyna sie od jedynki, kazda nowa wersja skutkuje inkrementacja tej wartosci
 	/// </summary>
-	int _version;
+	int & _version;
 
 	/// <summary>
 	/// Punkty wejscia do drzewa. Klucz oznacza numer historii, wartoscia jest wskaznik na korzen
 	/// </summary>
-	RootVec _root;
+	RootVec & _root;
 
 	/// <summary>
 	/// Obiekt funktora porzadku
@@ -46,21 +114,286 @@ class PersistentTree
 	/// <summary>
 	/// Alokator dla wezlow drzewa
 	/// </summary>
-	NodeAllocator<Type> _allocator;
+	NodeAllocatorType & _allocator;
 
 	/// <summary>
 	/// Pomocniczy alokator dla tworzenia zlozonych obiektow przy zmianie wartosci wezla
 	/// </summary>
-	std::allocator<Type> _typeAllocator;
+	ValueAllocator _typeAllocator;
+
+	/// <summary>
+	/// Alokator blokow wartosci wspoldzielonych przez kopie wezlow (patrz SharedValue.h)
+	/// </summary>
+	BlockAllocator _blockAllocator;
+
+	/// <summary>
+	/// Indeks znacznikow czasu przypisanych wersjom drzewa
+	/// </summary>
+	VersionIndex _timestamps;
+
+	/// <summary>
+	/// Statystyki wersji drzewa, indeksowane numerem wersji. Nieznane statystyki uzupelniane sa przy pierwszym
+	/// odczycie (patrz statisticsOf), dlatego moga sie zmieniac w metodach stalych.
+	/// </summary>
+	mutable std::vector<VersionStatistics<Type>> _statistics;
+
+	/// <summary>
+	/// Chroni statystyki uzupelniane przez rownoczesne odczyty
+	/// </summary>
+	mutable std::mutex _statisticsMutex;
+
+	/// <summary>
+	/// Dziennik wypelnien pol zmian: pary wersja - wezel, w kolejnosci wersji. Pozwala znalezc wezly czytane
+	/// w nowszych wersjach inaczej niz w podanej. Nie jest zapisywany w pliku, tak jak statystyki.
+	/// </summary>
+	std::vector<std::pair<int, NodePtr>> _slotChanges;
+
+	/// <summary>
+	/// Wersja, od ktorej dziennik wypelnien pol zmian jest kompletny
+	/// </summary>
+	int _slotChangesFrom;
+
+	/// <summary>
+	/// Indeks czasu zycia kluczy, prowadzony po wywolaniu enableLifetimeIndex
+	/// </summary>
+	LifetimeIndex<Type, OrderFunctor> _lifetimes;
+
+	/// <summary>
+	/// Okresla, czy indeks czasu zycia kluczy jest prowadzony
+	/// </summary>
+	bool _lifetimesEnabled;
+
+	/// <summary>
+	/// Wersja, od ktorej prowadzony jest indeks czasu zycia kluczy
+	/// </summary>
+	int _lifetimesFrom;
+
+	typedef HeadIndex<Type, OrderFunctor> HeadIndexType;
+
+	/// <summary>
+	/// Indeks haszujacy aktualnej wersji, prowadzony po wywolaniu enableHeadIndex
+	/// </summary>
+	HeadIndexType _headIndex;
+
+	/// <summary>
+	/// Okresla, czy indeks haszujacy aktualnej wersji jest prowadzony
+	/// </summary>
+	bool _headIndexEnabled;
+
+	typedef HistoryArchive<Type, OrderFunctor> Archive;
+
+	/// <summary>
+	/// Skompresowane archiwum wersji starszych niz jego wersja, tworzone przez archiveBefore
+	/// </summary>
+	std::unique_ptr<Archive> _archive;
+
+	/// <summary>
+	/// Liczba trwajacych zapisow wersji w tle. Dopoki jest dodatnia, wezly drzewa nie moga zostac zwolnione
+	/// </summary>
+	int _snapshots;
+	std::mutex _snapshotMutex;
+	std::condition_variable _snapshotDone;
+
+	/// <summary>
+	/// Okresla, czy wezly przechowuja agregat poddrzewa
+	/// </summary>
+	typedef std::integral_constant<bool, !std::is_void<Summary>::value> IsAggregated;
+
+	/// <summary>
+	/// Okresla, czy drzewo jest modyfikowane przez kopiowanie sciezki, czyli czy jego wezly po utworzeniu nie sa zmieniane
+	/// </summary>
+	typedef std::integral_constant<bool, IsAggregated::value || Persistence::IMMUTABLE_NODES> HasImmutableNodes;
+
+	/// <summary>
+	/// Okresla, czy kopie wezlow wspoldziela wartosc z oryginalem zamiast ja kopiowac
+	/// </summary>
+	typedef IsSharedValue<Type> HasSharedValues;
+
+	/// <summary>
+	/// Poddrzewo wejscia operacji na zbiorach, czytane w podanej wersji.
+	/// Poddrzewo wspoldzielone mozna podpiac do nowej wersji bez kopiowania, bo czytane w niej daje te same wartosci.
+	/// Wartosci poddrzewa lokalnego, czyli nalezacego do tego drzewa, moga byc wspoldzielone przez kopie jego wezlow.
+	/// </summary>
+	struct Subtree
+	{
+		NodePtr node;
+		int version;
+		bool shared;
+		bool local;
+	};
+
+	/// <summary>
+	/// Krok sciezki kopiowanej przez podzial poddrzewa: wezel, ktorego jedno dziecko zastepowane jest wynikiem
+	/// nizszych krokow, a drugie podpinane bez zmian.
+	/// </summary>
+	struct PathStep
+	{
+		Subtree subtree;
+		bool right;
+	};
+
+	typedef std::vector<NodePtr> NodeList;
+	typedef NodeStack<PathStep> PathSteps;
+
+	/// <summary>
+	/// Operacja na zbiorach
+	/// </summary>
+	enum class SetOperation
+	{
+		Union,
+		Intersection,
+		Difference
+	};
+
+	/// <summary>
+	/// Podproblem operacji na zbiorach czekajacy na wyniki dla lewej i prawej czesci.
+	/// </summary>
+	struct SetStep
+	{
+		Subtree first;
+		std::pair<NodePtr, NodePtr> parts;
+		bool found;
+		bool leftDone;
+		NodePtr left;
+	};
+
+	/// <summary>
+	/// Pozycja przejscia wersji w kolejnosci przy wyznaczaniu zmian miedzy wersjami: cale poddrzewo, ktorego elementy
+	/// nie zostaly jeszcze odwiedzone, albo sama wartosc wezla.
+	/// </summary>
+	struct ChangeStep
+	{
+		NodePtr node;
+		bool whole;
+	};
+
+	typedef NodeStack<ChangeStep> ChangeSteps;
+
+	/// <summary>
+	/// Wezel aktualnej wersji czekajacy w update na wyniki zmian w lewym i prawym poddrzewie. Zmiany
+	/// z przedzialu [first, middle) dotycza lewego poddrzewa, a pozostale, poza zmiana klucza wezla, prawego.
+	/// </summary>
+	struct UpdateStep
+	{
+		Subtree subtree;
+		std::size_t first;
+		std::size_t middle;
+		std::size_t last;
+		bool found;
+		bool leftDone;
+		NodePtr left;
+	};
+
+	/// <summary>
+	/// Liczba wezlow wejscia, od ktorej operacje na zbiorach wykonywane sa rownolegle
+	/// </summary>
+	static const int PARALLEL_THRESHOLD = 1 << 14;
+
+	/// <summary>
+	/// Liczba wyszukiwan prowadzonych naprzemiennie przez lookupBatch
+	/// </summary>
+	static const int BATCH_WIDTH = 16;
 
 public:
-	typedef PersistentTreeIterator<Type> iterator;
-	typedef PersistentTreeIterator<const Type> const_iterator;
+	typedef Type value_type;
+	typedef OrderFunctor value_compare;
+	/// <summary>
+	/// Wartosci w wezlach sa wspoldzielone przez wersje drzewa, a ich polozenie wyznacza porzadek, dlatego jak
+	/// w std::set oba iteratory daja dostep tylko do odczytu.
+	/// </summary>
+	typedef PersistentTreeIterator<const Type, NodeType> const_iterator;
+	typedef const_iterator iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+	/// <summary>
+	/// Rodzaj zmiany klucza zapisywanej przez update
+	/// </summary>
+	enum class UpdateKind
+	{
+		/// <summary>
+		/// Wstawienie wartosci, jezeli w drzewie nie ma elementu rownowaznego
+		/// </summary>
+		Insert,
+		/// <summary>
+		/// Usuniecie elementu rownowaznego wartosci
+		/// </summary>
+		Erase,
+		/// <summary>
+		/// Zastapienie elementu rownowaznego wartoscia albo jej wstawienie
+		/// </summary>
+		Assign
+	};
+
+	/// <summary>
+	/// Zmiana jednego klucza zapisywana przez update: rodzaj zmiany i wartosc
+	/// </summary>
+	typedef std::pair<UpdateKind, Type const *> Update;
+
+	/// <summary>
+	/// Rozmiar pojedynczego wezla w bajtach, bez przechowywanej wartosci
+	/// </summary>
+	static const std::size_t NODE_SIZE = sizeof(NodeType);
+
+	/// <summary>
+	/// Widok jednej wersji drzewa: jej korzen i numer. Odczyt przez widok nie siega do katalogu korzeni,
+	/// ktory rosnie przy kazdej zmianie, dlatego widok utworzony w watku modyfikujacym drzewo mozna czytac
+	/// w innych watkach w trakcie dalszych zmian (tak jak w snapshotAsync). Widok jest wazny, dopoki wezly
+	/// jego wersji nie zostana zwolnione.
+	/// </summary>
+	class View
+	{
+		NodePtr _root;
+		int _version;
+		OrderFunctor orderFunctor;
+
+	public:
+		View() : _root(nullptr), _version(FIRST_VERSION)
+		{
+		}
+
+		View(NodePtr root, int version) : _root(root), _version(version)
+		{
+		}
+
+		iterator begin() const
+		{
+			return iterator(_root, _version);
+		}
+
+		iterator end() const
+		{
+			return iterator(_root, _version, true);
+		}
+
+		template<class Key>
+		iterator find(Key const & key) const
+		{
+			return iterator(KeyProbe<Key, Type, OrderFunctor>(key, orderFunctor), _root, _version);
+		}
+
+		int getVersion() const
+		{
+			return _version;
+		}
+	};
 
 	/// <summary>
 	/// Tworzy nowe, puste drzewo bez historii.
 	/// </summary>
-	PersistentTree() : _version(FIRST_VERSION)
+	PersistentTree() : PersistentTree(static_cast<State*>(nullptr), nullptr)
+	{
+	}
+
+	/// <summary>
+	/// Otwiera drzewo zapisane w pliku odwzorowanym w pamieci albo tworzy w nim nowe, puste drzewo.
+	/// Otwarcie odczytuje jedynie wskaznik na stan drzewa, a wezly i wartosci wczytywane sa dopiero przy dostepie,
+	/// wiec czas otwarcia nie zalezy od rozmiaru historii. Dostepne dla strategii MappedStorage.
+	/// Znaczniki czasu, statystyki wersji, indeks czasu zycia i archiwum nie sa zapisywane w pliku.
+	/// Plik musi pozostac otwarty do zniszczenia drzewa, ktore nie zwalnia wtedy wezlow.
+	/// </summary>
+	/// <param name="arena">Otwarty plik.</param>
+	explicit PersistentTree(MappedArena & arena) : PersistentTree(stateIn(arena), arena.heap())
 	{
 	}
 
@@ -69,7 +402,9 @@ public:
 	/// </summary>
 	~PersistentTree()
 	{
-		deallocateNodes();
+		waitForSnapshots();
+		if (!_mapped)
+			deallocateNodes();
 	}
 
 	/// <summary>
@@ -78,7 +413,7 @@ public:
 	/// </summary>
 	/// <param name="values">Wartosci poczatkowe.</param>
 	template <class Iter>
-	PersistentTree(Iter begin, Iter end) : _version(FIRST_VERSION)
+	PersistentTree(Iter begin, Iter end) : PersistentTree()
 	{
 		NodePtr root = allocateNode(*begin);
 		Iter it = begin;
@@ -121,6 +456,7 @@ public:
 			}
 		}
 		_root.push_back(std::pair<int, NodePtr>(FIRST_VERSION, root));
+		_statistics[FIRST_VERSION] = measure(FIRST_VERSION);
 	}
 
 	/// <summary>
@@ -131,8 +467,6 @@ public:
 	iterator begin(int version = CURRENT_VERSION) const
 	{
 		NodePtr root = getRoot(version);
-		if (root == nullptr)
-			return end();
 		iterator it(root, version);
 		return it;
 	}
@@ -146,86 +480,66 @@ public:
 		// jak drzewo juz jest puste to nie ma zmiany
 		if (currentRoot == nullptr)
 			return;
+		if (_lifetimesEnabled)
+		{
+			for (iterator it = begin(_version), last = end(_version); it != last; ++it)
+				_lifetimes.close(*it, _version + 1);
+		}
 		confirmChange();
 		_root.push_back(std::pair<int, NodePtr>(_version, nullptr));
+		_statistics[_version] = VersionStatistics<Type>::empty();
+		_headIndex.clear();
 	}
 
 	/// <summary>
-	/// Zwraca koniec aktualnego drzewa
+	/// Zwraca koniec drzewa. Koniec wskazanej wersji pozwala cofac sie do jej ostatniego elementu.
 	/// </summary>
+	/// <param name="version">Wersja drzewa. Brak parametru oznacza wersje aktualna</param>
 	/// <returns></returns>
-	iterator end() const
+	iterator end(int version = CURRENT_VERSION) const
 	{
-		iterator it;
+		NodePtr root = getRoot(version);
+		iterator it(root, version, true);
 		return it;
 	}
+
+	/// <summary>
+	/// Zwraca iterator odwrotny na ostatni element wskazanej wersji drzewa
+	/// </summary>
+	/// <param name="version">Wersja drzewa. Brak parametru oznacza wersje aktualna</param>
+	/// <returns></returns>
+	reverse_iterator rbegin(int version = CURRENT_VERSION) const
+	{
+		return reverse_iterator(end(version));
+	}
+
+	/// <summary>
+	/// Zwraca koniec iteracji odwrotnej po wskazanej wersji drzewa
+	/// </summary>
+	/// <param name="version">Wersja drzewa. Brak parametru oznacza wersje aktualna</param>
+	/// <returns></returns>
+	reverse_iterator rend(int version = CURRENT_VERSION) const
+	{
+		return reverse_iterator(begin(version));
+	}
 	
 	/// <summary>
 	/// Usuwa element o podanej wartosci z drzewa. Skutkuje utworzeniem nowej wersji drzewa.
 	/// </summary>
 	/// <param name="value">Wartosc do usuniecia.</param>
-	bool erase(Type value)
+	bool erase(Type const & value)
 	{
-		iterator it = find(value, _version);
-		// brak wartosci w drzwie
-		if (it == end())
-			return false;
-		NodePtr node = it.getNode();
-		//_root.push_back(_root[version]);
-		NodePtr rightChild = node->getRightChild(_version);
-		NodePtr leftChild  = node->getLeftChild(_version);
-		NodePtr parent = getParentNode(*node->getValue(_version), _version);
-		if (parent == nullptr)
-		{
-			// usuwamy korzen
-			if (rightChild == nullptr && leftChild != nullptr)
-			{
-				setNewChildForMe(parent, leftChild);
-			}
-			else if (rightChild != nullptr && leftChild == nullptr)
-			{
-				setNewChildForMe(parent, rightChild);
-			}
-			else if (rightChild != nullptr && leftChild != nullptr)
-			{
-				setLargestValueInLeftSubtreeAsChild(node);
-			}
-			else
-			{
-				_root.push_back(std::pair<int, NodePtr>(_version + 1, nullptr));
-			}
-		}
-		else
-		{
-			// usuwamy wezel na glebszym poziomie
-			if (rightChild == nullptr && leftChild == nullptr)
-			{
-				// nie mam dzieci, daj rodzicowi nullptr
-				if (parent->getLeftChild(_version) == node)
-					setLeftChildAsNull(parent);
-				else
-					setRightChildAsNull(parent);
-			}
-			// lewe dziecko istnieje
-			else if (rightChild == nullptr && leftChild != nullptr)
-			{
-				// rodzic otrzymuje zmiane na lewego potomka swego dziecka
-				setNewChildForMe(parent, leftChild);
-			}
-			// prawe dziecko istnieje
-			else if (rightChild != nullptr && leftChild == nullptr)
-			{
-				// rodzic otrzymuje zmiane na prawego potomka swego dziecka
-				setNewChildForMe(parent, rightChild);
-			}
-			// dwoje dzieci istnieje
-			else
-			{
-				setLargestValueInLeftSubtreeAsChild(node);
-			}
-		}
-		confirmChange();
-		return true;
+		return eraseNode(findNode(value, _version));
+	}
+
+	/// <summary>
+	/// Usuwa element rownowazny podanemu kluczowi. Dostepne dla funktorow porzadku z typem is_transparent.
+	/// </summary>
+	/// <param name="key">Klucz do usuniecia.</param>
+	template<class Key, class Order = OrderFunctor, class = typename Order::is_transparent>
+	bool erase(Key const & key)
+	{
+		return eraseNode(findNode(key, _version));
 	}
 	
 	/// <summary>
@@ -235,518 +549,3324 @@ public:
 	/// <param name="value">Wartosc do wyszukania.</param>
 	/// <param name="version">Wersja drzewa.</param>
 	/// <returns></returns>
-	iterator find(Type & value, int version = CURRENT_VERSION) const
+	iterator find(Type const & value, int version = CURRENT_VERSION) const
 	{
 		NodePtr root = getRoot(version);
-		if (root == nullptr)
-			return end();
-		NodePtr currentNode = root;
-		bool found = false;
-		while (!found)
-		{
-			if (orderFunctor(value, *currentNode->getValue(version)))
-				currentNode = currentNode->getLeftChild(version);
-			else if (orderFunctor(*currentNode->getValue(version), value))
-				currentNode = currentNode->getRightChild(version);
-			else
-				found = true;
-			if (currentNode == nullptr)
-				found = true;
-		}
-		iterator it(currentNode, root, orderFunctor, version);
+		iterator it(KeyProbe<Type, Type, OrderFunctor>(value, orderFunctor), root, version);
 		return it;
 	}
 
 	/// <summary>
-	/// Zwraca kopie drzewa o wskazanej wersji.
-	/// Kopia posiada jedynie te wersje, ktora jest jej pierwsza.
+	/// Wyszukuje element rownowazny podanemu kluczowi. Dostepne dla funktorow porzadku z typem is_transparent.
 	/// </summary>
-	/// <param name="version">Wersja.</param>
+	/// <param name="key">Klucz do wyszukania.</param>
+	/// <param name="version">Wersja drzewa.</param>
 	/// <returns></returns>
-	PersistentTree<Type> * getCopy(int version)
+	template<class Key, class Order = OrderFunctor, class = typename Order::is_transparent>
+	iterator find(Key const & key, int version = CURRENT_VERSION) const
 	{
-		if (!getCorrectVersion(version))
-			return nullptr;
-		// wyciagnij wszystkie wartosci z drzewa o podanej wersji
 		NodePtr root = getRoot(version);
-		// jezeli korzen nie istnieje, zwroc nowe puste drzewo
-		if (root == nullptr)
-			return new PersistentTree();
-		std::queue<NodePtr> queue;
-		std::vector<Type> values;
-		queue.push(root);
-		while (!queue.empty())
-		{
-			NodePtr node(queue.front());
-			queue.pop();
-			Type value = node->getValue(version);
-			values.push_back(value);
-			NodePtr leftChild = node->getLeftChild(version);
-			NodePtr rightChild = node->getRightChild(version);
-			if (leftChild != nullptr)
-				queue.push(leftChild);
-			if (rightChild != nullptr)
-				queue.push(rightChild);
-		}
-		return new PersistentTree<Type>(values.begin(), values.end());
+		iterator it(KeyProbe<Key, Type, OrderFunctor>(key, orderFunctor), root, version);
+		return it;
 	}
-	
+
 	/// <summary>
-	/// Zwraca numer najnowszej wersji drzewa.
+	/// Sprawdza, czy podana wartosc znajduje sie w drzewie o wskazanej wersji.
 	/// </summary>
+	/// <param name="value">Wartosc do wyszukania.</param>
+	/// <param name="version">Wersja drzewa.</param>
 	/// <returns></returns>
-	int getCurrentVersion() const
+	bool contains(Type const & value, int version = CURRENT_VERSION) const
 	{
-		return _version;
+		Type const * found;
+		if (findInHead(value, version, found))
+			return found != nullptr;
+		return findNode(value, version) != nullptr;
+	}
+
+	template<class Key, class Order = OrderFunctor, class = typename Order::is_transparent>
+	bool contains(Key const & key, int version = CURRENT_VERSION) const
+	{
+		Type const * found;
+		if (findInHead(key, version, found))
+			return found != nullptr;
+		return findNode(key, version) != nullptr;
 	}
 
 	/// <summary>
-	/// Umieszcza nowy element w drzewie poszukiwan. Skutkuje utworzeniem nowej wersji drzewa.
+	/// Wyszukuje podana wartosc w drzewie o wskazanej wersji bez tworzenia iteratora.
 	/// </summary>
-	/// <param name="value">Wartosc do umieszczenia.</param>
-	bool insert(Type & value)
+	/// <param name="value">Wartosc do wyszukania.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns>Wskaznik na wartosc przechowywana w drzewie albo nullptr, jezeli jej nie ma.</returns>
+	Type const * lookup(Type const & value, int version = CURRENT_VERSION) const
 	{
-		if (find(value) != end())
-			return false;
-		NodePtr root = getRoot(_version);
-		if (root == nullptr)
+		Type const * found;
+		if (findInHead(value, version, found))
+			return found;
+		// wartosc wezla odczytywana jest z uwzglednieniem pola zmiany, wiec wersja musi byc konkretna
+		if (!getCorrectVersion(version))
+			return nullptr;
+		NodePtr node = findNode(value, version);
+		return node != nullptr ? node->getValue(version) : nullptr;
+	}
+
+	template<class Key, class Order = OrderFunctor, class = typename Order::is_transparent>
+	Type const * lookup(Key const & key, int version = CURRENT_VERSION) const
+	{
+		Type const * found;
+		if (findInHead(key, version, found))
+			return found;
+		if (!getCorrectVersion(version))
+			return nullptr;
+		NodePtr node = findNode(key, version);
+		return node != nullptr ? node->getValue(version) : nullptr;
+	}
+
+	/// <summary>
+	/// Wyszukuje wiele kluczy w drzewie o wskazanej wersji, prowadzac naprzemiennie do BATCH_WIDTH niezaleznych zejsc.
+	/// Kazde zejscie zleca pobranie wstepne nastepnego wezla lub wartosci i ustepuje miejsca kolejnemu,
+	/// dzieki czemu jeden watek czeka na wiele odczytow pamieci jednoczesnie zamiast na kazdy po kolei.
+	/// Wynik dla i-tego klucza trafia do results[i], w kolejnosci konczenia sie wyszukiwan.
+	/// </summary>
+	/// <param name="first">Poczatek kluczy.</param>
+	/// <param name="last">Koniec kluczy.</param>
+	/// <param name="results">Poczatek wynikow z dostepem swobodnym: wskaznik na wartosc albo nullptr, jezeli jej nie ma.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	template<class ForwardIterator, class RandomAccessIterator>
+	void lookupBatch(ForwardIterator first, ForwardIterator last, RandomAccessIterator results, int version = CURRENT_VERSION) const
+	{
+		typedef typename std::iterator_traits<ForwardIterator>::value_type Key;
+		struct Search
 		{
-			++_version;
-			NodePtr node = allocateNode(value);
-			_root.push_back(std::pair<int, NodePtr>(_version, node));
-		}
-		else
+			KeyProbe<Key, Type, OrderFunctor> probe;
+			NodePtr node;
+			std::size_t index;
+			bool valueRequested;
+		};
+		NodePtr root = getRoot(version);
+		Search searches[BATCH_WIDTH];
+		int active = 0;
+		std::size_t next = 0;
+		for (; active < BATCH_WIDTH && first != last; ++active, ++first)
+			searches[active] = Search{ KeyProbe<Key, Type, OrderFunctor>(*first, orderFunctor), root, next++, false };
+		while (active > 0)
 		{
-			// utworzenie nowego dziecka
-			NodePtr newChild = allocateNode(value);
-			// uwzglednienie zmian w rodzicach. Jezeli wezel rodzicielski
-			// posiada juz zajety wskaznik zmiany, zostaje on skopiowany
-			// wowczas kolejni rodzice tak samo, jezeli ich pole zmian jest zajete
-			// w najgorszym wypadku zostaje utworzony nowy korzen
-			bool stop = false;
-			NodePtr currentChild = newChild;
-			Type * currentChildValue = &value;
-			do
+			for (int i = 0; i < active;)
 			{
-				NodePtr currentParent = getParentNode(*currentChildValue, _version);
-				// brak rodzica -> dziecko jest nowym korzeniem
-				if (currentParent == nullptr)
+				Search & search = searches[i];
+				NodePtr node = search.node;
+				int order = 0;
+				if (node != nullptr)
 				{
-					++_version;
-					_root.push_back(std::pair<int, NodePtr>(_version, currentChild));
-					stop = true;
+					// wezel jest juz w pamieci podrecznej, wartosc pobierana jest w osobnym kroku
+					if (!search.valueRequested && search.probe.readsValue(node, version))
+					{
+						prefetch(node->getValue(version));
+						search.valueRequested = true;
+						++i;
+						continue;
+					}
+					order = search.probe.compare(node, version);
+				}
+				if (order != 0)
+				{
+					search.node = order < 0 ? node->getLeftChild(version) : node->getRightChild(version);
+					search.valueRequested = false;
+					if (search.node != nullptr)
+						prefetch(search.node);
+					++i;
+					continue;
+				}
+				results[search.index] = node != nullptr ? node->getValue(version) : nullptr;
+				if (first != last)
+				{
+					search = Search{ KeyProbe<Key, Type, OrderFunctor>(*first, orderFunctor), root, next++, false };
+					++first;
+					++i;
 				}
 				else
 				{
-					// jezeli w rodzicu nie ma zmiany, to ja wprowadzamy
-					if (currentParent->getChangeType() == ChangeType::None)
-					{
-						ChangeType type = orderFunctor(*currentChildValue, *currentParent->getValue(_version)) ? ChangeType::LeftChild : ChangeType::RightChild;
-						++_version;
-						currentParent->setChange(type, currentChild, _version);
-						stop = true;
-					}
-					// jezeli w rodzicu jest zmiana, to go kopiujemy
-					// a zmiane wprowadzamy w jego rodzicu
-					// powoduje wykonanie kolejnej iteracji
-					else
-					{
-						// nowy rodzic z nowa wartoscia
-						Type * parentValue = currentParent->getValue(_version);
-						NodePtr leftChild = currentParent->getLeftChild(_version);
-						NodePtr rightChild = currentParent->getRightChild(_version);
+					search = searches[--active];
+				}
+			}
+		}
+	}
 
-						NodePtr newParent = allocateNode(*parentValue);
-						newParent->setLeftChild(leftChild);
-						newParent->setRightChild(rightChild);
+	/// <summary>
+	/// Zastepuje element rownowazny podanej wartosci. Nowa wartosc trafia do pola zmiany wezla,
+	/// a wezel jest kopiowany tylko wtedy, gdy to pole jest juz zajete. Skutkuje utworzeniem nowej wersji drzewa.
+	/// </summary>
+	/// <param name="value">Nowa wartosc.</param>
+	/// <returns>False, jezeli w drzewie nie ma elementu rownowaznego.</returns>
+	bool replace(Type const & value)
+	{
+		NodePtr node = findNode(value, _version);
+		if (node == nullptr)
+			return false;
+		Type const * replaced = replaceValue(node, value, HasImmutableNodes())->getValue(_version);
+		recordReplace(replaced);
+		if (_headIndexEnabled)
+			_headIndex.assign(replaced);
+		return true;
+	}
 
-						if (orderFunctor(*currentChildValue, *parentValue))
-							newParent->setLeftChild(currentChild);
-						else
-							newParent->setRightChild(currentChild);
+	/// <summary>
+	/// Zwraca agregat calej wskazanej wersji drzewa. Dostepne dla drzew z agregatem.
+	/// </summary>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	Summary aggregate(int version = CURRENT_VERSION) const
+	{
+		return summaryOf(getRoot(version));
+	}
 
-						currentChild = newParent;
-						currentChildValue = parentValue;
-					}
+	/// <summary>
+	/// Zwraca odcisk wskazanej wersji drzewa w czasie stalym. Dostepne dla drzew z agregatem FingerprintAggregate.
+	/// Wersje tego samego lub innego drzewa z rownymi odciskami zawieraja, z duzym prawdopodobienstwem, te same wartosci.
+	/// </summary>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	Fingerprint fingerprint(int version = CURRENT_VERSION) const
+	{
+		static_assert(std::is_same<Summary, Fingerprint>::value, "Fingerprints require FingerprintAggregate");
+		return aggregate(version);
+	}
+
+	/// <summary>
+	/// Zwraca agregat wartosci z przedzialu [from, to) we wskazanej wersji drzewa.
+	/// Przechodzi jedynie dwie sciezki od wezla, w ktorym rozchodza sie granice przedzialu,
+	/// wiec koszt jest proporcjonalny do glebokosci drzewa. Dostepne dla drzew z agregatem.
+	/// </summary>
+	/// <param name="from">Poczatek przedzialu (wlacznie).</param>
+	/// <param name="to">Koniec przedzialu (wylacznie).</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	template<class Key>
+	Summary rangeAggregate(Key const & from, Key const & to, int version = CURRENT_VERSION) const
+	{
+		return aggregateWithin([this, &from](Type const & value) { return !orderFunctor(value, from); },
+			[this, &to](Type const & value) { return orderFunctor(value, to); }, version);
+	}
+
+	/// <summary>
+	/// Zwraca agregat wartosci lezacych scisle pomiedzy granicami we wskazanej wersji drzewa, w czasie proporcjonalnym
+	/// do glebokosci drzewa, jak rangeAggregate. Pusty wskaznik granicy oznacza przedzial nieograniczony z tej strony.
+	/// </summary>
+	/// <param name="lower">Dolna granica (wylacznie) albo nullptr.</param>
+	/// <param name="upper">Gorna granica (wylacznie) albo nullptr.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	Summary aggregateBetween(Type const * lower, Type const * upper, int version = CURRENT_VERSION) const
+	{
+		return aggregateWithin([this, lower](Type const & value) { return lower == nullptr || orderFunctor(*lower, value); },
+			[this, upper](Type const & value) { return upper == nullptr || orderFunctor(value, *upper); }, version);
+	}
+
+	/// <summary>
+	/// Wywoluje funkcje dla wartosci lezacych scisle pomiedzy granicami, w porzadku rosnacym.
+	/// Pomija poddrzewa spoza przedzialu, wiec koszt to glebokosc drzewa i liczba odwiedzonych wartosci.
+	/// </summary>
+	/// <param name="lower">Dolna granica (wylacznie) albo nullptr.</param>
+	/// <param name="upper">Gorna granica (wylacznie) albo nullptr.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <param name="function">Funkcja wywolywana z wartoscia.</param>
+	template<class Function>
+	void forEachBetween(Type const * lower, Type const * upper, int version, Function function) const
+	{
+		NodePtr node = getRoot(version);
+		NodeStack<NodePtr> stack;
+		while (node != nullptr || !stack.empty())
+		{
+			while (node != nullptr)
+			{
+				// wezel nie wiekszy od dolnej granicy wraz z lewym poddrzewem lezy poza przedzialem
+				if (lower != nullptr && !orderFunctor(*lower, *node->getValue(version)))
+				{
+					node = node->getRightChild(version);
 				}
-			} while (!stop);
+				else
+				{
+					stack.push(node);
+					node = node->getLeftChild(version);
+				}
+			}
+			if (stack.empty())
+				return;
+			node = stack.top();
+			stack.pop();
+			Type const & value = *node->getValue(version);
+			if (upper != nullptr && !orderFunctor(value, *upper))
+				return;
+			function(value);
+			node = node->getRightChild(version);
 		}
-		return true;
 	}
 
 	/// <summary>
-	/// Drukuje drzewo na konsoli
+	/// Porownuje wskazana wersje drzewa z wersja zdalna i wywoluje funkcje dla kazdej roznicy: difference(local, nullptr)
+	/// dla wartosci tylko w tej wersji, difference(nullptr, remote) dla wartosci tylko w wersji zdalnej i difference(local, remote)
+	/// dla wartosci rownowaznych o roznej tresci. Porownuje agregaty przedzialow kluczy wyznaczonych przez wezly tej wersji,
+	/// zaczynajac od calego drzewa, i schodzi tylko do poddrzew, ktorych agregat rozni sie od agregatu zdalnego przedzialu.
+	/// Ma sens dla agregatu FingerprintAggregate; koszt zalezy od liczby roznic, a nie od rozmiaru drzewa.
+	/// Strona zdalna (Peer) udostepnia aggregateBetween(lower, upper), forEachBetween(lower, upper, function)
+	/// i lookup(value, function), jak TreePeer i StreamPeer (patrz TreeSync.h).
 	/// </summary>
-	void print(int version = CURRENT_VERSION) const
+	/// <param name="version">Wersja drzewa.</param>
+	/// <param name="peer">Strona zdalna.</param>
+	/// <param name="difference">Funkcja wywolywana dla roznic, w kolejnosci zejscia.</param>
+	template<class Peer, class Function>
+	void reconcile(int version, Peer & peer, Function difference) const
 	{
+		struct Range
+		{
+			NodePtr node;
+			Type const * lower;
+			Type const * upper;
+			Summary remote;
+		};
+		Type const * const none = nullptr;
 		NodePtr root = getRoot(version);
-		// nie mozna wydrukowac pustego drzewa
-		if (root == nullptr)
-			return;
-		int i = 1;
-		NodePtr right = root->getRightChild(version);
-		NodePtr left = root->getLeftChild(version);
-		printNode(right, version, i);
-		std::cout << *root->getValue(version) << std::endl;
-		printNode(left, version, i);
+		std::vector<Range> stack(1, Range{ root, none, none, peer.aggregateBetween(none, none) });
+		while (!stack.empty())
+		{
+			Range range = stack.back();
+			stack.pop_back();
+			if (summaryOf(range.node) == range.remote)
+				continue;
+			if (range.node == nullptr)
+			{
+				peer.forEachBetween(range.lower, range.upper, [&difference, none](Type const & remote) { difference(none, &remote); });
+				continue;
+			}
+			if (range.remote == Aggregate::identity())
+			{
+				forEachBetween(range.lower, range.upper, version, [&difference, none](Type const & local) { difference(&local, none); });
+				continue;
+			}
+			Type const * value = range.node->getValue(version);
+			Summary left = peer.aggregateBetween(range.lower, value);
+			Summary right = peer.aggregateBetween(value, range.upper);
+			// agregat zdalnego przedzialu sklada sie z obu czesci i, byc moze, wartosci rownowaznej wartosci wezla
+			if (range.remote == Aggregate::combine(left, right))
+				difference(value, none);
+			else if (range.remote != Aggregate::combine(Aggregate::combine(left, Aggregate::lift(*value)), right))
+				peer.lookup(*value, [&difference, value](Type const & remote) { difference(value, &remote); });
+			stack.push_back(Range{ range.node->getRightChild(version), value, range.upper, right });
+			stack.push_back(Range{ range.node->getLeftChild(version), range.lower, value, left });
+		}
 	}
 
 	/// <summary>
-	/// Usuwa zawartosc drzewa wraz z historia
+	/// Zapisuje jako nowa wersje drzewa sume dwoch jego wersji. Dla elementow rownowaznych zachowywana jest wartosc z pierwszej wersji.
+	/// W drzewach kopiujacych sciezke poddrzewa wspolne dla obu wersji sa pomijane bez schodzenia w nie, a w drzewach
+	/// kopiujacych wezly koszt jest liniowy dla wersji starszych niz ostatnia zmiana w miejscu (patrz unionOf z drugim drzewem).
 	/// </summary>
-	void purge()
+	/// <param name="first">Pierwsza wersja.</param>
+	/// <param name="second">Druga wersja.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int unionOf(int first, int second)
 	{
-		deallocateNodes();
-		_root.clear();
-		_version = FIRST_VERSION;
-		_root.push_back(nullptr);
+		return unionOf(first, *this, second);
 	}
 
 	/// <summary>
-	/// Zlicza liczba elementow we wskazanej wersji drzewa.
+	/// Zapisuje jako nowa wersje drzewa sume wskazanej wersji tego drzewa i wskazanej wersji drugiego drzewa.
+	/// Wynik budowany jest przez podzial drugiego drzewa wzgledem wezlow pierwszego i zlaczenie wynikow.
+	/// Poddrzewo osiagalne w obu wejsciach przez ten sam wskaznik jest pomijane w czasie O(1), jezeli w obu czytane jest
+	/// tak samo - w drzewach kopiujacych sciezke, takze we wszystkich drzewach z agregatem, zawsze, a w drzewach kopiujacych
+	/// wezly dla tej samej wersji albo dla dwoch wersji wspoldzielonych.
+	/// W drzewach kopiujacych sciezke wynik wspoldzieli poddrzewa z kazda wersja tego drzewa, a kopiowane sa jedynie
+	/// sciezki podzialu i poddrzewa innych drzew. W drzewach kopiujacych wezly wspoldzielone sa tylko wersje nie starsze
+	/// niz ostatnie wypelnienie pola zmiany przez insert, erase lub replace, np. aktualna wersja, bo wezly starszych
+	/// wersji moga miec pola zmian z pozniejszych wersji. Poddrzewa starszych wersji sa wiec kopiowane w calosci
+	/// i operacja kosztuje O(n) czasu i pamieci nawet dla wersji rozniacych sie kilkoma elementami; czeste operacje
+	/// na takich wersjach wymagaja strategii PathCopying. Dla duzych wejsc niezalezne podproblemy sa wykonywane rownolegle.
 	/// </summary>
-	/// <param name="version">Wersja drzewa, po ktorej nalezy iterowac. Zero oznacza wersje aktualna</param>
-	/// <returns></returns>
-	int size(int version = CURRENT_VERSION) const
+	/// <param name="version">Wersja tego drzewa.</param>
+	/// <param name="other">Drugie drzewo, moze byc tym samym drzewem.</param>
+	/// <param name="otherVersion">Wersja drugiego drzewa.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int unionOf(int version, PersistentTree const & other, int otherVersion)
 	{
-		int count = 0;
-		if (!getCorrectVersion(version))
-			return count;
-		for (iterator it = begin(version); it != end(); ++it, ++count) {}
-		return count;
+		return applySetOperation(version, other, otherVersion, SetOperation::Union);
 	}
 
 	/// <summary>
-	/// Zwraca liczbe wszystkich wezlow zaalokowanych w drzewie.
+	/// Zapisuje jako nowa wersje drzewa czesc wspolna dwoch jego wersji. Wartosci pochodza z pierwszej wersji.
 	/// </summary>
-	/// <returns></returns>
-	int size_of_history()
+	/// <param name="first">Pierwsza wersja.</param>
+	/// <param name="second">Druga wersja.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int intersectionOf(int first, int second)
 	{
-		return _allocator.getNodeCount();
+		return intersectionOf(first, *this, second);
 	}
 
-private:
 	/// <summary>
-	/// Zwraca wskaznik na rodzica wezla o podanej wartosci zgodnie z podana wersja.
+	/// Zapisuje jako nowa wersje drzewa czesc wspolna wskazanej wersji tego drzewa i wskazanej wersji drugiego drzewa.
+	/// Zasady wspoldzielenia i pomijania wspolnych poddrzew sa takie same jak w unionOf.
+	/// </summary>
+	/// <param name="version">Wersja tego drzewa.</param>
+	/// <param name="other">Drugie drzewo, moze byc tym samym drzewem.</param>
+	/// <param name="otherVersion">Wersja drugiego drzewa.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int intersectionOf(int version, PersistentTree const & other, int otherVersion)
+	{
+		return applySetOperation(version, other, otherVersion, SetOperation::Intersection);
+	}
+
+	/// <summary>
+	/// Zapisuje jako nowa wersje drzewa elementy pierwszej wersji, ktorych nie ma w drugiej.
+	/// </summary>
+	/// <param name="first">Pierwsza wersja.</param>
+	/// <param name="second">Druga wersja.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int differenceOf(int first, int second)
+	{
+		return differenceOf(first, *this, second);
+	}
+
+	/// <summary>
+	/// Zapisuje jako nowa wersje drzewa elementy wskazanej wersji tego drzewa, ktorych nie ma we wskazanej wersji drugiego drzewa.
+	/// Zasady wspoldzielenia i pomijania wspolnych poddrzew sa takie same jak w unionOf.
+	/// </summary>
+	/// <param name="version">Wersja tego drzewa.</param>
+	/// <param name="other">Drugie drzewo, moze byc tym samym drzewem.</param>
+	/// <param name="otherVersion">Wersja drugiego drzewa.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int differenceOf(int version, PersistentTree const & other, int otherVersion)
+	{
+		return applySetOperation(version, other, otherVersion, SetOperation::Difference);
+	}
+
+	/// <summary>
+	/// Zapisuje zmiany wielu kluczy jako jedna nowa wersje drzewa. Zmiany musza byc uporzadkowane wedlug kluczy,
+	/// po jednej na klucz. Aktualna wersja przechodzona jest raz i tylko w poddrzewach, ktorych dotycza zmiany,
+	/// wiec kopiowane sa jedynie sciezki do zmienianych kluczy, a wartosci wstawiane w to samo puste miejsce
+	/// tworza pod nim zrownowazone poddrzewo. Liczba elementow nowej wersji wyznaczana jest w tym samym przejsciu.
+	/// </summary>
+	/// <param name="changes">Zmiany w porzadku kluczy.</param>
+	/// <returns>Numer nowej wersji albo aktualnej wersji, jezeli zmiany nie zmieniaja drzewa.</returns>
+	int update(std::vector<Update> const & changes)
+	{
+		NodeList created;
+		int delta = 0;
+		int readVersion = _version;
+		NodePtr previous = getRoot(readVersion);
+		NodePtr root = applyUpdates(changes, delta, created);
+		if (root == previous)
+			return _version;
+		VersionStatistics<Type> const & current = recorded(_version);
+		VersionStatistics<Type> statistics;
+		if (current.isKnown())
+			statistics.size = current.size + delta;
+		return commitResult(root, created, statistics);
+	}
+
+	/// <summary>
+	/// Dzieli aktualna wersje drzewa wzgledem podanej wartosci. Zapisuje dwie nowe wersje: najpierw elementy mniejsze
+	/// od wartosci, a po niej elementy nie mniejsze. Obie czesci wspoldziela z dzielona wersja wszystko poza sciezka
+	/// podzialu, dlatego koszt jest proporcjonalny do glebokosci drzewa. Liczba elementow czesci nie jest znana,
+	/// wiec zlicza ja pierwsze zapytanie o ich statystyki (patrz size).
+	/// </summary>
+	/// <param name="value">Wartosc podzialu.</param>
+	/// <returns>Numery wersji z lewa i prawa czescia.</returns>
+	std::pair<int, int> split(Type const & value)
+	{
+		return splitAt(value);
+	}
+
+	/// <summary>
+	/// Dzieli aktualna wersje drzewa wzgledem klucza. Dostepne dla funktorow porzadku z typem is_transparent.
+	/// </summary>
+	/// <param name="key">Klucz podzialu.</param>
+	/// <returns>Numery wersji z lewa i prawa czescia.</returns>
+	template<class Key, class Order = OrderFunctor, class = typename Order::is_transparent>
+	std::pair<int, int> split(Key const & key)
+	{
+		return splitAt(key);
+	}
+
+	/// <summary>
+	/// Zapisuje jako nowa wersje drzewa zlaczenie dwoch jego wersji. Wszystkie elementy pierwszej wersji musza byc
+	/// mniejsze od elementow drugiej, np. czesci zwrocone przez split. Druga wersja podpinana jest pod skrajnie prawa
+	/// sciezke pierwszej, wiec kopiowana jest tylko ta sciezka. Wspoldzielone sa poddrzewa tak jak w unionOf,
+	/// dlatego czesci zwrocone przez split sa laczone w czasie O(glebokosci) takze w drzewach kopiujacych wezly.
+	/// </summary>
+	/// <param name="left">Wersja z mniejszymi elementami.</param>
+	/// <param name="right">Wersja z wiekszymi elementami.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int join(int left, int right)
+	{
+		return join(left, *this, right);
+	}
+
+	/// <summary>
+	/// Zapisuje jako nowa wersje drzewa zlaczenie wskazanej wersji tego drzewa z wersja drugiego drzewa, ktorej
+	/// elementy musza byc wieksze od elementow wersji tego drzewa; w kompilacji debugowej jest to sprawdzane.
+	/// Wersja innego drzewa jest kopiowana w calosci, bo jego wezly naleza do jego alokatora.
+	/// </summary>
+	/// <param name="version">Wersja tego drzewa z mniejszymi elementami.</param>
+	/// <param name="other">Drzewo z wiekszymi elementami, moze byc tym samym drzewem.</param>
+	/// <param name="otherVersion">Wersja drugiego drzewa.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int join(int version, PersistentTree const & other, int otherVersion)
+	{
+		assert(precedes(version, other, otherVersion) && "join requires every element of the first version to be smaller");
+		NodeList created;
+		NodePtr first = materialize(subtreeOf(*this, version), created);
+		NodePtr second = materialize(subtreeOf(other, otherVersion), created);
+		NodePtr root = concatenate(first, second, created);
+		getCorrectVersion(version);
+		other.getCorrectVersion(otherVersion);
+		VersionStatistics<Type> const & lhs = recorded(version);
+		VersionStatistics<Type> const & rhs = other.recorded(otherVersion);
+		VersionStatistics<Type> statistics;
+		if (lhs.isKnown() && rhs.isKnown())
+			statistics.size = lhs.size + rhs.size;
+		return commitResult(root, created, statistics);
+	}
+
+	/// <summary>
+	/// Usuwa z aktualnej wersji drzewa wszystkie elementy z przedzialu [from, to) i zapisuje wynik jako jedna nowa wersje.
+	/// Kopiowane sa jedynie sciezki do granic przedzialu, a pozostale elementy po obu jego stronach sa laczone.
+	/// Liczba elementow wyniku nie jest znana, wiec zlicza ja pierwsze zapytanie o jego statystyki (patrz size).
+	/// </summary>
+	/// <param name="from">Poczatek przedzialu.</param>
+	/// <param name="to">Koniec przedzialu, nie jest usuwany.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int eraseRange(Type const & from, Type const & to)
+	{
+		return eraseBetween(from, to);
+	}
+
+	/// <summary>
+	/// Usuwa elementy, ktorych klucze naleza do przedzialu [from, to). Dostepne dla funktorow porzadku z typem is_transparent.
+	/// </summary>
+	/// <param name="from">Poczatek przedzialu.</param>
+	/// <param name="to">Koniec przedzialu, nie jest usuwany.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	template<class Key, class Order = OrderFunctor, class = typename Order::is_transparent>
+	int eraseRange(Key const & from, Key const & to)
+	{
+		return eraseBetween(from, to);
+	}
+
+	/// <summary>
+	/// Zwraca kopie drzewa o wskazanej wersji.
+	/// Kopia posiada jedynie te wersje, ktora jest jej pierwsza.
+	/// </summary>
+	/// <param name="version">Wersja.</param>
+	/// <returns></returns>
+	PersistentTree<Type> * getCopy(int version)
+	{
+		if (!getCorrectVersion(version))
+			return nullptr;
+		// wyciagnij wszystkie wartosci z drzewa o podanej wersji
+		NodePtr root = getRoot(version);
+		// jezeli korzen nie istnieje, zwroc nowe puste drzewo
+		if (root == nullptr)
+			return new PersistentTree();
+		std::queue<NodePtr> queue;
+		std::vector<Type> values;
+		queue.push(root);
+		while (!queue.empty())
+		{
+			NodePtr node(queue.front());
+			queue.pop();
+			Type value = node->getValue(version);
+			values.push_back(value);
+			NodePtr leftChild = node->getLeftChild(version);
+			NodePtr rightChild = node->getRightChild(version);
+			if (leftChild != nullptr)
+				queue.push(leftChild);
+			if (rightChild != nullptr)
+				queue.push(rightChild);
+		}
+		return new PersistentTree<Type>(values.begin(), values.end());
+	}
+	
+	/// <summary>
+	/// Zapisuje wartosci wskazanej wersji w porzadku rosnacym w osobnym watku, nie wstrzymujac zmian drzewa.
+	/// Korzen wersji ustalany jest w watku wywolujacym, a watek zapisu czyta tylko wezly tej wersji - pola zmiany
+	/// nowszych wersji sa publikowane atomowo i pomijane wg czasu zmiany. Do konca zapisu wezly sa przypiete:
+	/// purge i destruktor czekaja na zakonczenie wszystkich zapisow.
+	/// </summary>
+	/// <param name="version">Wersja.</param>
+	/// <param name="sink">Funktor wywolywany dla kolejnych wartosci.</param>
+	/// <returns>Future z liczba zapisanych wartosci.</returns>
+	template<class Sink>
+	std::future<std::size_t> snapshotAsync(int version, Sink sink)
+	{
+		NodePtr root = getRoot(version);
+		std::promise<std::size_t> promise;
+		std::future<std::size_t> result = promise.get_future();
+		{
+			std::lock_guard<std::mutex> lock(_snapshotMutex);
+			++_snapshots;
+		}
+		std::thread([this, root, version, sink, promise = std::move(promise)]() mutable
+		{
+			try
+			{
+				std::size_t count = 0;
+				for (iterator it(root, version), last(root, version, true); it != last; ++it, ++count)
+					sink(*it);
+				promise.set_value(count);
+			}
+			catch (...)
+			{
+				promise.set_exception(std::current_exception());
+			}
+			std::lock_guard<std::mutex> lock(_snapshotMutex);
+			--_snapshots;
+			_snapshotDone.notify_all();
+		}).detach();
+		return result;
+	}
+
+	/// <summary>
+	/// Zwraca widok wskazanej wersji drzewa.
+	/// </summary>
+	/// <param name="version">Wersja drzewa. Brak parametru oznacza wersje aktualna</param>
+	/// <returns></returns>
+	View view(int version = CURRENT_VERSION) const
+	{
+		NodePtr root = getRoot(version);
+		return View(root, version);
+	}
+
+	/// <summary>
+	/// Zwraca numer najnowszej wersji drzewa.
+	/// </summary>
+	/// <returns></returns>
+	int getCurrentVersion() const
+	{
+		return _version;
+	}
+
+	/// <summary>
+	/// Przypisuje znacznik czasu lub identyfikator commitu aktualnej wersji drzewa.
+	/// Znaczniki musza byc niemalejace w kolejnosci wersji.
+	/// </summary>
+	/// <param name="timestamp">Znacznik czasu.</param>
+	/// <returns>False, jezeli znacznik jest wczesniejszy niz znacznik poprzedniej wersji.</returns>
+	bool stamp(Timestamp timestamp)
+	{
+		return _timestamps.add(timestamp, _version);
+	}
+
+	/// <summary>
+	/// Zwraca najnowsza wersje oznaczona znacznikiem nie pozniejszym niz podany.
+	/// Wersja jest wyszukiwana binarnie w indeksie znacznikow.
+	/// </summary>
+	/// <param name="timestamp">Znacznik czasu.</param>
+	/// <returns>Numer wersji albo VersionIndex::NO_VERSION, jezeli wszystkie oznaczone wersje sa pozniejsze.</returns>
+	int versionAt(Timestamp timestamp) const
+	{
+		return _timestamps.versionAt(timestamp);
+	}
+
+	/// <summary>
+	/// Wlacza prowadzenie indeksu czasu zycia kluczy, aktualizowanego przez insert, erase i clear, a po operacjach
+	/// zapisujacych wynik w calosci o klucze, ktore usunela lub dodala operacja.
+	/// Klucze obecne w aktualnej wersji sa zapisywane jako istniejace od tej wersji, wiec pelna historie
+	/// otrzymuje sie wlaczajac indeks dla pustego drzewa.
+	/// </summary>
+	void enableLifetimeIndex()
+	{
+		if (_lifetimesEnabled)
+			return;
+		_lifetimesEnabled = true;
+		_lifetimesFrom = _version;
+		for (iterator it = begin(_version), last = end(_version); it != last; ++it)
+			_lifetimes.open(&*it, _version);
+	}
+
+	/// <summary>
+	/// Wlacza indeks haszujacy aktualnej wersji, dzieki ktoremu contains i lookup dla aktualnej wersji dzialaja
+	/// w oczekiwanym czasie stalym zamiast schodzic po drzewie. Indeks jest aktualizowany przez insert, erase
+	/// i replace, czyszczony przez clear, a po operacjach zapisujacych wynik w calosci (operacje na zbiorach, split,
+	/// join, eraseRange, revertTo) poprawiany o klucze, ktore zmienila operacja. Odczyty innych wersji korzystaja z drzewa.
+	/// Skrot pochodzi z metody hash funktora porzadku albo z std::hash i musi byc rowny dla wartosci rownowaznych;
+	/// klucze transparentne wyszukiwane sa w indeksie tylko przez metode hash funktora porzadku.
+	/// </summary>
+	void enableHeadIndex()
+	{
+		static_assert(HeadIndexType::template Hashable<Type>::value, "The head index requires std::hash or a hash method of the order functor");
+		if (_headIndexEnabled)
+			return;
+		_headIndexEnabled = true;
+		_headIndex.assign(begin(_version), end(_version));
+	}
+
+	/// <summary>
+	/// Wylacza indeks haszujacy aktualnej wersji i zwalnia jego pamiec.
+	/// </summary>
+	void disableHeadIndex()
+	{
+		_headIndexEnabled = false;
+		_headIndex.clear();
+	}
+
+	/// <summary>
+	/// Zwraca posortowane przedzialy wersji, w ktorych wartosc istniala w drzewie. Wymaga wlaczenia indeksu czasu zycia.
+	/// Przedzialy kluczy istniejacych tylko w zarchiwizowanych wersjach zwraca archive().lifetime.
+	/// </summary>
+	/// <param name="value">Wartosc.</param>
+	/// <returns></returns>
+	std::vector<VersionRange> const & lifetime(Type const & value) const
+	{
+		return _lifetimes.lifetime(value);
+	}
+
+	template<class Key, class Order = OrderFunctor, class = typename Order::is_transparent>
+	std::vector<VersionRange> const & lifetime(Key const & key) const
+	{
+		return _lifetimes.lifetime(key);
+	}
+
+	/// <summary>
+	/// Sprawdza, czy wartosc istniala w ktorejkolwiek z wersji od first do last wlacznie. Wymaga wlaczenia indeksu czasu zycia.
+	/// </summary>
+	/// <param name="value">Wartosc.</param>
+	/// <param name="first">Pierwsza wersja.</param>
+	/// <param name="last">Ostatnia wersja.</param>
+	/// <returns></returns>
+	bool existedBetween(Type const & value, int first, int last) const
+	{
+		return _lifetimes.existedBetween(value, first, last) || existedInArchive(value, first, last);
+	}
+
+	template<class Key, class Order = OrderFunctor, class = typename Order::is_transparent>
+	bool existedBetween(Key const & key, int first, int last) const
+	{
+		return _lifetimes.existedBetween(key, first, last) || existedInArchive(key, first, last);
+	}
+
+	/// <summary>
+	/// Przenosi wersje starsze niz podana do skompresowanego archiwum i zwalnia wezly, ktore nalezaly tylko do nich.
+	/// Archiwum przechowuje klucze z przedzialami wersji z indeksu czasu zycia, dlatego wymaga indeksu wlaczonego
+	/// od pierwszej wersji i jest dostepne dla kluczy obslugiwanych przez ArchiveCodec (liczby calkowite i napisy).
+	/// Zarchiwizowane wersje odczytuje sie przez archive(); drzewo widzi je jako puste. Klucze, ktore istnialy
+	/// tylko w zarchiwizowanych wersjach, sa usuwane z indeksu czasu zycia, a existedBetween sprawdza takze archiwum.
+	/// </summary>
+	/// <param name="version">Pierwsza wersja, ktora pozostaje w drzewie.</param>
+	/// <returns>False, jezeli indeks czasu zycia nie obejmuje calej historii albo wersja jest juz zarchiwizowana.</returns>
+	bool archiveBefore(int version)
+	{
+		if (!_lifetimesEnabled || _lifetimesFrom != FIRST_VERSION || version > _version || version <= getArchivedVersion())
+			return false;
+		waitForSnapshots();
+		// przedzialy kluczy ograniczone do archiwizowanych wersji
+		std::vector<std::pair<Type const *, std::vector<VersionRange>>> entries;
+		_lifetimes.forEach([&entries, version](Type const * value, std::vector<VersionRange> const & ranges)
+		{
+			std::vector<VersionRange> archived;
+			for (auto it = ranges.begin(); it != ranges.end() && it->from < version; ++it)
+				archived.push_back(VersionRange(it->from, std::min(it->to, version)));
+			if (!archived.empty())
+				entries.push_back(std::make_pair(value, std::move(archived)));
+		});
+		_archive.reset(new Archive(_archive ? _archive->merge(entries, version) : Archive().merge(entries, version)));
+		// wskazniki wyszukiwane sa w drzewie, bo indeks aktualnej wersji poprawiany jest dopiero przy zwalnianiu wezli
+		_lifetimes.retain(version, [this](Type const & value, int retained)
+		{
+			NodePtr node = findNode(value, retained);
+			return node != nullptr ? node->getValue(retained) : nullptr;
+		});
+		releaseArchivedNodes(version);
+		refreshStatistics(version);
+		return true;
+	}
+
+	/// <summary>
+	/// Zwraca pierwsza wersje, ktora nie zostala przeniesiona do archiwum.
+	/// </summary>
+	/// <returns></returns>
+	int getArchivedVersion() const
+	{
+		return _archive ? _archive->getVersion() : FIRST_VERSION;
+	}
+
+	/// <summary>
+	/// Zwraca archiwum wersji starszych niz getArchivedVersion(), pozwalajace wyszukiwac i iterowac po tych wersjach.
+	/// </summary>
+	/// <returns></returns>
+	Archive const & archive() const
+	{
+		static const Archive empty;
+		return _archive ? *_archive : empty;
+	}
+
+	/// <summary>
+	/// Przebudowuje wskazana wersje drzewa w nowo przydzielonych wezlach, przydzielanych w kolejnosci przejscia
+	/// w glab (wezel przed swoimi poddrzewami), z pustymi polami zmiany. Wersja jest od tej chwili czytana z nowych
+	/// wezlow, a dla aktualnej wersji takze kolejne operacje modyfikuja nowe wezly. Pozostale wersje czytaja
+	/// stare wezly, wiec numery wersji i ich zawartosc nie zmieniaja sie. Wartosci sa wspoldzielone ze starymi
+	/// wezlami tak jak przy kopiowaniu wezlow. Kazde wywolanie przydziela pelna kopie wersji.
+	/// </summary>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns>False, jezeli wersja nie istnieje albo zostala zarchiwizowana.</returns>
+	bool compact(int version = CURRENT_VERSION)
+	{
+		if (!getCorrectVersion(version) || version > _version || version < getArchivedVersion())
+			return false;
+		int readVersion = version;
+		NodePtr root = copyVersion(getRoot(readVersion), version);
+		auto next = std::upper_bound(_root.begin(), _root.end(), version,
+			[](int version, std::pair<int, NodePtr> const & entry) { return version < entry.first; });
+		// pozniejsze wersje czytaja dotychczasowy korzen, wiec dostaja wlasny wpis, jezeli go nie maja
+		bool keepNext = version < _version && (next == _root.end() || next->first != version + 1);
+		int nextVersion = version + 1;
+		NodePtr nextRoot = keepNext ? getRoot(nextVersion) : nullptr;
+		// wpis wersji z dotychczasowym korzeniem zostaje przed nowym wpisem: wyszukiwanie korzenia wybiera ostatni
+		// wpis o danej wersji, a wezly osiagalne tylko ze starego korzenia sa nadal zwalniane razem z historia
+		next = _root.insert(next, std::pair<int, NodePtr>(version, root)) + 1;
+		if (keepNext)
+			_root.insert(next, std::pair<int, NodePtr>(version + 1, nextRoot));
+		_statistics[version] = measure(version);
+		return true;
+	}
+
+	/// <summary>
+	/// Zapisuje jako nowa wersje drzewa zawartosc wskazanej wersji, bez odwracania zmian pojedynczymi operacjami.
+	/// W drzewach kopiujacych sciezke nowa wersja uzywa korzenia wskazanej wersji, wiec czas jest staly.
+	/// W pozostalych drzewach wezly, ktorych pole zmiany wypelniono po wskazanej wersji, czytane w nowej wersji
+	/// pokazywalyby te zmiany, dlatego sa kopiowane razem z przodkami, a pozostale poddrzewa sa wspoldzielone.
+	/// Wezly te pochodza z dziennika wypelnien pol zmian, wiec koszt to O(k * glebokosc) dla k zmian od wskazanej
+	/// wersji. Jedynie wersje starsze niz otwarcie drzewa z pliku wymagaja przejrzenia calej wskazanej wersji.
+	/// </summary>
+	/// <param name="version">Wersja, do ktorej drzewo wraca.</param>
+	/// <returns>False, jezeli wersja nie istnieje albo zostala zarchiwizowana.</returns>
+	bool revertTo(int version)
+	{
+		if (!getCorrectVersion(version) || version > _version || version < getArchivedVersion())
+			return false;
+		int readVersion = version;
+		NodeList created;
+		NodePtr root = revertedRoot(getRoot(readVersion), version, created, HasImmutableNodes());
+		commitResult(root, created, recorded(version));
+		return true;
+	}
+
+	/// <summary>
+	/// Wyszukuje podana wartosc w wersji drzewa obowiazujacej w chwili podanego znacznika.
+	/// </summary>
+	/// <param name="value">Wartosc do wyszukania.</param>
+	/// <param name="timestamp">Znacznik czasu.</param>
+	/// <returns></returns>
+	iterator find(Type const & value, Timestamp timestamp) const
+	{
+		return find(value, versionAt(timestamp));
+	}
+
+	/// <summary>
+	/// Zwraca iterator na poczatek wersji drzewa obowiazujacej w chwili podanego znacznika.
+	/// </summary>
+	/// <param name="timestamp">Znacznik czasu.</param>
+	/// <returns></returns>
+	iterator begin(Timestamp timestamp) const
+	{
+		return begin(versionAt(timestamp));
+	}
+
+	iterator end(Timestamp timestamp) const
+	{
+		return end(versionAt(timestamp));
+	}
+
+	/// <summary>
+	/// Zlicza elementy wersji drzewa obowiazujacej w chwili podanego znacznika.
+	/// </summary>
+	/// <param name="timestamp">Znacznik czasu.</param>
+	/// <returns></returns>
+	int size(Timestamp timestamp) const
+	{
+		return size(versionAt(timestamp));
+	}
+
+	/// <summary>
+	/// Umieszcza nowy element w drzewie poszukiwan. Skutkuje utworzeniem nowej wersji drzewa.
+	/// </summary>
+	/// <param name="value">Wartosc do umieszczenia.</param>
+	bool insert(Type const & value)
+	{
+		if (contains(value))
+			return false;
+		int level;
+		Type const * inserted = insertValue(value, level, HasImmutableNodes())->getValue(_version);
+		recordInsert(inserted, level);
+		if (_headIndexEnabled)
+			_headIndex.assign(inserted);
+		if (_lifetimesEnabled)
+			_lifetimes.open(inserted, _version);
+		return true;
+	}
+
+	/// <summary>
+	/// Drukuje drzewo na konsoli
+	/// </summary>
+	void print(int version = CURRENT_VERSION) const
+	{
+		NodePtr root = getRoot(version);
+		// nie mozna wydrukowac pustego drzewa
+		if (root == nullptr)
+			return;
+		int i = 1;
+		NodePtr right = root->getRightChild(version);
+		NodePtr left = root->getLeftChild(version);
+		printNode(right, version, i);
+		std::cout << *root->getValue(version) << std::endl;
+		printNode(left, version, i);
+	}
+
+	/// <summary>
+	/// Usuwa zawartosc drzewa wraz z historia. Indeks czasu zycia jest wylaczany, tak jak w nowym drzewie.
+	/// </summary>
+	void purge()
+	{
+		waitForSnapshots();
+		deallocateNodes();
+		_root.clear();
+		_timestamps.clear();
+		_statistics.assign(1, VersionStatistics<Type>::empty());
+		_slotChanges.clear();
+		_slotChangesFrom = FIRST_VERSION;
+		_lifetimes.clear();
+		_lifetimesEnabled = false;
+		_lifetimesFrom = FIRST_VERSION;
+		_headIndex.clear();
+		_archive.reset();
+		_version = FIRST_VERSION;
+		_root.push_back(std::pair<int, NodePtr>(_version, nullptr));
+	}
+
+	/// <summary>
+	/// Zwraca liczbe elementow wskazanej wersji drzewa w czasie stalym. Liczba zapisywana jest przy tworzeniu wersji,
+	/// a jezeli jest nieznana, np. dla wersji ponownie otwartego drzewa albo wyniku split, eraseRange czy operacji
+	/// na zbiorach, jest zliczana przy pierwszym zapytaniu. Wersje tworzone pozniej z takiej wersji przez insert,
+	/// erase i replace znaja ja od razu.
+	/// </summary>
+	/// <param name="version">Wersja drzewa, po ktorej nalezy iterowac. Zero oznacza wersje aktualna</param>
+	/// <returns></returns>
+	int size(int version = CURRENT_VERSION) const
+	{
+		getCorrectVersion(version);
+		return statisticsOf(version, false).size;
+	}
+
+	/// <summary>
+	/// Zwraca najmniejszy element wskazanej wersji drzewa w czasie stalym (patrz size).
+	/// </summary>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns>Wskaznik na element albo nullptr dla pustej wersji.</returns>
+	Type const * minimum(int version = CURRENT_VERSION) const
+	{
+		getCorrectVersion(version);
+		return statisticsOf(version, false).min;
+	}
+
+	/// <summary>
+	/// Zwraca najwiekszy element wskazanej wersji drzewa w czasie stalym (patrz size).
+	/// </summary>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns>Wskaznik na element albo nullptr dla pustej wersji.</returns>
+	Type const * maximum(int version = CURRENT_VERSION) const
+	{
+		getCorrectVersion(version);
+		return statisticsOf(version, false).max;
+	}
+
+	/// <summary>
+	/// Zwraca wysokosc wskazanej wersji drzewa: liczbe poziomow na najdluzszej sciezce od korzenia, zero dla pustej wersji.
+	/// Wysokosc po usunieciu wezla wewnetrznego i po operacjach zapisujacych wynik w calosci nie jest znana od razu,
+	/// wiec pierwsze zapytanie o taka wersje przeglada ja w calosci, a kolejne i zapytania o wersje tworzone z niej
+	/// przez insert i erase dzialaja w czasie stalym.
+	/// </summary>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	int height(int version = CURRENT_VERSION) const
+	{
+		getCorrectVersion(version);
+		return statisticsOf(version, true).height;
+	}
+
+	/// <summary>
+	/// Zwraca wszystkie statystyki wskazanej wersji drzewa, wyznaczajac brakujace z drzewa.
+	/// </summary>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	VersionStatistics<Type> statistics(int version = CURRENT_VERSION) const
+	{
+		getCorrectVersion(version);
+		return statisticsOf(version, true);
+	}
+
+	/// <summary>
+	/// Wywoluje funkcje dla kazdego elementu wskazanej wersji drzewa, dzielac drzewo na niezalezne poddrzewa
+	/// wykonywane przez pule watkow z podkradaniem zadan. Funkcja jest wywolywana rownolegle
+	/// z roznych watkow, w nieokreslonej kolejnosci, i nie moze modyfikowac drzewa.
+	/// </summary>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <param name="function">Funkcja przyjmujaca element.</param>
+	template<class Function>
+	void parallelForEach(int version, Function function) const
+	{
+		Subtree subtree = subtreeOf(*this, version);
+		forEachIn(subtree, isLarge(subtree) ? parallelDepth() : 0, function);
+	}
+
+	/// <summary>
+	/// Redukuje elementy wskazanej wersji drzewa, dzielac drzewo na niezalezne poddrzewa tak jak parallelForEach.
+	/// Kazde poddrzewo jest redukowane od wartosci poczatkowej, a wyniki poddrzew sa laczone w kolejnosci kluczy,
+	/// wiec operacja musi byc laczna, a wartosc poczatkowa musi byc jej elementem neutralnym.
+	/// </summary>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <param name="init">Element neutralny operacji.</param>
+	/// <param name="operation">Operacja przyjmujaca wynik i element albo dwa wyniki, np. std::plus&lt;&gt;.</param>
+	/// <returns>Wynik redukcji; init dla pustej wersji.</returns>
+	template<class Result, class Operation>
+	Result parallelReduce(int version, Result init, Operation operation) const
+	{
+		Subtree subtree = subtreeOf(*this, version);
+		return reduceIn(subtree, isLarge(subtree) ? parallelDepth() : 0, init, operation);
+	}
+
+	/// <summary>
+	/// Zwraca liczbe wszystkich wezlow zaalokowanych w drzewie.
+	/// </summary>
+	/// <returns></returns>
+	int size_of_history()
+	{
+		return _allocator.getNodeCount();
+	}
+
+private:
+	/// <summary>
+	/// Wyszukuje wezel o podanej wartosci w jednym zejsciu od korzenia, porownujac klucz z wezlem raz na poziom.
+	/// </summary>
+	/// <param name="value">Wartosc do wyszukania.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns>Wezel z wartoscia albo nullptr, jezeli jej nie ma.</returns>
+	template<class Key>
+	NodePtr findNode(Key const & value, int version) const
+	{
+		KeyProbe<Key, Type, OrderFunctor> probe(value, orderFunctor);
+		NodePtr currentNode = getRoot(version);
+		while (currentNode != nullptr)
+		{
+			int order = probe.compare(currentNode, version);
+			if (order < 0)
+				currentNode = currentNode->getLeftChild(version);
+			else if (order > 0)
+				currentNode = currentNode->getRightChild(version);
+			else
+				break;
+		}
+		return currentNode;
+	}
+
+	/// <summary>
+	/// Wstawia wartosc metoda kopiowania wezlow. Zmiana trafia do pola zmiany rodzica,
+	/// a kopiowani sa tylko ci przodkowie, ktorych pole zmiany jest juz zajete.
+	/// </summary>
+	/// <param name="value">Wartosc do umieszczenia.</param>
+	/// <param name="level">Poziom nowego wezla, liczony od korzenia na poziomie pierwszym.</param>
+	/// <returns>Nowy wezel.</returns>
+	NodePtr insertValue(Type const & value, int & level, std::false_type)
+	{
+		NodePtr root = getRoot(_version);
+		if (root == nullptr)
+		{
+			confirmChange();
+			NodePtr node = allocateNode(value);
+			_root.push_back(std::pair<int, NodePtr>(_version, node));
+			level = 1;
+			return node;
+		}
+		else
+		{
+			// utworzenie nowego dziecka
+			NodePtr newChild = allocateNode(value);
+			// uwzglednienie zmian w rodzicach. Jezeli wezel rodzicielski
+			// posiada juz zajety wskaznik zmiany, zostaje on skopiowany
+			// wowczas kolejni rodzice tak samo, jezeli ich pole zmian jest zajete
+			// w najgorszym wypadku zostaje utworzony nowy korzen
+			bool stop = false;
+			NodePtr currentChild = newChild;
+			Type const * currentChildValue = &value;
+			level = 0;
+			do
+			{
+				// poziom nowego wezla wyznaczany jest przy pierwszym zejsciu do jego rodzica
+				NodePtr currentParent = level == 0 ? getParentNode(value, _version, level) : getParentNode(*currentChildValue, _version);
+				// brak rodzica -> dziecko jest nowym korzeniem
+				if (currentParent == nullptr)
+				{
+					confirmChange();
+					_root.push_back(std::pair<int, NodePtr>(_version, currentChild));
+					stop = true;
+				}
+				else
+				{
+					// jezeli w rodzicu nie ma zmiany, to ja wprowadzamy
+					if (currentParent->getChangeType() == ChangeType::None)
+					{
+						ChangeType type = orderFunctor(*currentChildValue, *currentParent->getValue(_version)) ? ChangeType::LeftChild : ChangeType::RightChild;
+						confirmChange();
+						currentParent->setChange(type, currentChild, _version);
+						logSlotChange(currentParent, _version);
+						stop = true;
+					}
+					// jezeli w rodzicu jest zmiana, to go kopiujemy
+					// a zmiane wprowadzamy w jego rodzicu
+					// powoduje wykonanie kolejnej iteracji
+					else
+					{
+						// nowy rodzic z nowa wartoscia
+						Type * parentValue = currentParent->getValue(_version);
+						NodePtr leftChild = currentParent->getLeftChild(_version);
+						NodePtr rightChild = currentParent->getRightChild(_version);
+
+						NodePtr newParent = allocateSharedNode(parentValue);
+						newParent->setLeftChild(leftChild);
+						newParent->setRightChild(rightChild);
+
+						if (orderFunctor(*currentChildValue, *parentValue))
+							newParent->setLeftChild(currentChild);
+						else
+							newParent->setRightChild(currentChild);
+
+						currentChild = newParent;
+						currentChildValue = parentValue;
+					}
+				}
+			} while (!stop);
+			return newChild;
+		}
+	}
+
+	/// <summary>
+	/// Wstawia wartosc kopiujac cala sciezke od korzenia, dzieki czemu kazdy nowy wezel ma aktualny agregat poddrzewa.
+	/// </summary>
+	/// <param name="value">Wartosc do umieszczenia.</param>
+	/// <param name="level">Poziom nowego wezla, liczony od korzenia na poziomie pierwszym.</param>
+	/// <returns>Nowy wezel.</returns>
+	NodePtr insertValue(Type const & value, int & level, std::true_type)
+	{
+		NodeStack<NodePtr> path;
+		findPath(value, path);
+		level = static_cast<int>(path.size()) + 1;
+		NodePtr newChild = makeNode(value, nullptr, nullptr);
+		commitRoot(copyPath(path, value, newChild));
+		return newChild;
+	}
+
+	/// <summary>
+	/// Usuwa wskazany wezel z aktualnej wersji drzewa.
+	/// </summary>
+	/// <param name="node">Wezel do usuniecia.</param>
+	/// <returns>False, jezeli wezel nie istnieje.</returns>
+	bool eraseNode(NodePtr node)
+	{
+		// brak wartosci w drzwie
+		if (node == nullptr)
+			return false;
+		Type const & value = *node->getValue(_version);
+		VersionStatistics<Type> statistics = statisticsAfterErase(node, value);
+		eraseNode(node, HasImmutableNodes());
+		recordErase(statistics);
+		if (_headIndexEnabled)
+			_headIndex.erase(value);
+		if (_lifetimesEnabled)
+			_lifetimes.close(value, _version);
+		return true;
+	}
+
+	/// <summary>
+	/// Usuwa wezel metoda kopiowania wezlow.
+	/// </summary>
+	/// <param name="node">Wezel do usuniecia.</param>
+	void eraseNode(NodePtr node, std::false_type)
+	{
+		//_root.push_back(_root[version]);
+		NodePtr rightChild = node->getRightChild(_version);
+		NodePtr leftChild  = node->getLeftChild(_version);
+		NodePtr parent = getParentNode(*node->getValue(_version), _version);
+		if (parent == nullptr)
+		{
+			// usuwamy korzen
+			if (rightChild == nullptr && leftChild != nullptr)
+			{
+				setNewChildForMe(parent, leftChild);
+			}
+			else if (rightChild != nullptr && leftChild == nullptr)
+			{
+				setNewChildForMe(parent, rightChild);
+			}
+			else if (rightChild != nullptr && leftChild != nullptr)
+			{
+				setLargestValueInLeftSubtreeAsChild(node);
+			}
+			else
+			{
+				_root.push_back(std::pair<int, NodePtr>(_version + 1, nullptr));
+			}
+		}
+		else
+		{
+			// usuwamy wezel na glebszym poziomie
+			if (rightChild == nullptr && leftChild == nullptr)
+			{
+				// nie mam dzieci, daj rodzicowi nullptr
+				if (parent->getLeftChild(_version) == node)
+					setLeftChildAsNull(parent);
+				else
+					setRightChildAsNull(parent);
+			}
+			// lewe dziecko istnieje
+			else if (rightChild == nullptr && leftChild != nullptr)
+			{
+				// rodzic otrzymuje zmiane na lewego potomka swego dziecka
+				setNewChildForMe(parent, leftChild);
+			}
+			// prawe dziecko istnieje
+			else if (rightChild != nullptr && leftChild == nullptr)
+			{
+				// rodzic otrzymuje zmiane na prawego potomka swego dziecka
+				setNewChildForMe(parent, rightChild);
+			}
+			// dwoje dzieci istnieje
+			else
+			{
+				setLargestValueInLeftSubtreeAsChild(node);
+			}
+		}
+		confirmChange();
+	}
+
+	/// <summary>
+	/// Usuwa wezel kopiujac sciezke od korzenia. Wezel z dwojgiem dzieci zastepowany jest
+	/// kopia swojego poprzednika, a sciezka do poprzednika rowniez jest kopiowana.
+	/// </summary>
+	/// <param name="node">Wezel do usuniecia.</param>
+	void eraseNode(NodePtr node, std::true_type)
+	{
+		Type const & value = *node->getValue(_version);
+		NodeStack<NodePtr> path;
+		findPath(value, path);
+		NodePtr leftChild = node->getLeftChild(_version);
+		NodePtr rightChild = node->getRightChild(_version);
+		NodePtr replacement;
+		if (leftChild == nullptr)
+			replacement = rightChild;
+		else if (rightChild == nullptr)
+			replacement = leftChild;
+		else
+		{
+			NodeStack<NodePtr> spine;
+			NodePtr predecessor = leftChild;
+			while (predecessor->getRightChild(_version) != nullptr)
+			{
+				spine.push(predecessor);
+				predecessor = predecessor->getRightChild(_version);
+			}
+			NodePtr newLeft = predecessor->getLeftChild(_version);
+			while (!spine.empty())
+			{
+				NodePtr spineNode = spine.top();
+				spine.pop();
+				newLeft = makeSharedNode(spineNode->getValue(_version), spineNode->getLeftChild(_version), newLeft);
+			}
+			replacement = makeSharedNode(predecessor->getValue(_version), newLeft, rightChild);
+		}
+		commitRoot(copyPath(path, value, replacement));
+	}
+
+	/// <summary>
+	/// Zastepuje wartosc wezla, zapisujac ja w polu zmiany.
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="value">Nowa wartosc.</param>
+	/// <returns>Wezel z nowa wartoscia w nowej wersji: podany wezel albo jego kopia.</returns>
+	NodePtr replaceValue(NodePtr node, Type const & value, std::false_type)
+	{
+		NodePtr changed = changeValue(node, allocateValue(value));
+		confirmChange();
+		return changed;
+	}
+
+	/// <summary>
+	/// Zastepuje wartosc wezla kopiujac sciezke od korzenia.
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="value">Nowa wartosc.</param>
+	/// <returns>Kopia wezla z nowa wartoscia.</returns>
+	NodePtr replaceValue(NodePtr node, Type const & value, std::true_type)
+	{
+		NodeStack<NodePtr> path;
+		findPath(value, path);
+		NodePtr copy = makeNode(value, node->getLeftChild(_version), node->getRightChild(_version));
+		commitRoot(copyPath(path, value, copy));
+		return copy;
+	}
+
+	/// <summary>
+	/// Umieszcza na stosie przodkow wezla o podanej wartosci w aktualnej wersji drzewa.
+	/// </summary>
+	/// <param name="value">Wartosc.</param>
+	/// <param name="path">Stos przodkow, od korzenia.</param>
+	/// <returns>Wezel z wartoscia albo nullptr, jezeli jej nie ma.</returns>
+	NodePtr findPath(Type const & value, NodeStack<NodePtr> & path)
+	{
+		KeyProbe<Type, Type, OrderFunctor> probe(value, orderFunctor);
+		NodePtr currentNode = getRoot(_version);
+		while (currentNode != nullptr)
+		{
+			int order = probe.compare(currentNode, _version);
+			if (order < 0)
+			{
+				path.push(currentNode);
+				currentNode = currentNode->getLeftChild(_version);
+			}
+			else if (order > 0)
+			{
+				path.push(currentNode);
+				currentNode = currentNode->getRightChild(_version);
+			}
+			else
+			{
+				break;
+			}
+		}
+		return currentNode;
+	}
+	
+	/// <summary>
+	/// Zwraca wskaznik na rodzica wezla o podanej wartosci zgodnie z podana wersja.
+	/// </summary>
+	/// <param name="value">Wartosc dziecka.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns>Jezeli rodzic istnieje, to wskaznik na niego, jezeli nie, to nullptr</returns>
+	NodePtr getParentNode(Type const & value, int version) const
+	{
+		int level;
+		return getParentNode(value, version, level);
+	}
+
+	/// <summary>
+	/// Zwraca wskaznik na rodzica wezla o podanej wartosci zgodnie z podana wersja.
+	/// </summary>
+	/// <param name="value">Wartosc dziecka.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <param name="level">Poziom wezla z ta wartoscia albo miejsca, w ktorym zostalby wstawiony, liczony od korzenia na poziomie pierwszym.</param>
+	/// <returns>Jezeli rodzic istnieje, to wskaznik na niego, jezeli nie, to nullptr</returns>
+	NodePtr getParentNode(Type const & value, int version, int & level) const
+	{
+		KeyProbe<Type, Type, OrderFunctor> probe(value, orderFunctor);
+		NodePtr parent = nullptr;
+		NodePtr currentNode = getRoot(version);
+		level = 1;
+		while (currentNode != nullptr)
+		{
+			int order = probe.compare(currentNode, version);
+			if (order == 0)
+				break;
+			parent = currentNode;
+			currentNode = order < 0 ? currentNode->getLeftChild(version) : currentNode->getRightChild(version);
+			++level;
+		}
+		return parent;
+	}
+
+	/// <summary>
+	/// Drukuje pojedynczy wezel drzewa wraz z jego dziecmi
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <param name="level">Poziom w drzwie.</param>
+	void printNode(NodePtr node, int version, int level) const
+	{
+		if (node == nullptr)
+			return;
+		NodePtr right = node->getRightChild(version);
+		NodePtr left = node->getLeftChild(version);
+		if (right != nullptr)
+			printNode(right, version, level + 1);
+		for (int i = 0; i < level; i++)
+		{
+			std::cout << '\t';
+		}
+		std::cout << *node->getValue(version) << std::endl;
+		if (left != nullptr)
+			printNode(left, version, level + 1);
+	}
+
+	/// <summary>
+	/// Zmienia potomka (na odpowiedniej pozycji) we wskazanym wezle i zapisuje zmiany
+	/// </summary>
+	/// <param name="value">Wartosc.</param>
+	/// <param name="newChild">Nowe dziecko.</param>
+	void setNewChildForMe(NodePtr parent, NodePtr newChild)
+	{
+		propagateChangesAfterInsert(parent, newChild);
+	}
+
+	/// <summary>
+	/// Ustawia prawe dziecko wskazanego wezla jako nullptr wraz z propagacja zmian.
+	/// </summary>
+	/// <param name="parent">Wezel rodzica.</param>
+	void setRightChildAsNull(NodePtr parent)
+	{
+		NodePtr currentChild = nullptr;
+		NodePtr currentParent = parent;
+		if (parent->getChangeType() == ChangeType::None)
+		{
+			parent->setChange(ChangeType::RightChild, nullptr, _version + 1);
+			logSlotChange(parent, _version + 1);
+			return;
+		}
+		else
+		{
+			NodePtr newParent = makeCopy(parent, _version);
+			newParent->setRightChild(nullptr);
+			currentChild = newParent;
+			currentParent = getParentNode(*currentChild->getValue(_version), _version);
+		}
+		propagateChangesAfterInsert(currentParent, currentChild);
+	}
+
+	/// <summary>
+	/// Ustawia lewe dziecko wskazanego wezla jako nullptr wraz z propagacja zmian.
+	/// </summary>
+	/// <param name="parent">Wezel rodzica.</param>
+	void setLeftChildAsNull(NodePtr parent)
+	{
+		NodePtr currentChild = nullptr;
+		NodePtr currentParent = parent;
+		if (parent->getChangeType() == ChangeType::None)
+		{
+			parent->setChange(ChangeType::LeftChild, nullptr, _version + 1);
+			logSlotChange(parent, _version + 1);
+			return;
+		}
+		else
+		{
+			NodePtr newParent = makeCopy(parent, _version);
+			newParent->setLeftChild(nullptr);
+			currentChild = newParent;
+			currentParent = getParentNode(*currentChild->getValue(_version), _version);
+		}
+		propagateChangesAfterInsert(currentParent, currentChild);
+	}
+
+	/// <summary>
+	/// Zapisuje w dzienniku wezel, ktorego pole zmiany wypelniono w podanej wersji.
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="version">Wersja zmiany.</param>
+	void logSlotChange(NodePtr node, int version)
+	{
+		_slotChanges.push_back(std::pair<int, NodePtr>(version, node));
+	}
+
+	/// <summary>
+	/// Zmienia wartosc w wezle i propaguje te zmiane
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="value">Nowa wartosc przydzielona przez allocateValue albo shareValue. Wezel przejmuje odwolanie do niej.</param>
+	/// <returns>Wezel z nowa wartoscia: podany wezel albo jego kopia.</returns>
+	NodePtr changeValue(NodePtr node, Type * value)
+	{
+		if (node->getChangeType() == ChangeType::None)
+		{
+			node->setChange(ChangeType::Value, *value, _version + 1);
+			logSlotChange(node, _version + 1);
+			return node;
+		}
+		NodePtr currentNode = makeCopy(node, value, _version + 1);
+		NodePtr currentParent = getParentNode(*node->getValue(_version), _version);
+		propagateChangesAfterInsert(currentParent, currentNode);
+		return currentNode;
+	}
+
+	/// <summary>
+	/// Tworzy kopie wezla z uwzglednieniem pola zmiany.
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	NodePtr makeCopy(NodePtr node, int version)
+	{
+		NodePtr copy = allocateSharedNode(node->getValue(version));
+		copy->setRightChild(node->getRightChild(version));
+		copy->setLeftChild(node->getLeftChild(version));
+		return copy;
+	}
+
+	/// <summary>
+	/// worzy kopie wezla z uwzglednieniem pola zmiany i nowej wartosci
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="value">Nowa wartosc, do ktorej kopia przejmuje odwolanie.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	NodePtr makeCopy(NodePtr node, Type * value, int version)
+	{
+		NodePtr copy = constructNode(value);
+		copy->setRightChild(node->getRightChild(version));
+		copy->setLeftChild(node->getLeftChild(version));
+		return copy;
+	}
+
+	/// <summary>
+	/// Potwierdzenie zmiany w historii.
+	/// </summary>
+	void confirmChange()
+	{
+		++_version;
+		// statystyki nowej wersji sa nieznane, dopoki operacja ich nie zapisze
+		_statistics.resize(_version + 1);
+	}
+
+	/// <summary>
+	/// Zapisuje do referencji poprawna wersja drzewa na podstawie przekazanego argumentu.
+	/// </summary>
+	/// <param name="version">Wersja.</param>
+	/// <returns>True, jezeli poprawna wersja istnieje, false, jezeli nie.</returns>
+	bool getCorrectVersion(int & version) const
+	{
+		int currentVersion = getCurrentVersion();
+		if (version == CURRENT_VERSION)
+			version = currentVersion;
+		return true;
+	}
+
+	/// <summary>
+	/// Sprawdza, czy klucz istnial w ktorejs z zarchiwizowanych wersji od first do last wlacznie.
+	/// </summary>
+	template<class Key>
+	bool existedInArchive(Key const & key, int first, int last) const
+	{
+		return existedInArchive(key, first, last, IsArchivable<Type>());
+	}
+
+	template<class Key>
+	bool existedInArchive(Key const & key, int first, int last, std::true_type) const
+	{
+		return _archive && first < _archive->getVersion() && _archive->existedBetween(key, first, last);
+	}
+
+	template<class Key>
+	bool existedInArchive(Key const &, int, int, std::false_type) const
+	{
+		return false;
+	}
+
+	/// <summary>
+	/// Kopiuje drzewo o podanym korzeniu, czytane w podanej wersji, do nowych wezlow przydzielanych w kolejnosci
+	/// przejscia w glab. Dzieci podpinane sa przy przydziale, a agregaty wyliczane w odwrotnej kolejnosci,
+	/// w ktorej potomkowie poprzedzaja przodkow.
+	/// </summary>
+	/// <param name="root">Korzen.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns>Korzen kopii.</returns>
+	NodePtr copyVersion(NodePtr root, int version)
+	{
+		if (root == nullptr)
+			return nullptr;
+		struct Pending
+		{
+			NodePtr source;
+			NodePtr parent;
+			bool left;
+		};
+		NodeList created;
+		std::vector<Pending> stack(1, Pending{ root, nullptr, false });
+		while (!stack.empty())
+		{
+			Pending pending = stack.back();
+			stack.pop_back();
+			NodePtr copy = allocateSharedNode(pending.source->getValue(version));
+			created.push_back(copy);
+			if (pending.parent != nullptr)
+			{
+				if (pending.left)
+					pending.parent->setLeftChild(copy);
+				else
+					pending.parent->setRightChild(copy);
+			}
+			if (NodePtr right = pending.source->getRightChild(version))
+				stack.push_back(Pending{ right, copy, false });
+			if (NodePtr left = pending.source->getLeftChild(version))
+				stack.push_back(Pending{ left, copy, true });
+		}
+		for (auto it = created.rbegin(); it != created.rend(); ++it)
+			updateSummary(*it, IsAggregated());
+		return created.front();
+	}
+
+	/// <summary>
+	/// Zwraca korzen wersji przywracanej przez revertTo. Wezly niezmienne czytane sa tak samo w kazdej wersji.
+	/// </summary>
+	NodePtr revertedRoot(NodePtr root, int, NodeList &, std::true_type)
+	{
+		return root;
+	}
+
+	/// <summary>
+	/// Zwraca korzen wersji przywracanej przez revertTo w drzewie kopiujacym wezly. Wezel z polem zmiany pozniejszym
+	/// niz przywracana wersja oraz jego przodkowie sa kopiowani z wartoscia i dziecmi z przywracanej wersji.
+	/// Pozostale wezly czytane sa w kolejnych wersjach tak samo jak w przywracanej. Zmienione wezly pochodza
+	/// z dziennika wypelnien, a kazdy z nich jest wyszukiwany w przywracanej wersji po swojej wartosci;
+	/// wezly, ktorych tam nie ma, powstaly pozniej albo juz z niej wypadly i nie wymagaja kopii.
+	/// </summary>
+	/// <param name="root">Korzen przywracanej wersji.</param>
+	/// <param name="version">Przywracana wersja.</param>
+	/// <param name="created">Lista utworzonych wezlow.</param>
+	/// <returns></returns>
+	NodePtr revertedRoot(NodePtr root, int version, NodeList & created, std::false_type)
+	{
+		if (root == nullptr)
+			return nullptr;
+		if (version < _slotChangesFrom)
+			return revertedRootOfWhole(root, version, created);
+		std::unordered_set<NodePtr> copied;
+		NodeStack<NodePtr> path;
+		auto first = std::upper_bound(_slotChanges.begin(), _slotChanges.end(), version,
+			[](int version, std::pair<int, NodePtr> const & entry) { return version < entry.first; });
+		for (auto it = first; it != _slotChanges.end(); ++it)
+		{
+			NodePtr changed = it->second;
+			if (copied.find(changed) != copied.end())
+				continue;
+			Type const & value = *changed->getValue(version);
+			path.clear();
+			NodePtr node = root;
+			int order = 1;
+			while (node != nullptr && (order = compareWith(orderFunctor, value, *node->getValue(version))) != 0)
+			{
+				path.push(node);
+				node = order < 0 ? node->getLeftChild(version) : node->getRightChild(version);
+			}
+			if (node != changed)
+				continue;
+			copied.insert(changed);
+			// przodkowie wezla juz skopiowanego sa juz w zbiorze
+			for (; !path.empty() && copied.insert(path.top()).second; path.pop()) {}
+		}
+		if (copied.empty())
+			return root;
+		// kolejnosc: wezel, prawe dziecko, lewe dziecko; czytana od konca daje kazdy wezel po kopiach jego dzieci
+		NodeStack<NodePtr> pending, order, copies;
+		pending.push(root);
+		while (!pending.empty())
+		{
+			NodePtr node = pending.top();
+			pending.pop();
+			order.push(node);
+			NodePtr left = node->getLeftChild(version);
+			NodePtr right = node->getRightChild(version);
+			if (left != nullptr && copied.find(left) != copied.end())
+				pending.push(left);
+			if (right != nullptr && copied.find(right) != copied.end())
+				pending.push(right);
+		}
+		for (; !order.empty(); order.pop())
+		{
+			NodePtr source = order.top();
+			NodePtr left = source->getLeftChild(version);
+			NodePtr right = source->getRightChild(version);
+			if (right != nullptr && copied.find(right) != copied.end())
+			{
+				right = copies.top();
+				copies.pop();
+			}
+			if (left != nullptr && copied.find(left) != copied.end())
+			{
+				left = copies.top();
+				copies.pop();
+			}
+			NodePtr copy = makeSharedNode(source->getValue(version), left, right);
+			created.push_back(copy);
+			copies.push(copy);
+		}
+		return copies.top();
+	}
+
+	/// <summary>
+	/// Zwraca korzen wersji przywracanej przez revertTo, przegladajac cala wersje, gdy dziennik wypelnien jej nie obejmuje.
+	/// Wezel z polem zmiany pozniejszym niz przywracana wersja oraz wezel, ktorego dziecko zostalo skopiowane, sa kopiowane.
+	/// Wezly przegladane sa wszerz, a kopie tworzone w odwrotnej kolejnosci, w ktorej dzieci poprzedzaja rodzicow.
+	/// </summary>
+	NodePtr revertedRootOfWhole(NodePtr root, int version, NodeList & created)
+	{
+		struct Visit
+		{
+			NodePtr source;
+			int left;
+			int right;
+			NodePtr result;
+		};
+		std::vector<Visit> visits(1, Visit{ root, -1, -1, nullptr });
+		for (std::size_t i = 0; i < visits.size(); ++i)
+		{
+			NodePtr source = visits[i].source;
+			if (NodePtr left = source->getLeftChild(version))
+			{
+				visits[i].left = static_cast<int>(visits.size());
+				visits.push_back(Visit{ left, -1, -1, nullptr });
+			}
+			if (NodePtr right = source->getRightChild(version))
+			{
+				visits[i].right = static_cast<int>(visits.size());
+				visits.push_back(Visit{ right, -1, -1, nullptr });
+			}
+		}
+		for (auto it = visits.rbegin(); it != visits.rend(); ++it)
+		{
+			NodePtr source = it->source;
+			NodePtr left = it->left < 0 ? nullptr : visits[it->left].result;
+			NodePtr right = it->right < 0 ? nullptr : visits[it->right].result;
+			bool changedLater = source->getChangeType() != ChangeType::None && source->getChangeTime() > version;
+			if (!changedLater && left == source->getLeftChild(version) && right == source->getRightChild(version))
+			{
+				it->result = source;
+			}
+			else
+			{
+				it->result = makeSharedNode(source->getValue(version), left, right);
+				created.push_back(it->result);
+			}
+		}
+		return visits.front().result;
+	}
+
+	/// <summary>
+	/// Wyszukuje klucz w indeksie haszujacym, jezeli jest prowadzony, wersja jest aktualna, a klucz ma skrot.
+	/// </summary>
+	/// <param name="key">Klucz.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <param name="found">Wskaznik na wartosc albo nullptr, jezeli jej nie ma.</param>
+	/// <returns>False, jezeli wyszukanie musi zejsc po drzewie.</returns>
+	template<class Key>
+	bool findInHead(Key const & key, int version, Type const * & found) const
+	{
+		if (!HeadIndexType::template Hashable<Key>::value || !_headIndexEnabled || (version != CURRENT_VERSION && version != _version))
+			return false;
+		found = _headIndex.find(key);
+		return true;
+	}
+
+	/// <summary>
+	/// Zwraca statystyki zapisane dla poprawnej wersji drzewa albo statystyki nieznane.
+	/// </summary>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	VersionStatistics<Type> const & recorded(int version) const
+	{
+		static const VersionStatistics<Type> unknown;
+		return version >= FIRST_VERSION && version < static_cast<int>(_statistics.size()) ? _statistics[version] : unknown;
+	}
+
+	/// <summary>
+	/// Zwraca statystyki wersji drzewa, wyznaczajac je z drzewa, jezeli nie sa znane, i zapisujac dla kolejnych zapytan.
+	/// Odczyty moga byc rownoczesne, wiec zapisane statystyki sa czytane i uzupelniane pod muteksem.
+	/// </summary>
+	/// <param name="version">Poprawna wersja drzewa.</param>
+	/// <param name="withHeight">Okresla, czy potrzebna jest wysokosc.</param>
+	/// <returns></returns>
+	VersionStatistics<Type> statisticsOf(int version, bool withHeight) const
+	{
+		{
+			std::lock_guard<std::mutex> lock(_statisticsMutex);
+			VersionStatistics<Type> const & statistics = recorded(version);
+			if (statistics.isKnown() && (!withHeight || statistics.isHeightKnown()))
+				return statistics;
+		}
+		VersionStatistics<Type> statistics = measure(version);
+		std::lock_guard<std::mutex> lock(_statisticsMutex);
+		if (version >= FIRST_VERSION && version < static_cast<int>(_statistics.size()))
+			_statistics[version] = statistics;
+		return statistics;
+	}
+
+	/// <summary>
+	/// Wyznacza statystyki wersji drzewa przechodzac ja w calosci.
+	/// </summary>
+	/// <param name="version">Poprawna wersja drzewa.</param>
+	/// <returns></returns>
+	VersionStatistics<Type> measure(int version) const
+	{
+		VersionStatistics<Type> statistics = VersionStatistics<Type>::empty();
+		int readVersion = version;
+		NodePtr root = getRoot(readVersion);
+		if (root == nullptr)
+			return statistics;
+		std::vector<std::pair<NodePtr, int>> stack(1, std::make_pair(root, 1));
+		while (!stack.empty())
+		{
+			NodePtr node = stack.back().first;
+			int level = stack.back().second;
+			stack.pop_back();
+			++statistics.size;
+			statistics.height = std::max(statistics.height, level);
+			if (NodePtr left = node->getLeftChild(version))
+				stack.push_back(std::make_pair(left, level + 1));
+			if (NodePtr right = node->getRightChild(version))
+				stack.push_back(std::make_pair(right, level + 1));
+		}
+		statistics.min = extremeOf(version, true);
+		statistics.max = extremeOf(version, false);
+		return statistics;
+	}
+
+	/// <summary>
+	/// Wyszukuje najmniejszy albo najwiekszy element wersji drzewa schodzac skrajna sciezka.
+	/// </summary>
+	/// <param name="version">Poprawna wersja drzewa.</param>
+	/// <param name="leftmost">True dla najmniejszego elementu, false dla najwiekszego.</param>
+	/// <returns>Wskaznik na element albo nullptr dla pustej wersji.</returns>
+	Type const * extremeOf(int version, bool leftmost) const
+	{
+		int readVersion = version;
+		NodePtr node = getRoot(readVersion);
+		return node != nullptr ? extremeOf(node, version, leftmost) : nullptr;
+	}
+
+	/// <summary>
+	/// Wyszukuje najmniejszy albo najwiekszy element niepustego poddrzewa.
+	/// </summary>
+	/// <param name="node">Korzen poddrzewa.</param>
+	/// <param name="version">Wersja, w ktorej czytane sa wezly.</param>
+	/// <param name="leftmost">True dla najmniejszego elementu, false dla najwiekszego.</param>
+	/// <returns></returns>
+	Type const * extremeOf(NodePtr node, int version, bool leftmost) const
+	{
+		while (NodePtr next = leftmost ? node->getLeftChild(version) : node->getRightChild(version))
+			node = next;
+		return node->getValue(version);
+	}
+
+	/// <summary>
+	/// Zwraca poziom wezla z wartoscia rownowazna podanej, liczony od korzenia na poziomie pierwszym.
+	/// </summary>
+	/// <param name="value">Wartosc istniejaca w wersji drzewa.</param>
+	/// <param name="version">Poprawna wersja drzewa.</param>
+	/// <param name="found">Wezel z ta wartoscia.</param>
+	/// <returns></returns>
+	int levelOf(Type const & value, int version, NodePtr & found) const
+	{
+		KeyProbe<Type, Type, OrderFunctor> probe(value, orderFunctor);
+		int readVersion = version;
+		int level = 1;
+		found = getRoot(readVersion);
+		for (int order; (order = probe.compare(found, version)) != 0; ++level)
+			found = order < 0 ? found->getLeftChild(version) : found->getRightChild(version);
+		return level;
+	}
+
+	/// <summary>
+	/// Zapisuje statystyki wersji utworzonej przez wstawienie wartosci. Nowy wezel jest lisciem, wiec wysokosc
+	/// rosnie co najwyzej do jego poziomu. Statystyki nieznane przed wstawieniem pozostaja nieznane.
+	/// </summary>
+	/// <param name="inserted">Wstawiona wartosc w nowym wezle.</param>
+	/// <param name="level">Poziom nowego wezla.</param>
+	void recordInsert(Type const * inserted, int level)
+	{
+		VersionStatistics<Type> const & previous = recorded(_version - 1);
+		if (!previous.isKnown())
+			return;
+		VersionStatistics<Type> statistics = previous;
+		++statistics.size;
+		if (previous.size == 0 || orderFunctor(*inserted, *previous.min))
+			statistics.min = inserted;
+		if (previous.size == 0 || orderFunctor(*previous.max, *inserted))
+			statistics.max = inserted;
+		if (statistics.isHeightKnown())
+			statistics.height = std::max(statistics.height, level);
+		_statistics[_version] = statistics;
+	}
+
+	/// <summary>
+	/// Zapisuje statystyki wersji utworzonej przez zastapienie wartosci. Ksztalt drzewa sie nie zmienia, a nowa wartosc
+	/// jest rownowazna zastapionej, wiec zastepuje skrajny element, jezeli byl nim zastapiony. Statystyki nieznane
+	/// przed zastapieniem pozostaja nieznane.
+	/// </summary>
+	/// <param name="replaced">Nowa wartosc w wezle nowej wersji.</param>
+	void recordReplace(Type const * replaced)
+	{
+		VersionStatistics<Type> statistics = recorded(_version - 1);
+		if (!statistics.isKnown())
+			return;
+		if (!orderFunctor(*statistics.min, *replaced))
+			statistics.min = replaced;
+		if (!orderFunctor(*replaced, *statistics.max))
+			statistics.max = replaced;
+		_statistics[_version] = statistics;
+	}
+
+	/// <summary>
+	/// Wyznacza statystyki wersji, ktora powstanie po usunieciu wezla z aktualnej wersji. Wysokosc pozostaje znana
+	/// tylko po usunieciu liscia lezacego wyzej niz najglebszy poziom; skrajny element, ktory jest usuwany,
+	/// ma wskaznik pusty i jest wyszukiwany w nowej wersji.
+	/// </summary>
+	/// <param name="node">Usuwany wezel.</param>
+	/// <param name="value">Wartosc usuwanego wezla.</param>
+	/// <returns></returns>
+	VersionStatistics<Type> statisticsAfterErase(NodePtr node, Type const & value) const
+	{
+		VersionStatistics<Type> statistics = recorded(_version);
+		if (!statistics.isKnown())
+			return statistics;
+		--statistics.size;
+		if (!orderFunctor(*statistics.min, value))
+			statistics.min = nullptr;
+		if (!orderFunctor(value, *statistics.max))
+			statistics.max = nullptr;
+		if (statistics.isHeightKnown())
+		{
+			NodePtr found;
+			bool leaf = node->getLeftChild(_version) == nullptr && node->getRightChild(_version) == nullptr;
+			if (!leaf || levelOf(value, _version, found) >= statistics.height)
+				statistics.height = VersionStatistics<Type>::UNKNOWN;
+		}
+		return statistics;
+	}
+
+	/// <summary>
+	/// Zapisuje statystyki wersji utworzonej przez usuniecie wezla, uzupelniajac usuniety skrajny element.
+	/// Statystyki nieznane przed usunieciem pozostaja nieznane.
+	/// </summary>
+	/// <param name="statistics">Statystyki wyznaczone przez statisticsAfterErase.</param>
+	void recordErase(VersionStatistics<Type> statistics)
+	{
+		if (statistics.isKnown() && statistics.size == 0)
+			statistics = VersionStatistics<Type>::empty();
+		else if (statistics.isKnown())
+		{
+			if (statistics.min == nullptr)
+				statistics.min = extremeOf(_version, true);
+			if (statistics.max == nullptr)
+				statistics.max = extremeOf(_version, false);
+		}
+		_statistics[_version] = statistics;
+	}
+
+	/// <summary>
+	/// Po archiwizacji zarchiwizowane wersje sa puste, a skrajne elementy pozostalych wersji wyszukiwane sa ponownie,
+	/// bo wskazniki zapisane przy tworzeniu wersji moga prowadzic do zwolnionych wezli starszych wersji.
+	/// </summary>
+	/// <param name="version">Pierwsza pozostawiona wersja.</param>
+	void refreshStatistics(int version)
+	{
+		for (int i = FIRST_VERSION; i < static_cast<int>(_statistics.size()); ++i)
+		{
+			if (i < version)
+				_statistics[i] = VersionStatistics<Type>::empty();
+			else if (_statistics[i].isKnown() && _statistics[i].size != 0)
+			{
+				_statistics[i].min = extremeOf(i, true);
+				_statistics[i].max = extremeOf(i, false);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Zwalnia wezly osiagalne tylko z wersji starszych niz podana i usuwa korzenie tych wersji.
+	/// Wezel jest zywy, jezeli mozna do niego dojsc z korzenia ktorejs z pozostawionych wersji - z wezla zywego
+	/// dziecko wersji podanej i dziecko z pola zmiany, ktore obowiazuje w pozniejszych wersjach.
+	/// </summary>
+	/// <param name="version">Pierwsza pozostawiana wersja.</param>
+	void releaseArchivedNodes(int version)
+	{
+		auto first = std::upper_bound(_root.begin(), _root.end(), version,
+			[](int version, std::pair<int, NodePtr> const & entry) { return version < entry.first; });
+		int rootVersion = version;
+		RootVec roots(1, std::pair<int, NodePtr>(version, getRoot(rootVersion)), _root.get_allocator());
+		roots.insert(roots.end(), first, _root.end());
+		std::unordered_set<NodePtr> live;
+		NodeStack<NodePtr> stack;
+		for (auto const & entry : roots)
+			if (entry.second != nullptr && live.insert(entry.second).second)
+				stack.push(entry.second);
+		while (!stack.empty())
+		{
+			NodePtr node = stack.top();
+			stack.pop();
+			NodePtr children[] = { node->getLeftChild(version), node->getRightChild(version), getChangedChild(node, HasImmutableNodes()) };
+			for (NodePtr child : children)
+				if (child != nullptr && live.insert(child).second)
+					stack.push(child);
+		}
+		// wezly osiagalne z usuwanych korzeni po wszystkich wskaznikach
+		std::unordered_set<NodePtr> archived;
+		for (auto it = _root.begin(); it != first; ++it)
+			if (it->second != nullptr && live.find(it->second) == live.end() && archived.insert(it->second).second)
+				stack.push(it->second);
+		for (NodePtr node : live)
+			stack.push(node);
+		while (!stack.empty())
+		{
+			NodePtr node = stack.top();
+			stack.pop();
+			NodePtr children[] = { node->getLeftChild(FIRST_VERSION), node->getRightChild(FIRST_VERSION), getChangedChild(node, HasImmutableNodes()) };
+			for (NodePtr child : children)
+				if (child != nullptr && live.find(child) == live.end() && archived.insert(child).second)
+					stack.push(child);
+		}
+		// indeks aktualnej wersji moze wskazywac wartosci zwalnianych wezli, ktore zastapily w niej kopie
+		if (_headIndexEnabled)
+			for (NodePtr node : archived)
+				relinkHeadIndex(node);
+		for (NodePtr node : live)
+			detachArchivedChildren(node, version, HasImmutableNodes());
+		for (NodePtr node : archived)
+			deallocateNode(node);
+		_root.swap(roots);
+		// wypelnienia nie pozniejsze niz pierwsza pozostawiona wersja nie zmieniaja jej odczytu
+		_slotChanges.erase(_slotChanges.begin(), std::upper_bound(_slotChanges.begin(), _slotChanges.end(), version,
+			[](int version, std::pair<int, NodePtr> const & entry) { return version < entry.first; }));
+		_slotChangesFrom = std::max(_slotChangesFrom, version);
+	}
+
+	/// <summary>
+	/// Usuwa z wezla wskazniki na dzieci obowiazujace tylko przed podana wersja - zastapione zmiana z wczesniejszej wersji.
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="version">Pierwsza pozostawiana wersja.</param>
+	void detachArchivedChildren(NodePtr node, int version, std::false_type)
+	{
+		if (node->getChangeTime() > version)
+			return;
+		if (node->getChangeType() == ChangeType::LeftChild)
+			node->setLeftChild(nullptr);
+		else if (node->getChangeType() == ChangeType::RightChild)
+			node->setRightChild(nullptr);
+	}
+
+	void detachArchivedChildren(NodePtr, int, std::true_type)
+	{
+	}
+
+	/// <summary>
+	/// Czeka na zakonczenie wszystkich zapisow wersji w tle.
+	/// </summary>
+	void waitForSnapshots()
+	{
+		std::unique_lock<std::mutex> lock(_snapshotMutex);
+		_snapshotDone.wait(lock, [this] { return _snapshots == 0; });
+	}
+
+	/// <summary>
+	/// Tworzy drzewo korzystajace z podanego stanu albo, dla nullptr, z wlasnego stanu w pamieci procesu.
+	/// </summary>
+	/// <param name="state">Stan drzewa w pliku odwzorowanym w pamieci.</param>
+	/// <param name="heap">Sterta pliku.</param>
+	PersistentTree(State * state, ArenaHeap * heap) : _ownState(nullptr), _mapped(state != nullptr),
+		_version(state != nullptr ? state->version : _ownState.version), _root(state != nullptr ? state->root : _ownState.root),
+		_allocator(state != nullptr ? state->allocator : _ownState.allocator), _typeAllocator(Storage::template allocator<ValueAllocator>(heap)),
+		_blockAllocator(Storage::template allocator<BlockAllocator>(heap)),
+		_slotChangesFrom(_version), _lifetimesEnabled(false), _lifetimesFrom(FIRST_VERSION), _headIndexEnabled(false), _snapshots(0)
+	{
+		// statystyki nie sa zapisywane w pliku, wiec wersje ponownie otwartego drzewa sa nieznane
+		_statistics.resize(_version + 1);
+		if (_root.empty())
+			_statistics[FIRST_VERSION] = VersionStatistics<Type>::empty();
+	}
+
+	/// <summary>
+	/// Zwraca stan drzewa zapisany w pliku, tworzac go dla nowego pliku.
+	/// </summary>
+	/// <param name="arena">Otwarty plik.</param>
+	/// <returns></returns>
+	static State * stateIn(MappedArena & arena)
+	{
+		static_assert(Storage::MAPPED, "Only trees with MappedStorage can be stored in a mapped arena");
+		State * state = static_cast<State*>(arena.root());
+		if (state == nullptr)
+		{
+			ArenaAllocator<State> allocator(arena.heap());
+			state = allocator.allocate(1);
+			new (state) State(arena.heap());
+			arena.setRoot(state);
+		}
+		return state;
+	}
+
+	/// <summary>
+	/// Zwraca korzen do drzewa o wskazanej wersji. Wpisy sa posortowane wg wersji, wiec korzen wyszukiwany jest binarnie.
+	/// </summary>
+	/// <param name="version">Wersja.</param>
+	/// <returns></returns>
+	NodePtr getRoot(int & version) const
+	{
+		if (!getCorrectVersion(version))
+			return nullptr;
+		auto it = std::upper_bound(_root.begin(), _root.end(), version,
+			[](int version, std::pair<int, NodePtr> const & entry) { return version < entry.first; });
+		if (it == _root.begin())
+			return nullptr;
+		return (it - 1)->second;
+	}
+
+	/// <summary>
+	/// Ustawia najwieksza wartosc w lewym poddrzwie usuwanego wezla jako ten wezel.
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <param name="version">Wersja.</param>
+	void setLargestValueInLeftSubtreeAsChild(NodePtr node)
+	{
+		NodePtr largestInLeftSubtree = node->getLeftChild(_version);
+		bool found = false;
+		while (!found)
+		{
+			NodePtr next = largestInLeftSubtree->getRightChild(_version);
+			if (next != nullptr)
+				largestInLeftSubtree = next;
+			else
+				found = true;
+		}
+		NodePtr largestInLeftSubtreeLeftChild = largestInLeftSubtree->getLeftChild(_version);
+		Type * value = largestInLeftSubtree->getValue(_version);
+		NodePtr largestInLeftSubtreeParent = getParentNode(*largestInLeftSubtree->getValue(_version), _version);
+
+		if (largestInLeftSubtreeLeftChild != nullptr)
+			setNewChildForMe(largestInLeftSubtreeParent, largestInLeftSubtreeLeftChild);
+		else
+		{
+			if (largestInLeftSubtreeParent == node)
+				setLeftChildAsNull(largestInLeftSubtreeParent);
+			else
+				setRightChildAsNull(largestInLeftSubtreeParent);
+		}
+		Type & val = *node->getValue(_version + 1);
+		NodePtr newNode = findNode(val, _version + 1);
+		if (newNode != nullptr)
+			changeValue(newNode, shareValue(value));
+	}
+
+	/// <summary>
+	/// Propaguje zmiany w drzewie po tym jak rodzic otrzyma nowe dziecko.
+	/// </summary>
+	/// <param name="firstParent">Rodzic w ktorym natepuje zmiana.</param>
+	/// <param name="firstChild">Nowe dziecko rodzica.</param>
+	void propagateChangesAfterInsert(NodePtr firstParent, NodePtr firstChild)
+	{
+		NodePtr currentParent = firstParent;
+		NodePtr currentChild = firstChild;
+		bool stop = false;
+		do
+		{
+			if (currentParent == nullptr)
+			{
+				_root.push_back(std::pair<int, NodePtr>(_version + 1, currentChild));
+				stop = true;
+			}
+			else
+			{
+				if (currentParent->getChangeType() == ChangeType::None)
+				{
+					Type * childValue = currentChild->getValue(_version);
+					Type * parentValue = currentParent->getValue(_version);
+					ChangeType type = orderFunctor(*childValue, *parentValue) ? ChangeType::LeftChild : ChangeType::RightChild;
+					currentParent->setChange(type, currentChild, _version + 1);
+					logSlotChange(currentParent, _version + 1);
+					stop = true;
+				}
+				else
+				{
+					NodePtr newParent = makeCopy(currentParent, _version);
+					if (orderFunctor(*currentChild->getValue(_version), *newParent->getValue(_version)))
+						newParent->setLeftChild(currentChild);
+					else
+						newParent->setRightChild(currentChild);
+					currentChild = newParent;
+					currentParent = getParentNode(*currentChild->getValue(_version), _version);
+				}
+			}
+		} while (!stop);
+	}
+
+	/// <summary>
+	/// Alokuje pamiec na nowy wezel i zwraca go.
+	/// </summary>
+	/// <param name="value">Wartosc wezla.</param>
+	/// <returns></returns>
+	NodePtr allocateNode(Type const & value)
+	{
+		return constructNode(allocateValue(value));
+	}
+
+	/// <summary>
+	/// Alokuje wezel z wartoscia innego wezla tego drzewa. Wartosc jest wspoldzielona, a nie kopiowana.
+	/// </summary>
+	/// <param name="value">Wartosc wezla tego drzewa.</param>
+	/// <returns></returns>
+	NodePtr allocateSharedNode(Type * value)
+	{
+		return constructNode(shareValue(value));
+	}
+
+	/// <summary>
+	/// Alokuje wezel przechowujacy podana wartosc. Wezel przejmuje odwolanie do wartosci.
+	/// </summary>
+	/// <param name="value">Wartosc przydzielona przez allocateValue albo shareValue.</param>
+	/// <returns></returns>
+	NodePtr constructNode(Type * value)
+	{
+		NodePtr p = _allocator.allocate(1);
+		_allocator.construct(p, *value);
+		return p;
+	}
+
+	/// <summary>
+	/// Tworzy nowa wartosc z jednym odwolaniem.
+	/// </summary>
+	/// <param name="value">Wartosc do skopiowania.</param>
+	/// <returns></returns>
+	Type * allocateValue(Type const & value)
+	{
+		return allocateValue(value, HasSharedValues());
+	}
+
+	Type * allocateValue(Type const & value, std::true_type)
+	{
+		Type * val = SharedValues::initialize(_blockAllocator.allocate(1));
+		_typeAllocator.construct(val, value);
+		return val;
+	}
+
+	Type * allocateValue(Type const & value, std::false_type)
+	{
+		Type * val = _typeAllocator.allocate(1);
+		_typeAllocator.construct(val, value);
+		return val;
+	}
+
+	/// <summary>
+	/// Dodaje odwolanie do wartosci tego drzewa. Wartosci, ktore nie sa wspoldzielone, sa kopiowane.
+	/// </summary>
+	/// <param name="value">Wartosc wezla tego drzewa.</param>
+	/// <returns>Wartosc dla nowego wezla.</returns>
+	Type * shareValue(Type * value)
+	{
+		return shareValue(value, HasSharedValues());
+	}
+
+	Type * shareValue(Type * value, std::true_type)
+	{
+		SharedValues::acquire(value);
+		return value;
+	}
+
+	Type * shareValue(Type * value, std::false_type)
+	{
+		return allocateValue(*value, std::false_type());
+	}
+
+	/// <summary>
+	/// Usuwa odwolanie do wartosci, zwalniajac ja po usunieciu ostatniego.
+	/// </summary>
+	/// <param name="value">Wartosc.</param>
+	void releaseValue(Type * value)
+	{
+		releaseValue(value, HasSharedValues());
+	}
+
+	void releaseValue(Type * value, std::true_type)
+	{
+		if (!SharedValues::release(value))
+			return;
+		_typeAllocator.destroy(value);
+		_blockAllocator.deallocate(SharedValues::blockOf(value), 1);
+	}
+
+	void releaseValue(Type * value, std::false_type)
+	{
+		_typeAllocator.destroy(value);
+		_typeAllocator.deallocate(value, 1);
+	}
+
+	/// <summary>
+	/// Tworzy nowy wezel o podanej wartosci i dzieciach, wyliczajac jego agregat.
+	/// </summary>
+	/// <param name="value">Wartosc wezla.</param>
+	/// <param name="leftChild">Lewe dziecko.</param>
+	/// <param name="rightChild">Prawe dziecko.</param>
+	/// <returns></returns>
+	NodePtr makeNode(Type const & value, NodePtr leftChild, NodePtr rightChild)
+	{
+		return linkNode(allocateNode(value), leftChild, rightChild);
+	}
+
+	/// <summary>
+	/// Tworzy nowy wezel wspoldzielacy wartosc innego wezla tego drzewa, wyliczajac jego agregat.
+	/// </summary>
+	/// <param name="value">Wartosc wezla tego drzewa.</param>
+	/// <param name="leftChild">Lewe dziecko.</param>
+	/// <param name="rightChild">Prawe dziecko.</param>
+	/// <returns></returns>
+	NodePtr makeSharedNode(Type * value, NodePtr leftChild, NodePtr rightChild)
+	{
+		return linkNode(allocateSharedNode(value), leftChild, rightChild);
+	}
+
+	NodePtr linkNode(NodePtr node, NodePtr leftChild, NodePtr rightChild)
+	{
+		node->setLeftChild(leftChild);
+		node->setRightChild(rightChild);
+		updateSummary(node, IsAggregated());
+		return node;
+	}
+
+	/// <summary>
+	/// Kopiuje przodkow ze stosu sciezki, od najglebszego do korzenia, podpinajac pod nich nowe dziecko.
+	/// Strone, po ktorej lezy dziecko, wyznacza porownanie z podana wartoscia.
+	/// </summary>
+	/// <param name="path">Stos przodkow, od korzenia.</param>
+	/// <param name="value">Wartosc, do ktorej prowadzi sciezka.</param>
+	/// <param name="child">Nowe dziecko najglebszego przodka.</param>
+	/// <returns>Nowy korzen.</returns>
+	NodePtr copyPath(NodeStack<NodePtr> & path, Type const & value, NodePtr child)
+	{
+		KeyProbe<Type, Type, OrderFunctor> probe(value, orderFunctor);
+		while (!path.empty())
+		{
+			NodePtr parent = path.top();
+			path.pop();
+			Type * parentValue = parent->getValue(_version);
+			if (probe.less(parent, _version))
+				child = makeSharedNode(parentValue, child, parent->getRightChild(_version));
+			else
+				child = makeSharedNode(parentValue, parent->getLeftChild(_version), child);
+		}
+		return child;
+	}
+
+	/// <summary>
+	/// Zapisuje nowy korzen jako nowa wersje drzewa.
+	/// </summary>
+	/// <param name="root">Korzen.</param>
+	void commitRoot(NodePtr root)
+	{
+		confirmChange();
+		_root.push_back(std::pair<int, NodePtr>(_version, root));
+	}
+
+	/// <summary>
+	/// Wykonuje operacje na zbiorach i zapisuje jej wynik jako nowa wersje drzewa.
+	/// Wezly utworzone w trakcie operacji, ktore nie trafily do wyniku, sa zwalniane.
+	/// </summary>
+	/// <param name="version">Wersja tego drzewa.</param>
+	/// <param name="other">Drugie drzewo.</param>
+	/// <param name="otherVersion">Wersja drugiego drzewa.</param>
+	/// <param name="operation">Operacja.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int applySetOperation(int version, PersistentTree const & other, int otherVersion, SetOperation operation)
+	{
+		Subtree first = subtreeOf(*this, version);
+		Subtree second = subtreeOf(other, otherVersion);
+		int depth = isLarge(first) || isLarge(second) ? parallelDepth() : 0;
+		NodeList created;
+		NodePtr root = combine(operation, first, second, depth, created);
+		return commitResult(root, created);
+	}
+
+	/// <summary>
+	/// Zapisuje wynik operacji kopiujacej sciezki jako nowa wersje drzewa i zwalnia wezly, ktore nie trafily do wyniku.
+	/// Jezeli operacja zna liczbe elementow wyniku, jego skrajne elementy wyszukiwane sa skrajnymi sciezkami.
+	/// W przeciwnym razie statystyki wersji pozostaja nieznane i wyznacza je pierwsze zapytanie (patrz statisticsOf),
+	/// bo zliczenie wyniku przy zapisie kosztowaloby przejscie calej wersji.
+	/// </summary>
+	/// <param name="root">Korzen wyniku.</param>
+	/// <param name="created">Lista wezlow utworzonych przez operacje.</param>
+	/// <param name="statistics">Liczba elementow i wysokosc wyniku, o ile operacja je zna.</param>
+	/// <returns>Numer nowej wersji.</returns>
+	int commitResult(NodePtr root, NodeList const & created, VersionStatistics<Type> statistics = VersionStatistics<Type>())
+	{
+		releaseUnused(root, created);
+		int previous = _version;
+		commitRoot(root);
+		if (statistics.isKnown() && statistics.size == 0)
+			statistics = VersionStatistics<Type>::empty();
+		else if (statistics.isKnown())
+		{
+			statistics.min = extremeOf(_version, true);
+			statistics.max = extremeOf(_version, false);
+		}
+		_statistics[_version] = statistics;
+		if (_headIndexEnabled || _lifetimesEnabled)
+			trackChanges(previous);
+		return _version;
+	}
+
+	/// <summary>
+	/// Dzieli aktualna wersje na dwie nowe wersje. Obie czesci wyznaczane sa przed zapisaniem pierwszej z nich,
+	/// bo dopiero wtedy aktualna wersja jest wspoldzielona.
+	/// </summary>
+	template<class Key>
+	std::pair<int, int> splitAt(Key const & key)
+	{
+		Subtree current = subtreeOf(*this, _version);
+		NodeList createdLeft, createdRight;
+		NodePtr left = lessThan(current, key, createdLeft);
+		NodePtr right = notLessThan(current, key, createdRight);
+		std::pair<int, int> versions;
+		versions.first = commitResult(left, createdLeft);
+		versions.second = commitResult(right, createdRight);
+		return versions;
+	}
+
+	template<class Key>
+	int eraseBetween(Key const & from, Key const & to)
+	{
+		NodeList created;
+		NodePtr root = cut(subtreeOf(*this, _version), from, to, created);
+		return commitResult(root, created);
+	}
+
+	/// <summary>
+	/// Zwraca elementy poddrzewa mniejsze od klucza, kopiujac jedynie sciezke do klucza.
+	/// </summary>
+	template<class Key>
+	NodePtr lessThan(Subtree subtree, Key const & key, NodeList & created)
+	{
+		PathSteps path;
+		while (subtree.node != nullptr)
+		{
+			bool right = orderFunctor(*subtree.node->getValue(subtree.version), key);
+			if (right)
+				path.push(PathStep{ subtree, true });
+			subtree = right ? rightOf(subtree) : leftOf(subtree);
+		}
+		return rebuildPath(path, nullptr, created);
+	}
+
+	/// <summary>
+	/// Zwraca elementy poddrzewa nie mniejsze od klucza, kopiujac jedynie sciezke do klucza.
+	/// </summary>
+	template<class Key>
+	NodePtr notLessThan(Subtree subtree, Key const & key, NodeList & created)
+	{
+		PathSteps path;
+		while (subtree.node != nullptr)
+		{
+			bool right = orderFunctor(*subtree.node->getValue(subtree.version), key);
+			if (!right)
+				path.push(PathStep{ subtree, false });
+			subtree = right ? rightOf(subtree) : leftOf(subtree);
+		}
+		return rebuildPath(path, nullptr, created);
+	}
+
+	/// <summary>
+	/// Usuwa z poddrzewa elementy z przedzialu [from, to). Schodzi do najwyzszego wezla przedzialu, a pod nim
+	/// laczy elementy lewego poddrzewa mniejsze od from z elementami prawego poddrzewa nie mniejszymi od to.
+	/// </summary>
+	template<class Key>
+	NodePtr cut(Subtree subtree, Key const & from, Key const & to, NodeList & created)
+	{
+		PathSteps path;
+		NodePtr bottom = nullptr;
+		while (subtree.node != nullptr)
+		{
+			Type const & value = *subtree.node->getValue(subtree.version);
+			if (orderFunctor(value, from))
+			{
+				path.push(PathStep{ subtree, true });
+				subtree = rightOf(subtree);
+			}
+			else if (!orderFunctor(value, to))
+			{
+				path.push(PathStep{ subtree, false });
+				subtree = leftOf(subtree);
+			}
+			else
+			{
+				bottom = concatenate(lessThan(leftOf(subtree), from, created), notLessThan(rightOf(subtree), to, created), created);
+				break;
+			}
+		}
+		return rebuildPath(path, bottom, created);
+	}
+
+	/// <summary>
+	/// Kopiuje sciezke od najglebszego kroku do korzenia. Dziecko kazdego kroku zastepowane jest wynikiem
+	/// nizszego kroku, a drugie dziecko podpinane bez zmian albo kopiowane, jezeli nie jest wspoldzielone.
+	/// </summary>
+	/// <param name="path">Kroki sciezki od korzenia, oprozniane w trakcie kopiowania.</param>
+	/// <param name="child">Wynik pod najglebszym krokiem.</param>
+	/// <param name="created">Lista utworzonych wezlow.</param>
+	/// <returns>Korzen wyniku.</returns>
+	NodePtr rebuildPath(PathSteps & path, NodePtr child, NodeList & created)
+	{
+		for (; !path.empty(); path.pop())
+		{
+			PathStep step = path.top();
+			if (step.right)
+				child = join(step.subtree, materialize(leftOf(step.subtree), created), child, created);
+			else
+				child = join(step.subtree, child, materialize(rightOf(step.subtree), created), created);
+		}
+		return child;
+	}
+
+	/// <summary>
+	/// Zwraca cale drzewo wskazanej wersji jako wejscie operacji na zbiorach.
+	/// Wspoldzielona moze byc dowolna wersja drzewa kopiujacego sciezke, ktorego wezly nigdy nie sa zmieniane,
+	/// a w drzewie kopiujacym wezly wersja nie starsza niz ostatnie wypelnienie pola zmiany, np. aktualna
+	/// albo utworzona przez operacje na zbiorach lub split po ostatniej zmianie pojedynczego elementu.
+	/// </summary>
+	/// <param name="tree">Drzewo.</param>
+	/// <param name="version">Wersja drzewa.</param>
+	/// <returns></returns>
+	Subtree subtreeOf(PersistentTree const & tree, int version) const
+	{
+		NodePtr root = tree.getRoot(version);
+		bool shared = &tree == this && (HasImmutableNodes::value || version == _version || version >= lastSlotChange());
+		Subtree subtree = { root, version, shared, &tree == this };
+		return subtree;
+	}
+
+	/// <summary>
+	/// Zwraca wersje ostatniego wypelnienia pola zmiany. Wezly wersji nie starszych sa czytane tak samo w kazdej nowszej wersji.
+	/// </summary>
+	/// <returns></returns>
+	int lastSlotChange() const
+	{
+		return _slotChanges.empty() ? _slotChangesFrom : std::max(_slotChangesFrom, _slotChanges.back().first);
+	}
+
+	/// <summary>
+	/// Sprawdza, czy wszystkie elementy wersji tego drzewa sa mniejsze od elementow wersji drugiego drzewa.
+	/// </summary>
+	bool precedes(int version, PersistentTree const & other, int otherVersion) const
+	{
+		if (!getCorrectVersion(version) || !other.getCorrectVersion(otherVersion))
+			return true;
+		Type const * last = extremeOf(version, false);
+		Type const * first = other.extremeOf(otherVersion, true);
+		return last == nullptr || first == nullptr || orderFunctor(*last, *first);
+	}
+
+	/// <summary>
+	/// Zwraca poddrzewo utworzone przez operacje na zbiorach. Jest ono czytane w nowej wersji drzewa.
+	/// </summary>
+	/// <param name="node">Korzen poddrzewa.</param>
+	/// <returns></returns>
+	Subtree resultOf(NodePtr node) const
+	{
+		Subtree subtree = { node, _version + 1, true, true };
+		return subtree;
+	}
+
+	Subtree leftOf(Subtree const & subtree) const
+	{
+		Subtree left = { subtree.node->getLeftChild(subtree.version), subtree.version, subtree.shared, subtree.local };
+		return left;
+	}
+
+	Subtree rightOf(Subtree const & subtree) const
+	{
+		Subtree right = { subtree.node->getRightChild(subtree.version), subtree.version, subtree.shared, subtree.local };
+		return right;
+	}
+
+	/// <summary>
+	/// Sprawdza, czy oba poddrzewa sa tym samym wezlem czytanym tak samo.
+	/// </summary>
+	/// <param name="first">Pierwsze poddrzewo.</param>
+	/// <param name="second">Drugie poddrzewo.</param>
+	/// <returns></returns>
+	bool sameSubtree(Subtree const & first, Subtree const & second) const
+	{
+		return first.node == second.node
+			&& (HasImmutableNodes::value || first.version == second.version || (first.shared && second.shared));
+	}
+
+	/// <summary>
+	/// Sprawdza, czy poddrzewo ma co najmniej PARALLEL_THRESHOLD wezlow, odwiedzajac najwyzej tyle wezlow.
+	/// </summary>
+	/// <param name="subtree">Poddrzewo.</param>
+	/// <returns></returns>
+	bool isLarge(Subtree const & subtree) const
+	{
+		NodeStack<NodePtr> stack;
+		if (subtree.node != nullptr)
+			stack.push(subtree.node);
+		int count = 0;
+		while (!stack.empty() && count < PARALLEL_THRESHOLD)
+		{
+			NodePtr node = stack.top();
+			stack.pop();
+			++count;
+			if (NodePtr left = node->getLeftChild(subtree.version))
+				stack.push(left);
+			if (NodePtr right = node->getRightChild(subtree.version))
+				stack.push(right);
+		}
+		return count >= PARALLEL_THRESHOLD;
+	}
+
+	/// <summary>
+	/// Zwraca liczbe poziomow rekursji, na ktorych podproblemy sa rozdzielane miedzy watki.
+	/// Zadan jest kilka razy wiecej niz watkow, zeby wyrownac rozne rozmiary poddrzew.
+	/// </summary>
+	/// <returns></returns>
+	int parallelDepth() const
+	{
+		int depth = 0;
+		for (std::size_t tasks = 1; tasks < TaskPool::shared().size() * 4; tasks <<= 1)
+			++depth;
+		return depth;
+	}
+
+	/// <summary>
+	/// Wykonuje dwa niezalezne podproblemy, rownolegle dopoki nie wyczerpano glebokosci rownoleglosci.
+	/// Kazde zadanie zapisuje utworzone wezly na wlasnej liscie.
+	/// </summary>
+	/// <param name="depth">Pozostala glebokosc rownoleglosci.</param>
+	/// <param name="created">Lista utworzonych wezlow.</param>
+	/// <param name="first">Pierwszy podproblem.</param>
+	/// <param name="second">Drugi podproblem.</param>
+	template<class First, class Second>
+	void forkJoin(int depth, NodeList & created, First first, Second second)
+	{
+		if (depth <= 0)
+		{
+			first(created);
+			second(created);
+			return;
+		}
+		NodeList stolen;
+		TaskPool::shared().invoke([&] { first(stolen); }, [&] { second(created); });
+		created.insert(created.end(), stolen.begin(), stolen.end());
+	}
+
+	/// <summary>
+	/// Wywoluje funkcje dla elementow poddrzewa. Dopoki nie wyczerpano glebokosci rownoleglosci, poddrzewa
+	/// wezlow z dwojgiem dzieci sa wykonywane rownolegle. Wezly z jednym dzieckiem nie zuzywaja glebokosci,
+	/// wiec dlugie, niezrownowazone sciezki nie wyczerpuja jej bez podzialu pracy.
+	/// </summary>
+	/// <param name="subtree">Poddrzewo.</param>
+	/// <param name="depth">Pozostala glebokosc rownoleglosci.</param>
+	/// <param name="function">Funkcja przyjmujaca element.</param>
+	template<class Function>
+	void forEachIn(Subtree subtree, int depth, Function & function) const
+	{
+		while (depth > 0 && subtree.node != nullptr)
+		{
+			Subtree left = leftOf(subtree);
+			Subtree right = rightOf(subtree);
+			Type const & value = *subtree.node->getValue(subtree.version);
+			if (left.node != nullptr && right.node != nullptr)
+			{
+				TaskPool::shared().invoke([&] { forEachIn(left, depth - 1, function); },
+					[&] { function(value); forEachIn(right, depth - 1, function); });
+				return;
+			}
+			function(value);
+			subtree = left.node != nullptr ? left : right;
+		}
+		for (const_iterator it(subtree.node, subtree.version), last; it != last; ++it)
+			function(*it);
+	}
+
+	/// <summary>
+	/// Redukuje elementy poddrzewa w kolejnosci kluczy, dzielac prace tak jak forEachIn.
+	/// Wezly z samym lewym dzieckiem odkladane sa na stos, bo ich elementy lacza sie dopiero za lewym poddrzewem.
+	/// </summary>
+	/// <param name="subtree">Poddrzewo.</param>
+	/// <param name="depth">Pozostala glebokosc rownoleglosci.</param>
+	/// <param name="init">Element neutralny operacji.</param>
+	/// <param name="operation">Operacja.</param>
+	/// <returns></returns>
+	template<class Result, class Operation>
+	Result reduceIn(Subtree subtree, int depth, Result const & init, Operation & operation) const
+	{
+		Result result = init;
+		NodeStack<NodePtr> after;
+		bool split = false;
+		while (depth > 0 && subtree.node != nullptr && !split)
+		{
+			Subtree left = leftOf(subtree);
+			Subtree right = rightOf(subtree);
+			Type const & value = *subtree.node->getValue(subtree.version);
+			if (left.node != nullptr && right.node != nullptr)
+			{
+				Result leftResult = init;
+				Result rightResult = init;
+				TaskPool::shared().invoke([&] { leftResult = reduceIn(left, depth - 1, init, operation); },
+					[&] { rightResult = operation(operation(init, value), reduceIn(right, depth - 1, init, operation)); });
+				result = operation(result, operation(leftResult, rightResult));
+				split = true;
+			}
+			else if (left.node != nullptr)
+			{
+				after.push(subtree.node);
+				subtree = left;
+			}
+			else
+			{
+				result = operation(result, value);
+				subtree = right;
+			}
+		}
+		if (!split)
+		{
+			for (const_iterator it(subtree.node, subtree.version), last; it != last; ++it)
+				result = operation(result, *it);
+		}
+		for (; !after.empty(); after.pop())
+			result = operation(result, *after.top()->getValue(subtree.version));
+		return result;
+	}
+
+	/// <summary>
+	/// Wykonuje operacje na zbiorach. Korzen pierwszego poddrzewa dzieli drugie, a wyniki dla lewych i prawych
+	/// czesci sa laczone. Dopoki nie wyczerpano glebokosci rownoleglosci, czesci sa wykonywane rownolegle,
+	/// a glebiej petla z jawnym stosem, wiec glebokosc wywolan nie zalezy od wysokosci drzewa.
+	/// </summary>
+	NodePtr combine(SetOperation operation, Subtree first, Subtree second, int depth, NodeList & created)
+	{
+		if (depth <= 0)
+			return combineSequentially(operation, first, second, created);
+		NodePtr result;
+		if (trivialResult(operation, first, second, result, created))
+			return result;
+		bool found;
+		std::pair<NodePtr, NodePtr> parts = split(second, *first.node->getValue(first.version), found, created);
+		NodePtr left, right;
+		forkJoin(depth, created,
+			[&](NodeList & list) { left = combine(operation, leftOf(first), resultOf(parts.first), depth - 1, list); },
+			[&](NodeList & list) { right = combine(operation, rightOf(first), resultOf(parts.second), depth - 1, list); });
+		return combineParts(operation, first, found, left, right, created);
+	}
+
+	/// <summary>
+	/// Wykonuje operacje na zbiorach w jednym watku, odkladajac podproblemy czekajace na wyniki czesci na stos.
+	/// </summary>
+	NodePtr combineSequentially(SetOperation operation, Subtree first, Subtree second, NodeList & created)
+	{
+		NodeStack<SetStep> pending;
+		NodePtr result;
+		for (;;)
+		{
+			if (!trivialResult(operation, first, second, result, created))
+			{
+				SetStep step = { first, std::pair<NodePtr, NodePtr>(), false, false, nullptr };
+				step.parts = split(second, *first.node->getValue(first.version), step.found, created);
+				pending.push(step);
+				first = leftOf(step.first);
+				second = resultOf(step.parts.first);
+				continue;
+			}
+			// wynik zamyka kolejne podproblemy, dopoki ktorys nie czeka jeszcze na prawa czesc
+			for (;;)
+			{
+				if (pending.empty())
+					return result;
+				SetStep step = pending.top();
+				pending.pop();
+				if (!step.leftDone)
+				{
+					step.leftDone = true;
+					step.left = result;
+					pending.push(step);
+					first = rightOf(step.first);
+					second = resultOf(step.parts.second);
+					break;
+				}
+				result = combineParts(operation, step.first, step.found, step.left, result, created);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Nanosi uporzadkowane zmiany kluczy na aktualna wersje jednym przejsciem w kolejnosci, odkladajac wezly
+	/// czekajace na wyniki poddrzew na stos. Poddrzewo bez zmian jest wspoldzielone, a zmiany trafiajace w puste
+	/// miejsce wstawiane sa jako zrownowazone poddrzewo.
+	/// </summary>
+	/// <param name="changes">Zmiany w porzadku kluczy.</param>
+	/// <param name="delta">Zmiana liczby elementow, powiekszana o wstawione i pomniejszana o usuniete elementy.</param>
+	/// <param name="created">Lista utworzonych wezlow.</param>
+	/// <returns>Korzen nowej wersji.</returns>
+	NodePtr applyUpdates(std::vector<Update> const & changes, int & delta, NodeList & created)
+	{
+		NodeStack<UpdateStep> pending;
+		std::vector<Type const *> inserted;
+		Subtree subtree = subtreeOf(*this, _version);
+		std::size_t first = 0, last = changes.size();
+		NodePtr result;
+		for (;;)
+		{
+			if (first != last && subtree.node != nullptr)
+			{
+				Type const & value = *subtree.node->getValue(subtree.version);
+				UpdateStep step = { subtree, first, first, last, false, false, nullptr };
+				step.middle = std::lower_bound(changes.begin() + first, changes.begin() + last, value,
+					[this](Update const & change, Type const & value) { return orderFunctor(*change.second, value); }) - changes.begin();
+				step.found = step.middle != last && !orderFunctor(value, *changes[step.middle].second);
+				pending.push(step);
+				subtree = leftOf(subtree);
+				last = step.middle;
+				continue;
+			}
+			if (subtree.node != nullptr)
+				result = subtree.node;
+			else
+			{
+				inserted.clear();
+				for (; first != last; ++first)
+					if (changes[first].first != UpdateKind::Erase)
+						inserted.push_back(changes[first].second);
+				delta += static_cast<int>(inserted.size());
+				result = balancedSubtree(inserted, 0, inserted.size(), created);
+			}
+			// wynik zamyka kolejne wezly, dopoki ktorys nie czeka jeszcze na prawe poddrzewo
+			for (;;)
+			{
+				if (pending.empty())
+					return result;
+				UpdateStep step = pending.top();
+				pending.pop();
+				if (!step.leftDone)
+				{
+					step.leftDone = true;
+					step.left = result;
+					pending.push(step);
+					subtree = rightOf(step.subtree);
+					first = step.found ? step.middle + 1 : step.middle;
+					last = step.last;
+					break;
+				}
+				UpdateKind kind = step.found ? changes[step.middle].first : UpdateKind::Insert;
+				if (kind == UpdateKind::Insert)
+					result = join(step.subtree, step.left, result, created);
+				else if (kind == UpdateKind::Assign)
+				{
+					result = makeNode(*changes[step.middle].second, step.left, result);
+					created.push_back(result);
+				}
+				else
+				{
+					--delta;
+					result = joinChildren(step.left, result, created);
+				}
+			}
+		}
+	}
+
+	/// <summary>
+	/// Tworzy zrownowazone poddrzewo z uporzadkowanych wartosci, ktorych jest najwyzej tyle, ile zmian w jednej
+	/// wersji, wiec glebokosc rekurencji jest logarytmiczna.
+	/// </summary>
+	/// <param name="values">Wartosci w porzadku drzewa.</param>
+	/// <param name="first">Poczatek przedzialu wartosci.</param>
+	/// <param name="last">Koniec przedzialu wartosci.</param>
+	/// <param name="created">Lista utworzonych wezlow.</param>
+	/// <returns></returns>
+	NodePtr balancedSubtree(std::vector<Type const *> const & values, std::size_t first, std::size_t last, NodeList & created)
+	{
+		if (first == last)
+			return nullptr;
+		std::size_t middle = first + (last - first) / 2;
+		NodePtr left = balancedSubtree(values, first, middle, created);
+		NodePtr right = balancedSubtree(values, middle + 1, last, created);
+		NodePtr node = makeNode(*values[middle], left, right);
+		created.push_back(node);
+		return node;
+	}
+
+	/// <summary>
+	/// Laczy dzieci usuwanego wezla tak jak erase: najwiekszy element lewego poddrzewa zajmuje miejsce wezla,
+	/// a skopiowana zostaje jedynie prawa sciezka lewego poddrzewa.
+	/// </summary>
+	/// <param name="left">Lewe dziecko nowej wersji.</param>
+	/// <param name="right">Prawe dziecko nowej wersji.</param>
+	/// <param name="created">Lista utworzonych wezlow.</param>
+	/// <returns></returns>
+	NodePtr joinChildren(NodePtr left, NodePtr right, NodeList & created)
+	{
+		if (left == nullptr)
+			return right;
+		if (right == nullptr)
+			return left;
+		PathSteps path;
+		NodePtr largest = left;
+		for (NodePtr next; (next = largest->getRightChild(_version + 1)) != nullptr; largest = next)
+			path.push(PathStep{ resultOf(largest), true });
+		left = rebuildPath(path, largest->getLeftChild(_version + 1), created);
+		NodePtr node = makeSharedNode(largest->getValue(_version + 1), left, right);
+		created.push_back(node);
+		return node;
+	}
+
+	/// <summary>
+	/// Wyznacza wynik operacji bez dzielenia, jezeli jedno z poddrzew jest puste albo oba sa tym samym poddrzewem.
+	/// </summary>
+	/// <returns>False, jezeli wynik wymaga podzialu drugiego poddrzewa.</returns>
+	bool trivialResult(SetOperation operation, Subtree const & first, Subtree const & second, NodePtr & result, NodeList & created)
+	{
+		bool same = first.node != nullptr && second.node != nullptr && sameSubtree(first, second);
+		if (first.node != nullptr && second.node != nullptr && !same)
+			return false;
+		if (operation == SetOperation::Union)
+			result = materialize(first.node == nullptr ? second : first, created);
+		else if (operation == SetOperation::Intersection)
+			result = same ? materialize(first, created) : nullptr;
+		else
+			result = second.node == nullptr ? materialize(first, created) : nullptr;
+		return true;
+	}
+
+	/// <summary>
+	/// Laczy wyniki dla lewej i prawej czesci, zostawiajac korzen pierwszego poddrzewa, jezeli nalezy do wyniku.
+	/// </summary>
+	/// <param name="found">Okresla, czy korzen pierwszego poddrzewa wystepuje w drugim.</param>
+	NodePtr combineParts(SetOperation operation, Subtree const & first, bool found, NodePtr left, NodePtr right, NodeList & created)
+	{
+		bool kept = operation == SetOperation::Union || (operation == SetOperation::Intersection) == found;
+		return kept ? join(first, left, right, created) : concatenate(left, right, created);
+	}
+
+	/// <summary>
+	/// Dzieli poddrzewo na elementy mniejsze i wieksze od podanej wartosci, kopiujac jedynie sciezke podzialu.
 	/// </summary>
-	/// <param name="value">Wartosc dziecka.</param>
-	/// <param name="version">Wersja drzewa.</param>
-	/// <returns>Jezeli rodzic istnieje, to wskaznik na niego, jezeli nie, to nullptr</returns>
-	NodePtr getParentNode(Type & value, int version) const
+	/// <param name="subtree">Poddrzewo.</param>
+	/// <param name="value">Wartosc podzialu.</param>
+	/// <param name="found">Zapisuje, czy wartosc wystepuje w poddrzewie.</param>
+	/// <param name="created">Lista utworzonych wezlow.</param>
+	/// <returns>Korzenie czesci mniejszej i wiekszej.</returns>
+	std::pair<NodePtr, NodePtr> split(Subtree subtree, Type const & value, bool & found, NodeList & created)
 	{
-		NodePtr currentNode = getRoot(version);
-		if (currentNode == nullptr || *currentNode->getValue(version) == value)
-			return nullptr;
-		bool found = false;
-		while (!found)
+		// wezly mniejsze od wartosci trafiaja do czesci mniejszej bez prawego dziecka, a wieksze do wiekszej bez lewego
+		PathSteps smaller, greater;
+		std::pair<NodePtr, NodePtr> parts(nullptr, nullptr);
+		found = false;
+		while (subtree.node != nullptr)
 		{
-			NodePtr left, right;
-			left = currentNode->getLeftChild(version);
-			right = currentNode->getRightChild(version);
-			if (orderFunctor(value, *currentNode->getValue(version)))
+			int order = compareWith(orderFunctor, value, *subtree.node->getValue(subtree.version));
+			if (order == 0)
 			{
-				if (left == nullptr || *left->getValue(version) == value)
-					found = true;
-				else
-					currentNode = left;
+				found = true;
+				parts = std::pair<NodePtr, NodePtr>(materialize(leftOf(subtree), created), materialize(rightOf(subtree), created));
+				break;
 			}
+			if (order < 0)
+				greater.push(PathStep{ subtree, false });
 			else
-			{
-				if (right == nullptr || *right->getValue(version) == value)
-					found = true;
-				else
-					currentNode = right;
-			}
+				smaller.push(PathStep{ subtree, true });
+			subtree = order < 0 ? leftOf(subtree) : rightOf(subtree);
 		}
-		return currentNode;
+		parts.first = rebuildPath(smaller, parts.first, created);
+		parts.second = rebuildPath(greater, parts.second, created);
+		return parts;
 	}
-
 	/// <summary>
-	/// Drukuje pojedynczy wezel drzewa wraz z jego dziecmi
+	/// Laczy wezel poddrzewa z nowymi dziecmi. Wezel wspoldzielony, ktorego dzieci sie nie zmienily, jest uzywany ponownie.
 	/// </summary>
-	/// <param name="node">Wezel.</param>
-	/// <param name="version">Wersja drzewa.</param>
-	/// <param name="level">Poziom w drzwie.</param>
-	void printNode(NodePtr node, int version, int level) const
+	/// <param name="subtree">Poddrzewo, ktorego korzen jest laczony.</param>
+	/// <param name="left">Nowe lewe dziecko.</param>
+	/// <param name="right">Nowe prawe dziecko.</param>
+	/// <param name="created">Lista utworzonych wezlow.</param>
+	/// <returns></returns>
+	NodePtr join(Subtree const & subtree, NodePtr left, NodePtr right, NodeList & created)
 	{
-		if (node == nullptr)
-			return;
-		NodePtr right = node->getRightChild(version);
-		NodePtr left = node->getLeftChild(version);
-		if (right != nullptr)
-			printNode(right, version, level + 1);
-		for (int i = 0; i < level; i++)
-		{
-			std::cout << '\t';
-		}
-		std::cout << *node->getValue(version) << std::endl;
-		if (left != nullptr)
-			printNode(left, version, level + 1);
+		if (subtree.shared && left == subtree.node->getLeftChild(subtree.version) && right == subtree.node->getRightChild(subtree.version))
+			return subtree.node;
+		return createNode(subtree, left, right, created);
 	}
 
 	/// <summary>
-	/// Zmienia potomka (na odpowiedniej pozycji) we wskazanym wezle i zapisuje zmiany
+	/// Laczy dwa utworzone poddrzewa, z ktorych pierwsze zawiera jedynie elementy mniejsze od elementow drugiego.
+	/// Drugie poddrzewo jest podpinane pod skrajnie prawy wezel pierwszego.
 	/// </summary>
-	/// <param name="value">Wartosc.</param>
-	/// <param name="newChild">Nowe dziecko.</param>
-	void setNewChildForMe(NodePtr parent, NodePtr newChild)
+	/// <param name="left">Poddrzewo z mniejszymi elementami.</param>
+	/// <param name="right">Poddrzewo z wiekszymi elementami.</param>
+	/// <param name="created">Lista utworzonych wezlow.</param>
+	/// <returns></returns>
+	NodePtr concatenate(NodePtr left, NodePtr right, NodeList & created)
 	{
-		propagateChangesAfterInsert(parent, newChild);
+		if (left == nullptr)
+			return right;
+		if (right == nullptr)
+			return left;
+		PathSteps path;
+		for (NodePtr node = left; node != nullptr; node = node->getRightChild(_version + 1))
+			path.push(PathStep{ resultOf(node), true });
+		return rebuildPath(path, right, created);
 	}
 
 	/// <summary>
-	/// Ustawia prawe dziecko wskazanego wezla jako nullptr wraz z propagacja zmian.
+	/// Zwraca poddrzewo, ktore mozna podpiac do nowej wersji: wspoldzielone bez zmian, a pozostale jako kopie.
 	/// </summary>
-	/// <param name="parent">Wezel rodzica.</param>
-	void setRightChildAsNull(NodePtr parent)
+	/// <param name="subtree">Poddrzewo.</param>
+	/// <param name="created">Lista utworzonych wezlow.</param>
+	/// <returns></returns>
+	NodePtr materialize(Subtree const & subtree, NodeList & created)
 	{
-		NodePtr currentChild = nullptr;
-		NodePtr currentParent = parent;
-		if (parent->getChangeType() == ChangeType::None)
+		if (subtree.node == nullptr || subtree.shared)
+			return subtree.node;
+		// kolejnosc: wezel, prawe poddrzewo, lewe poddrzewo; czytana od konca daje kazdy wezel po jego poddrzewach
+		NodeStack<NodePtr> pending, order, copies;
+		pending.push(subtree.node);
+		while (!pending.empty())
 		{
-			parent->setChange(ChangeType::RightChild, nullptr, _version);
-			return;
+			NodePtr node = pending.top();
+			pending.pop();
+			order.push(node);
+			if (NodePtr left = node->getLeftChild(subtree.version))
+				pending.push(left);
+			if (NodePtr right = node->getRightChild(subtree.version))
+				pending.push(right);
 		}
-		else
+		for (; !order.empty(); order.pop())
 		{
-			NodePtr newParent = makeCopy(parent, _version);
-			newParent->setRightChild(nullptr);
-			currentChild = newParent;
-			currentParent = getParentNode(*currentChild->getValue(_version), _version);
+			Subtree source = { order.top(), subtree.version, false, subtree.local };
+			NodePtr right = nullptr, left = nullptr;
+			if (source.node->getRightChild(source.version) != nullptr)
+			{
+				right = copies.top();
+				copies.pop();
+			}
+			if (source.node->getLeftChild(source.version) != nullptr)
+			{
+				left = copies.top();
+				copies.pop();
+			}
+			copies.push(createNode(source, left, right, created));
 		}
-		propagateChangesAfterInsert(currentParent, currentChild);
+		return copies.top();
 	}
 
 	/// <summary>
-	/// Ustawia lewe dziecko wskazanego wezla jako nullptr wraz z propagacja zmian.
+	/// Tworzy wezel operacji na zbiorach z wartoscia korzenia poddrzewa i zapisuje go na liscie utworzonych wezlow.
+	/// Wartosc poddrzewa lokalnego jest wspoldzielona, a wartosc innego drzewa kopiowana.
 	/// </summary>
-	/// <param name="parent">Wezel rodzica.</param>
-	void setLeftChildAsNull(NodePtr parent)
+	NodePtr createNode(Subtree const & source, NodePtr left, NodePtr right, NodeList & created)
 	{
-		NodePtr currentChild = nullptr;
-		NodePtr currentParent = parent;
-		if (parent->getChangeType() == ChangeType::None)
-		{
-			parent->setChange(ChangeType::LeftChild, nullptr, _version);
-			return;
-		}
-		else
+		Type * value = source.node->getValue(source.version);
+		NodePtr node = source.local ? makeSharedNode(value, left, right) : makeNode(*value, left, right);
+		created.push_back(node);
+		return node;
+	}
+
+	/// <summary>
+	/// Zwalnia wezly utworzone przez operacje na zbiorach, ktore nie sa osiagalne z korzenia wyniku.
+	/// Dzieci wezlow istniejacych przed operacja nie sa przegladane, bo nie moga byc nowymi wezlami.
+	/// </summary>
+	/// <param name="root">Korzen wyniku.</param>
+	/// <param name="created">Lista utworzonych wezlow.</param>
+	void releaseUnused(NodePtr root, NodeList const & created)
+	{
+		std::unordered_set<NodePtr> unused(created.begin(), created.end());
+		NodeStack<NodePtr> stack;
+		if (unused.erase(root) != 0)
+			stack.push(root);
+		while (!stack.empty())
 		{
-			NodePtr newParent = makeCopy(parent, _version);
-			newParent->setLeftChild(nullptr);
-			currentChild = newParent;
-			currentParent = getParentNode(*currentChild->getValue(_version), _version);
+			NodePtr node = stack.top();
+			stack.pop();
+			NodePtr left = node->getLeftChild(_version);
+			NodePtr right = node->getRightChild(_version);
+			if (left != nullptr && unused.erase(left) != 0)
+				stack.push(left);
+			if (right != nullptr && unused.erase(right) != 0)
+				stack.push(right);
 		}
-		propagateChangesAfterInsert(currentParent, currentChild);
+		for (NodePtr node : unused)
+			deallocateNode(node);
 	}
 
 	/// <summary>
-	/// Zmienia wartosc w wezle i propaguje te zmiane
+	/// Wywoluje funkcje dla kazdej roznicy miedzy dwiema wersjami drzewa: z para (wartosc, nullptr) dla elementu
+	/// usunietego, (nullptr, wartosc) dla dodanego i (wartosc, wartosc) dla klucza, ktorego wartosc lezy w innym
+	/// wezle. Obie wersje przechodzone sa naraz w kolejnosci, a poddrzewo wspolne obu wersji jest pomijane w calosci,
+	/// dlatego koszt zalezy od liczby wezlow, ktorych wersje nie wspoldziela, a nie od liczby elementow. Poddrzewo,
+	/// ktorego korzen lezy poza zakresem poddrzewa drugiej wersji, moze je zawierac, wiec jest rozwijane jako pierwsze,
+	/// zeby przejscia spotkaly sie na wspolnym poddrzewie. Wspolny wezel musi byc czytany w obu wersjach tak samo,
+	/// co zachodzi dla wersji aktualnej i wersji zapisanej bezposrednio po niej.
 	/// </summary>
-	/// <param name="node">Wezel.</param>
-	/// <param name="value">Nowa wartosc.</param>
-	/// <param name="version">Wersja drzewa.</param>
-	void changeValue(NodePtr node, Type * value)
+	/// <param name="before">Wczesniejsza wersja.</param>
+	/// <param name="after">Pozniejsza wersja.</param>
+	/// <param name="visit">Funkcja wywolywana dla wartosci z wczesniejszej i pozniejszej wersji.</param>
+	template<class Visit>
+	void forEachChange(int before, int after, Visit visit) const
 	{
-		if (node->getChangeType() == ChangeType::None)
+		int readBefore = before, readAfter = after;
+		ChangeSteps previous, next;
+		if (NodePtr root = getRoot(readBefore))
+			previous.push(ChangeStep{ root, true });
+		if (NodePtr root = getRoot(readAfter))
+			next.push(ChangeStep{ root, true });
+		while (!previous.empty() && !next.empty())
+		{
+			ChangeStep removed = previous.top(), added = next.top();
+			Type const * removedValue = removed.node->getValue(before);
+			Type const * addedValue = added.node->getValue(after);
+			if (removed.whole && added.whole)
+			{
+				if (removed.node == added.node)
+				{
+					previous.pop();
+					next.pop();
+					continue;
+				}
+				bool distinct = compareWith(orderFunctor, *removedValue, *addedValue) != 0;
+				bool removedOutside = distinct && outside(*removedValue, added.node, after);
+				bool addedOutside = distinct && outside(*addedValue, removed.node, before);
+				if (removedOutside || !addedOutside)
+					expand(previous, before);
+				if (addedOutside || !removedOutside)
+					expand(next, after);
+			}
+			else if (removed.whole)
+			{
+				if (orderFunctor(*addedValue, *extremeOf(removed.node, before, true)))
+				{
+					visit(static_cast<Type const *>(nullptr), addedValue);
+					next.pop();
+				}
+				else
+					expand(previous, before);
+			}
+			else if (added.whole)
+			{
+				if (orderFunctor(*removedValue, *extremeOf(added.node, after, true)))
+				{
+					visit(removedValue, static_cast<Type const *>(nullptr));
+					previous.pop();
+				}
+				else
+					expand(next, after);
+			}
+			else
+			{
+				int order = compareWith(orderFunctor, *removedValue, *addedValue);
+				if (order <= 0)
+					previous.pop();
+				if (order >= 0)
+					next.pop();
+				if (order < 0)
+					visit(removedValue, static_cast<Type const *>(nullptr));
+				else if (order > 0)
+					visit(static_cast<Type const *>(nullptr), addedValue);
+				else if (removedValue != addedValue)
+					visit(removedValue, addedValue);
+			}
+		}
+		for (; !previous.empty(); previous.pop())
 		{
-			Type * newValue = _typeAllocator.allocate(1);
-			_typeAllocator.construct(newValue, *value);
-			node->setChange(ChangeType::Value, *newValue, _version + 1);
+			while (previous.top().whole)
+				expand(previous, before);
+			visit(previous.top().node->getValue(before), static_cast<Type const *>(nullptr));
 		}
-		else
+		for (; !next.empty(); next.pop())
 		{
-			NodePtr currentNode = makeCopy(node, value, _version + 1);
-			NodePtr currentParent = getParentNode(*node->getValue(_version), _version);
-			propagateChangesAfterInsert(currentParent, currentNode);
+			while (next.top().whole)
+				expand(next, after);
+			visit(static_cast<Type const *>(nullptr), next.top().node->getValue(after));
 		}
 	}
 
 	/// <summary>
-	/// Tworzy kopie wezla z uwzglednieniem pola zmiany.
+	/// Zastepuje poddrzewo na szczycie stosu przejscia jego lewym poddrzewem, wartoscia korzenia i prawym poddrzewem.
 	/// </summary>
-	/// <param name="node">Wezel.</param>
-	/// <param name="version">Wersja drzewa.</param>
-	/// <returns></returns>
-	NodePtr makeCopy(NodePtr node, int version)
+	/// <param name="steps">Stos przejscia wersji.</param>
+	/// <param name="version">Wersja, w ktorej czytane sa wezly.</param>
+	void expand(ChangeSteps & steps, int version) const
 	{
-		Type * value = node->getValue(version);
-		NodePtr copy = allocateNode(*value);
-		copy->setRightChild(node->getRightChild(version));
-		copy->setLeftChild(node->getLeftChild(version));
-		return copy;
+		NodePtr node = steps.top().node;
+		steps.pop();
+		if (NodePtr right = node->getRightChild(version))
+			steps.push(ChangeStep{ right, true });
+		steps.push(ChangeStep{ node, false });
+		if (NodePtr left = node->getLeftChild(version))
+			steps.push(ChangeStep{ left, true });
 	}
 
 	/// <summary>
-	/// worzy kopie wezla z uwzglednieniem pola zmiany i nowej wartosci
+	/// Sprawdza, czy wartosc lezy poza przedzialem od najmniejszego do najwiekszego elementu poddrzewa.
 	/// </summary>
-	/// <param name="node">Wezel.</param>
-	/// <param name="value">Nowa wartosc.</param>
-	/// <param name="version">Wersja drzewa.</param>
+	/// <param name="value">Wartosc.</param>
+	/// <param name="node">Korzen poddrzewa.</param>
+	/// <param name="version">Wersja, w ktorej czytane sa wezly.</param>
 	/// <returns></returns>
-	NodePtr makeCopy(NodePtr node, Type * value, int version)
+	bool outside(Type const & value, NodePtr node, int version) const
 	{
-		NodePtr copy = allocateNode(*value);
-		copy->setRightChild(node->getRightChild(version));
-		copy->setLeftChild(node->getLeftChild(version));
-		return copy;
+		return orderFunctor(value, *extremeOf(node, version, true)) || orderFunctor(*extremeOf(node, version, false), value);
 	}
 
 	/// <summary>
-	/// Potwierdzenie zmiany w historii.
+	/// Poprawia indeks aktualnej wersji i indeks czasu zycia kluczy o roznice miedzy aktualna a poprzednia wersja
+	/// (patrz forEachChange), wiec oba indeksy dostaja tylko klucze usuniete i dodane przez operacje.
 	/// </summary>
-	void confirmChange()
+	/// <param name="previous">Poprzednia wersja.</param>
+	void trackChanges(int previous)
 	{
-		++_version;
+		forEachChange(previous, _version, [this](Type const * removed, Type const * added)
+		{
+			if (_headIndexEnabled)
+			{
+				if (added != nullptr)
+					_headIndex.assign(added);
+				else
+					_headIndex.erase(*removed);
+			}
+			if (_lifetimesEnabled)
+			{
+				if (added == nullptr)
+					_lifetimes.close(*removed, _version);
+				else if (removed == nullptr)
+					_lifetimes.open(added, _version);
+			}
+		});
 	}
 
 	/// <summary>
-	/// Zapisuje do referencji poprawna wersja drzewa na podstawie przekazanego argumentu.
+	/// Przenosi wpis indeksu aktualnej wersji wskazujacy wartosc zwalnianego wezla na wartosc wezla aktualnej wersji.
 	/// </summary>
-	/// <param name="version">Wersja.</param>
-	/// <returns>True, jezeli poprawna wersja istnieje, false, jezeli nie.</returns>
-	bool getCorrectVersion(int & version) const
+	/// <param name="node">Zwalniany wezel.</param>
+	void relinkHeadIndex(NodePtr node)
 	{
-		int currentVersion = getCurrentVersion();
-		if (version == CURRENT_VERSION)
-			version = currentVersion;
-		return true;
+		// wezel kopiujacy wezly ma wartosc poczatkowa i wartosc z pola zmiany
+		Type const * values[] = { node->getValue(FIRST_VERSION), node->getValue(_version) };
+		for (Type const * value : values)
+			if (_headIndex.find(*value) == value)
+				_headIndex.assign(findNode(*value, _version)->getValue(_version));
 	}
 
 	/// <summary>
-	/// Zwraca korzen do drzewa o wskazanej wersji
+	/// Zwraca agregat wartosci przedzialu wyznaczonego przez dwa warunki granic. Schodzi do wezla, w ktorym rozchodza sie
+	/// sciezki do obu granic, a od niego wzdluz kazdej granicy, zbierajac agregaty poddrzew lezacych w przedziale.
 	/// </summary>
-	/// <param name="version">Wersja.</param>
+	/// <param name="aboveLower">Warunek spelniony przez wartosci nie lezace przed przedzialem.</param>
+	/// <param name="belowUpper">Warunek spelniony przez wartosci nie lezace za przedzialem.</param>
+	/// <param name="version">Wersja drzewa.</param>
 	/// <returns></returns>
-	NodePtr getRoot(int & version) const
+	template<class AboveLower, class BelowUpper>
+	Summary aggregateWithin(AboveLower aboveLower, BelowUpper belowUpper, int version) const
 	{
-		NodePtr result = nullptr;
-		if (!getCorrectVersion(version))
-			return result;
-		for (RootVec::const_reverse_iterator it = _root.crbegin(); it != _root.crend(); ++it)
+		NodePtr split = getRoot(version);
+		while (split != nullptr)
 		{
-			if (version >= it->first)
-			{
-				result = it->second;
+			Type const & value = *split->getValue(version);
+			if (!aboveLower(value))
+				split = split->getRightChild(version);
+			else if (!belowUpper(value))
+				split = split->getLeftChild(version);
+			else
 				break;
-			}
 		}
-		return result;
-	}
-
-	/// <summary>
-	/// Ustawia najwieksza wartosc w lewym poddrzwie usuwanego wezla jako ten wezel.
-	/// </summary>
-	/// <param name="node">Wezel.</param>
-	/// <param name="version">Wersja.</param>
-	void setLargestValueInLeftSubtreeAsChild(NodePtr node)
-	{
-		NodePtr largestInLeftSubtree = node->getLeftChild(_version);
-		bool found = false;
-		while (!found)
+		if (split == nullptr)
+			return Aggregate::identity();
+		// lewa granica: zbieramy prawe poddrzewa wezlow w przedziale
+		Summary left = Aggregate::identity();
+		NodePtr node = split->getLeftChild(version);
+		while (node != nullptr)
 		{
-			NodePtr next = largestInLeftSubtree->getRightChild(_version);
-			if (next != nullptr)
-				largestInLeftSubtree = next;
+			Type const & value = *node->getValue(version);
+			if (!aboveLower(value))
+			{
+				node = node->getRightChild(version);
+			}
 			else
-				found = true;
+			{
+				left = Aggregate::combine(Aggregate::combine(Aggregate::lift(value), summaryOf(node->getRightChild(version))), left);
+				node = node->getLeftChild(version);
+			}
 		}
-		NodePtr largestInLeftSubtreeLeftChild = largestInLeftSubtree->getLeftChild(_version);
-		Type * value = largestInLeftSubtree->getValue(_version);
-		NodePtr largestInLeftSubtreeParent = getParentNode(*largestInLeftSubtree->getValue(_version), _version);
-
-		if (largestInLeftSubtreeLeftChild != nullptr)
-			setNewChildForMe(largestInLeftSubtreeParent, largestInLeftSubtreeLeftChild);
-		else
+		// prawa granica: zbieramy lewe poddrzewa wezlow w przedziale
+		Summary right = Aggregate::identity();
+		node = split->getRightChild(version);
+		while (node != nullptr)
 		{
-			if (largestInLeftSubtreeParent == node)
-				setLeftChildAsNull(largestInLeftSubtreeParent);
+			Type const & value = *node->getValue(version);
+			if (belowUpper(value))
+			{
+				right = Aggregate::combine(right, Aggregate::combine(summaryOf(node->getLeftChild(version)), Aggregate::lift(value)));
+				node = node->getRightChild(version);
+			}
 			else
-				setRightChildAsNull(largestInLeftSubtreeParent);
-		}
-		Type & val = *node->getValue(_version + 1);
-		auto newNodeIt = find(val, _version + 1);
-		if (newNodeIt != end())
-		{
-			node = newNodeIt.getNode();
-			changeValue(node, value);
+			{
+				node = node->getLeftChild(version);
+			}
 		}
+		return Aggregate::combine(Aggregate::combine(left, Aggregate::lift(*split->getValue(version))), right);
 	}
 
 	/// <summary>
-	/// Propaguje zmiany w drzewie po tym jak rodzic otrzyma nowe dziecko.
+	/// Zwraca agregat poddrzewa, element neutralny dla pustego poddrzewa.
 	/// </summary>
-	/// <param name="firstParent">Rodzic w ktorym natepuje zmiana.</param>
-	/// <param name="firstChild">Nowe dziecko rodzica.</param>
-	void propagateChangesAfterInsert(NodePtr firstParent, NodePtr firstChild)
+	/// <param name="node">Korzen poddrzewa.</param>
+	/// <returns></returns>
+	Summary summaryOf(NodePtr node) const
 	{
-		NodePtr currentParent = firstParent;
-		NodePtr currentChild = firstChild;
-		bool stop = false;
-		do
-		{
-			if (currentParent == nullptr)
-			{
-				_root.push_back(std::pair<int, NodePtr>(_version + 1, currentChild));
-				stop = true;
-			}
-			else
-			{
-				if (currentParent->getChangeType() == ChangeType::None)
-				{
-					Type * childValue = currentChild->getValue(_version);
-					Type * parentValue = currentParent->getValue(_version);
-					ChangeType type = orderFunctor(*childValue, *parentValue) ? ChangeType::LeftChild : ChangeType::RightChild;
-					currentParent->setChange(type, currentChild, _version + 1);
-					stop = true;
-				}
-				else
-				{
-					NodePtr newParent = makeCopy(currentParent, _version);
-					if (orderFunctor(*currentChild->getValue(_version), *newParent->getValue(_version)))
-						newParent->setLeftChild(currentChild);
-					else
-						newParent->setRightChild(currentChild);
-					currentChild = newParent;
-					currentParent = getParentNode(*currentChild->getValue(_version), _version);
-				}
-			}
-		} while (!stop);
+		return node != nullptr ? node->getSummary() : Aggregate::identity();
 	}
 
 	/// <summary>
-	/// Alokuje pamiec na nowy wezel i zwraca go.
+	/// Wylicza agregat wezla z agregatow jego dzieci i jego wartosci.
 	/// </summary>
-	/// <param name="value">Wartosc wezla.</param>
-	/// <returns></returns>
-	NodePtr allocateNode(Type & value)
+	/// <param name="node">Wezel.</param>
+	void updateSummary(NodePtr node, std::true_type)
+	{
+		Summary left = summaryOf(node->getLeftChild(_version));
+		Summary own = Aggregate::lift(*node->getValue(_version));
+		Summary right = summaryOf(node->getRightChild(_version));
+		node->setSummary(Aggregate::combine(Aggregate::combine(left, own), right));
+	}
+
+	void updateSummary(NodePtr, std::false_type)
 	{
-		NodePtr p = _allocator.allocate(1);
-		Type * val = _typeAllocator.allocate(1);
-		_typeAllocator.construct(val, value);
-		_allocator.construct(p, *val);
-		return p;
 	}
 
 	/// <summary>
 	/// Dealokuje wezel z pamieci.
 	/// </summary>
 	/// <param name="p">Wskaznik do wezla.</param>
-	void deallocateNode(Node<Type> * p)
+	void deallocateNode(NodePtr p)
 	{
-		if (p->getChangeType() == ChangeType::Value)
-		{
-			Type * changeVal = p->getChange().value;
-			_typeAllocator.destroy(changeVal);
-			_typeAllocator.deallocate(changeVal, 1);
-		}
-		Type * val = p->getValue(FIRST_VERSION);
-		_typeAllocator.destroy(val);
-		_typeAllocator.deallocate(val, 1);
+		deallocateChangedValue(p, HasImmutableNodes());
+		releaseValue(p->getValue(FIRST_VERSION));
 		_allocator.destroy(p);
 		_allocator.deallocate(p);
 	}
 
+	/// <summary>
+	/// Dealokuje wartosc zapisana w polu zmiany wezla.
+	/// </summary>
+	/// <param name="p">Wskaznik do wezla.</param>
+	void deallocateChangedValue(NodePtr p, std::false_type)
+	{
+		if (p->getChangeType() == ChangeType::Value)
+			releaseValue(p->getChange().value);
+	}
+
+	void deallocateChangedValue(NodePtr, std::true_type)
+	{
+	}
+
+	/// <summary>
+	/// Zwraca dziecko zapisane w polu zmiany wezla albo nullptr.
+	/// </summary>
+	/// <param name="node">Wezel.</param>
+	/// <returns></returns>
+	NodePtr getChangedChild(NodePtr node, std::false_type)
+	{
+		auto changeType = node->getChangeType();
+		return changeType == ChangeType::LeftChild || changeType == ChangeType::RightChild ? node->getChange().child : nullptr;
+	}
+
+	NodePtr getChangedChild(NodePtr, std::true_type)
+	{
+		return nullptr;
+	}
+
 	/// <summary>
 	/// Dealokuje wszystkie wezly z pamieci.
 	/// </summary>
@@ -777,8 +3897,7 @@ private:
 			return;
 		auto rightChild = node->getRightChild(FIRST_VERSION);
 		auto leftChild = node->getLeftChild(FIRST_VERSION);
-		auto changeType = node->getChangeType();
-		auto changedChild = changeType == ChangeType::LeftChild || changeType == ChangeType::RightChild ? node->getChange().child : nullptr;
+		auto changedChild = getChangedChild(node, HasImmutableNodes());
 		nodesToRemove.insert(node);
 		if (rightChild != nullptr && nodesToRemove.find(rightChild) == nodesToRemove.end())
 			searchNodesToRemove(rightChild, nodesToRemove);
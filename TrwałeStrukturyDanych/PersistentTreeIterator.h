@@ -1,33 +1,45 @@
 #pragma once
 #include <iterator>
-#include <stack>
+#include <type_traits>
 #include "Node.h"
-#include "PersistentTree.h"
-#include <vector>
+#include "NodeStack.h"
 
 /// <summary>
-/// Iterator typu forward, sluzacy do przechodzenia przez cale drzewo poszukiwan binarnych we wskazanej wersji.
+/// Iterator dwukierunkowy, sluzacy do przechodzenia przez cale drzewo poszukiwan binarnych we wskazanej wersji.
+/// Przechowuje sciezke od korzenia do biezacego wezla w buforze wbudowanym, dzieki czemu
+/// tworzenie, kopiowanie i przesuwanie iteratora nie alokuje pamieci.
 /// </summary>
-template<class Type, class UnqualifiedType = std::remove_cv_t<Type>>
-class PersistentTreeIterator : public std::iterator<std::forward_iterator_tag, UnqualifiedType, std::ptrdiff_t, Type*, Type&>
+template<class Type, class NodeType = Node<std::remove_cv_t<Type>>>
+class PersistentTreeIterator
 {
-	typedef Node<UnqualifiedType>* NodePtrType;
+	typedef NodeType* NodePtr;
+
+	template<class OtherType, class OtherNodeType>
+	friend class PersistentTreeIterator;
 
 	/// <summary>
-	/// Stos wezlow po ktorych nalezy iterowac.
+	/// Sciezka od korzenia do biezacego wezla. Pusta sciezka oznacza koniec kolekcji.
 	/// </summary>
-	std::stack<NodePtrType, std::vector<NodePtrType>> stack;
-	int version;
+	NodeStack<NodePtr> stack;
 
-	typedef Node<Type>* NodePtr;
+	/// <summary>
+	/// Korzen drzewa, potrzebny do cofniecia sie z konca kolekcji.
+	/// </summary>
+	NodePtr root;
+	int version;
 
 public:
+	typedef std::bidirectional_iterator_tag iterator_category;
+	typedef std::remove_cv_t<Type> value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef Type* pointer;
+	typedef Type& reference;
 
 	/// <summary>
 	/// Domyslny konstruktor, rownoznaczny koncowi kolekcji
 	/// </summary>
 	/// <returns></returns>
-	PersistentTreeIterator()
+	PersistentTreeIterator() : root(nullptr), version(0)
 	{
 	}
 
@@ -36,54 +48,56 @@ public:
 	/// </summary>
 	/// <param name="root">Korzen drzewa poszukiwan.</param>
 	/// <param name="version">Wersja po ktorej nalezy przeszukiwac.</param>
-	PersistentTreeIterator(NodePtrType root, int version) : version(version)
+	PersistentTreeIterator(NodePtr root, int version) : root(root), version(version)
 	{
-		if (root == nullptr)
-			return;
-		bool end = false;
-		NodePtr currentNode = root;
-		stack.push(root);
-		while (!end)
-		{
-			NodePtr left(currentNode->getLeftChild(version));
-			if (left != nullptr)
-			{
-				stack.push(left);
-				currentNode = left;
-			}
-			else
-			{
-				end = true;
-			}
-		}
+		pushLeftPath(root);
 	}
 
-	template<class OrderFunctor>
-	PersistentTreeIterator(NodePtrType node, NodePtrType root, OrderFunctor orderFunctor, int version) : version(version)
+	/// <summary>
+	/// Konstruktor iteratora wskazujacego na koniec kolekcji, z ktorego mozna sie cofac.
+	/// </summary>
+	/// <param name="root">Korzen drzewa poszukiwan.</param>
+	/// <param name="version">Wersja po ktorej nalezy przeszukiwac.</param>
+	/// <param name="atEnd">Znacznik konca.</param>
+	PersistentTreeIterator(NodePtr root, int version, bool atEnd) : root(root), version(version)
+	{
+		if (!atEnd)
+			pushLeftPath(root);
+	}
+
+	/// <summary>
+	/// Konstruktor wyszukujacy podany klucz. Sciezka do wezla jest budowana podczas jednego zejscia od korzenia,
+	/// a jezeli klucza nie ma w drzewie, iterator wskazuje na koniec kolekcji.
+	/// </summary>
+	/// <param name="probe">Klucz wyszukiwania (patrz KeyPrefix.h).</param>
+	/// <param name="root">Korzen drzewa poszukiwan.</param>
+	/// <param name="version">Wersja po ktorej nalezy przeszukiwac.</param>
+	template<class Probe>
+	PersistentTreeIterator(Probe const & probe, NodePtr root, int version) : root(root), version(version)
 	{
-		if (root == nullptr || node == nullptr)
-			return;
-		bool found = false;
 		NodePtr currentNode = root;
-		Type * value = node->getValue(version);
-		while (!found)
+		while (currentNode != nullptr)
 		{
-			Type * currNodeValue = currentNode->getValue(version);
-			if (orderFunctor(*value, *currNodeValue))
-			{
-				stack.push(currentNode);
+			stack.push(currentNode);
+			int order = probe.compare(currentNode, version);
+			if (order < 0)
 				currentNode = currentNode->getLeftChild(version);
-			}
-			else if (orderFunctor(*currNodeValue, *value))
-			{
+			else if (order > 0)
 				currentNode = currentNode->getRightChild(version);
-			}
 			else
-			{
-				stack.push(currentNode);
-				found = true;
-			}
+				return;
 		}
+		stack.clear();
+	}
+
+	/// <summary>
+	/// Konwersja iteratora na iterator staly.
+	/// </summary>
+	/// <param name="origin">Iterator zrodlowy.</param>
+	template<class OtherType, class = std::enable_if_t<std::is_convertible<OtherType*, Type*>::value>>
+	PersistentTreeIterator(PersistentTreeIterator<OtherType, NodeType> const & origin)
+		: stack(origin.stack), root(origin.root), version(origin.version)
+	{
 	}
 
 	/// <summary>
@@ -93,7 +107,7 @@ public:
 	PersistentTreeIterator& operator ++ ()
 	{
 		if (!stack.empty())
-			next(version);
+			next();
 		return *this;
 	}
 
@@ -110,18 +124,41 @@ public:
 	}
 
 	/// <summary>
-	/// Operator rownosci
+	/// Predekrementacja iteratora. Cofniecie sie z konca kolekcji ustawia iterator na najwiekszym elemencie.
+	/// </summary>
+	/// <returns></returns>
+	PersistentTreeIterator& operator -- ()
+	{
+		if (stack.empty())
+			pushRightPath(root);
+		else
+			previous();
+		return *this;
+	}
+
+	/// <summary>
+	/// Postdekrementacja iteratora
+	/// </summary>
+	/// <param name=""></param>
+	/// <returns></returns>
+	PersistentTreeIterator operator -- (int)
+	{
+		PersistentTreeIterator tmp(*this);
+		operator--();
+		return tmp;
+	}
+
+	/// <summary>
+	/// Operator rownosci. Iteratory sa rowne, jezeli wskazuja na ten sam wezel.
 	/// </summary>
 	/// <param name="rhs">Iterator do porownania.</param>
 	/// <returns></returns>
 	template<class OtherType>
-	bool operator == (PersistentTreeIterator<OtherType> const & rhs) const
+	bool operator == (PersistentTreeIterator<OtherType, NodeType> const & rhs) const
 	{
-		if (stack.empty() && rhs.stack.empty())
-			return true;
-		if ((!stack.empty() && rhs.stack.empty()) || (stack.empty() && !rhs.stack.empty()))
-			return false;
-		return stack.top()->getValue(version) == rhs.stack.top()->getValue(version);
+		if (stack.empty() || rhs.stack.empty())
+			return stack.empty() && rhs.stack.empty();
+		return stack.top() == rhs.stack.top();
 	}
 
 	/// <summary>
@@ -130,7 +167,7 @@ public:
 	/// <param name="rhs">Iterator do porownania.</param>
 	/// <returns></returns>
 	template<class OtherType>
-	bool operator != (PersistentTreeIterator<OtherType> const & rhs) const
+	bool operator != (PersistentTreeIterator<OtherType, NodeType> const & rhs) const
 	{
 		return !(*this == rhs);
 	}
@@ -139,7 +176,12 @@ public:
 	/// Operator dereferencji
 	/// </summary>
 	/// <returns></returns>
-	Type operator * ()
+	reference operator * () const
+	{
+		return *stack.top()->getValue(version);
+	}
+
+	pointer operator -> () const
 	{
 		return stack.top()->getValue(version);
 	}
@@ -148,33 +190,74 @@ public:
 	/// Zwraca wezel drzewa.
 	/// </summary>
 	/// <returns></returns>
-	NodePtr getNode()
+	NodePtr getNode() const
 	{
 		return stack.top();
 	}
 
 private:
 	/// <summary>
-	/// Zwraca kolejny wezel drzewa
+	/// Umieszcza na stosie wezel i wszystkich jego lewych potomkow.
 	/// </summary>
-	/// <param name="version">Wersja.</param>
-	/// <returns></returns>
-	NodePtr next(int version)
+	/// <param name="node">Wezel poczatkowy.</param>
+	void pushLeftPath(NodePtr node)
+	{
+		while (node != nullptr)
+		{
+			stack.push(node);
+			node = node->getLeftChild(version);
+		}
+	}
+
+	/// <summary>
+	/// Umieszcza na stosie wezel i wszystkich jego prawych potomkow.
+	/// </summary>
+	/// <param name="node">Wezel poczatkowy.</param>
+	void pushRightPath(NodePtr node)
 	{
-		NodePtr node(stack.top());
-		stack.pop();
-		NodePtr right(node->getRightChild(version));
+		while (node != nullptr)
+		{
+			stack.push(node);
+			node = node->getRightChild(version);
+		}
+	}
+
+	/// <summary>
+	/// Przechodzi do nastepnika biezacego wezla.
+	/// </summary>
+	void next()
+	{
+		NodePtr right = stack.top()->getRightChild(version);
 		if (right != nullptr)
 		{
-			node = right;
-			while (node != nullptr)
-			{
-				stack.push(node);
-				NodePtr left(node->getLeftChild(version));
-				node = left;
-			}
-			return node;
+			pushLeftPath(right);
+			return;
+		}
+		// wracamy w gore, az dojdziemy do przodka, w ktorego lewym poddrzewie bylismy
+		NodePtr child;
+		do
+		{
+			child = stack.top();
+			stack.pop();
+		} while (!stack.empty() && stack.top()->getLeftChild(version) != child);
+	}
+
+	/// <summary>
+	/// Przechodzi do poprzednika biezacego wezla.
+	/// </summary>
+	void previous()
+	{
+		NodePtr left = stack.top()->getLeftChild(version);
+		if (left != nullptr)
+		{
+			pushRightPath(left);
+			return;
 		}
-		return nullptr;
+		NodePtr child;
+		do
+		{
+			child = stack.top();
+			stack.pop();
+		} while (!stack.empty() && stack.top()->getRightChild(version) != child);
 	}
-};
\ No newline at end of file
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+/// <summary>
+/// Prosi procesor o pobranie do pamieci podrecznej linii zawierajacej podany adres, bez czekania na nia.
+/// Na platformach bez instrukcji pobrania wstepnego nie robi nic.
+/// </summary>
+/// <param name="address">Adres.</param>
+inline void prefetch(void const * address)
+{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+	_mm_prefetch(static_cast<char const *>(address), _MM_HINT_T0);
+#elif defined(__GNUC__)
+	__builtin_prefetch(address);
+#else
+	(void)address;
+#endif
+}
@@ -0,0 +1,266 @@
+#pragma once
+#include "ShardedTreeIterator.h"
+#include "TreeWriter.h"
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// <summary>
+/// Trwaly zbior podzielony na przedzialy kluczy (shardy), z ktorych kazdy jest osobnym drzewem ze wlasnym
+/// frontem zapisu <see cref="TreeWriter"/>. Zapisy do roznych shardow nie dziela licznika wersji ani katalogu
+/// korzeni, wiec wykonywane sa rownolegle przez watki aplikujace shardow.
+/// Wersja globalna to wektor wersji shardow, zapisywany przez publish: kazdy shard podaje widok swojej
+/// ostatniej zatwierdzonej grupy. Zapisy shardow sa od siebie niezalezne, dlatego taki wektor jest spojna
+/// migawka calego zbioru. Odczyty wersji globalnych korzystaja wylacznie z widokow (patrz PersistentTree::View),
+/// wiec moga byc wykonywane w dowolnym watku w trakcie zapisow, a iteracja przechodzi po shardach kolejno,
+/// przedstawiajac jeden uporzadkowany zbior.
+/// Dopoki istnieje drzewo podzielone, drzewa shardow nie sa zwalniane ani czyszczone.
+/// </summary>
+template<class Tree>
+class ShardedTree
+{
+	typedef typename Tree::value_type Type;
+	typedef typename Tree::value_compare OrderFunctor;
+	typedef typename Tree::View View;
+	typedef std::vector<View> Views;
+
+	/// <summary>
+	/// Drzewo shardu wraz z frontem zapisu i widokiem ostatniej zatwierdzonej grupy
+	/// </summary>
+	struct Shard
+	{
+		Tree tree;
+		std::mutex mutex;
+		View published;
+
+		/// <summary>
+		/// Front zapisu jest niszczony jako pierwszy, wiec wykonuje pozostale operacje, gdy drzewo jeszcze istnieje
+		/// </summary>
+		std::unique_ptr<TreeWriter<Tree>> writer;
+	};
+
+	/// <summary>
+	/// Granice przedzialow: shard i zawiera elementy od _boundaries[i - 1] do _boundaries[i], bez tej drugiej
+	/// </summary>
+	std::vector<Type> _boundaries;
+	std::vector<std::unique_ptr<Shard>> _shards;
+	OrderFunctor orderFunctor;
+
+	/// <summary>
+	/// Widoki shardow kolejnych wersji globalnych
+	/// </summary>
+	std::vector<std::shared_ptr<Views const>> _versions;
+	mutable std::mutex _versionsMutex;
+
+public:
+	typedef ShardedTreeIterator<Type, View, typename Tree::iterator> iterator;
+
+	/// <summary>
+	/// Identyfikator przekierowujacy do ostatniej opublikowanej wersji globalnej
+	/// </summary>
+	static const int CURRENT_VERSION = -1;
+
+	/// <summary>
+	/// Tworzy puste drzewo z shardami wyznaczonymi przez granice przedzialow i uruchamia ich watki aplikujace.
+	/// Dla n granic powstaje n + 1 shardow. Wersja globalna 0 to pusty zbior.
+	/// </summary>
+	/// <param name="boundaries">Granice przedzialow kluczy.</param>
+	/// <param name="groupSize">Najwieksza liczba operacji w jednej grupie frontu zapisu shardu.</param>
+	explicit ShardedTree(std::vector<Type> boundaries, std::size_t groupSize = TreeWriter<Tree>::DEFAULT_GROUP_SIZE)
+		: _boundaries(std::move(boundaries))
+	{
+		std::sort(_boundaries.begin(), _boundaries.end(), orderFunctor);
+		for (std::size_t i = 0; i <= _boundaries.size(); ++i)
+		{
+			Shard * shard = new Shard();
+			_shards.push_back(std::unique_ptr<Shard>(shard));
+			shard->published = shard->tree.view();
+			shard->writer.reset(new TreeWriter<Tree>(shard->tree, groupSize, [shard](int version)
+			{
+				View published = shard->tree.view(version);
+				std::lock_guard<std::mutex> lock(shard->mutex);
+				shard->published = published;
+			}));
+		}
+		publish();
+	}
+
+	ShardedTree(ShardedTree const &) = delete;
+	ShardedTree & operator = (ShardedTree const &) = delete;
+
+	/// <summary>
+	/// Zleca wstawienie wartosci do jej shardu.
+	/// </summary>
+	/// <param name="value">Wartosc do umieszczenia.</param>
+	/// <returns>Future z numerem wersji shardu. Po jego spelnieniu publish zwraca wersje globalna zawierajaca zapis.</returns>
+	std::future<int> insert(Type const & value)
+	{
+		return shardOf(value).writer->insert(value);
+	}
+
+	/// <summary>
+	/// Zleca usuniecie elementu rownowaznego podanej wartosci z jej shardu.
+	/// </summary>
+	/// <param name="value">Wartosc do usuniecia.</param>
+	/// <returns>Future z numerem wersji shardu.</returns>
+	std::future<int> erase(Type const & value)
+	{
+		return shardOf(value).writer->erase(value);
+	}
+
+	/// <summary>
+	/// Zleca zastapienie elementu rownowaznego podanej wartosci albo jej wstawienie, gdy takiego nie ma.
+	/// </summary>
+	/// <param name="value">Nowa wartosc.</param>
+	/// <returns>Future z numerem wersji shardu.</returns>
+	std::future<int> assign(Type const & value)
+	{
+		return shardOf(value).writer->assign(value);
+	}
+
+	/// <summary>
+	/// Zapisuje nowa wersje globalna z widokow ostatnich zatwierdzonych grup wszystkich shardow.
+	/// Zawiera ona kazdy zapis, ktorego future zostal spelniony przed wywolaniem.
+	/// </summary>
+	/// <returns>Numer nowej wersji globalnej.</returns>
+	int publish()
+	{
+		std::shared_ptr<Views> views = std::make_shared<Views>();
+		views->reserve(_shards.size());
+		// muteks wersji trzymany od zebrania widokow, zeby wersje shardow w kolejnych wersjach globalnych nie malaly
+		std::lock_guard<std::mutex> versionsLock(_versionsMutex);
+		for (auto const & shard : _shards)
+		{
+			std::lock_guard<std::mutex> lock(shard->mutex);
+			views->push_back(shard->published);
+		}
+		_versions.push_back(views);
+		return static_cast<int>(_versions.size()) - 1;
+	}
+
+	/// <summary>
+	/// Zwraca numer ostatniej opublikowanej wersji globalnej.
+	/// </summary>
+	/// <returns></returns>
+	int getCurrentVersion() const
+	{
+		std::lock_guard<std::mutex> lock(_versionsMutex);
+		return static_cast<int>(_versions.size()) - 1;
+	}
+
+	/// <summary>
+	/// Zwraca wektor wersji shardow, z ktorych sklada sie wskazana wersja globalna.
+	/// </summary>
+	/// <param name="version">Wersja globalna.</param>
+	/// <returns>Wersje kolejnych shardow albo pusty wektor dla nieistniejacej wersji.</returns>
+	std::vector<int> getVersionVector(int version = CURRENT_VERSION) const
+	{
+		std::vector<int> versions;
+		if (std::shared_ptr<Views const> views = viewsOf(version))
+			for (View const & view : *views)
+				versions.push_back(view.getVersion());
+		return versions;
+	}
+
+	/// <summary>
+	/// Zwraca liczbe shardow.
+	/// </summary>
+	/// <returns></returns>
+	std::size_t shardCount() const
+	{
+		return _shards.size();
+	}
+
+	/// <summary>
+	/// Zwraca iterator na najmniejszy element wskazanej wersji globalnej.
+	/// </summary>
+	/// <param name="version">Wersja globalna. Brak parametru oznacza ostatnia opublikowana wersje</param>
+	/// <returns></returns>
+	iterator begin(int version = CURRENT_VERSION) const
+	{
+		std::shared_ptr<Views const> views = viewsOf(version);
+		if (views == nullptr)
+			return end();
+		return iterator(views, 0, views->front().begin());
+	}
+
+	iterator end(int = CURRENT_VERSION) const
+	{
+		return iterator();
+	}
+
+	/// <summary>
+	/// Wyszukuje podana wartosc we wskazanej wersji globalnej. Przeszukiwany jest jedynie shard wartosci.
+	/// </summary>
+	/// <param name="value">Wartosc do wyszukania.</param>
+	/// <param name="version">Wersja globalna.</param>
+	/// <returns>Iterator na element albo iterator konca.</returns>
+	iterator find(Type const & value, int version = CURRENT_VERSION) const
+	{
+		return findKey(value, version);
+	}
+
+	/// <summary>
+	/// Wyszukuje element rownowazny podanemu kluczowi. Dostepne dla funktorow porzadku z typem is_transparent.
+	/// </summary>
+	template<class Key, class Order = OrderFunctor, class = typename Order::is_transparent>
+	iterator find(Key const & key, int version = CURRENT_VERSION) const
+	{
+		return findKey(key, version);
+	}
+
+	bool contains(Type const & value, int version = CURRENT_VERSION) const
+	{
+		return findKey(value, version) != end();
+	}
+
+	template<class Key, class Order = OrderFunctor, class = typename Order::is_transparent>
+	bool contains(Key const & key, int version = CURRENT_VERSION) const
+	{
+		return findKey(key, version) != end();
+	}
+
+private:
+	/// <summary>
+	/// Zwraca indeks shardu, do ktorego nalezy klucz.
+	/// </summary>
+	template<class Key>
+	std::size_t indexOf(Key const & key) const
+	{
+		return std::upper_bound(_boundaries.begin(), _boundaries.end(), key, orderFunctor) - _boundaries.begin();
+	}
+
+	Shard & shardOf(Type const & value) const
+	{
+		return *_shards[indexOf(value)];
+	}
+
+	/// <summary>
+	/// Zwraca widoki shardow wskazanej wersji globalnej albo nullptr dla nieistniejacej wersji.
+	/// </summary>
+	std::shared_ptr<Views const> viewsOf(int version) const
+	{
+		std::lock_guard<std::mutex> lock(_versionsMutex);
+		if (version == CURRENT_VERSION)
+			version = static_cast<int>(_versions.size()) - 1;
+		if (version < 0 || version >= static_cast<int>(_versions.size()))
+			return nullptr;
+		return _versions[version];
+	}
+
+	template<class Key>
+	iterator findKey(Key const & key, int version) const
+	{
+		std::shared_ptr<Views const> views = viewsOf(version);
+		if (views == nullptr)
+			return end();
+		std::size_t index = indexOf(key);
+		View const & view = (*views)[index];
+		auto it = view.find(key);
+		if (it == view.end())
+			return end();
+		return iterator(views, index, it);
+	}
+};
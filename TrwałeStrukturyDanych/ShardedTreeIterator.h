@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+/// <summary>
+/// Iterator jednokierunkowy po globalnej wersji drzewa podzielonego na shardy.
+/// Przechodzi kolejno po widokach shardow tej wersji, pomijajac shardy puste, dzieki czemu
+/// elementy wszystkich shardow odwiedzane sa w jednym porzadku. Iterator wspoldzieli wektor widokow
+/// z drzewem, wiec pozostaje wazny rowniez po opublikowaniu kolejnych wersji.
+/// </summary>
+template<class Type, class View, class TreeIterator>
+class ShardedTreeIterator
+{
+	typedef std::vector<View> Views;
+
+	std::shared_ptr<Views const> views;
+	std::size_t shard;
+	TreeIterator current;
+
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef Type value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef Type const * pointer;
+	typedef Type const & reference;
+
+	/// <summary>
+	/// Tworzy iterator konca.
+	/// </summary>
+	ShardedTreeIterator() : shard(0)
+	{
+	}
+
+	/// <summary>
+	/// Tworzy iterator na element shardu. Jezeli iterator shardu wskazuje na jego koniec, przechodzi do nastepnego shardu.
+	/// </summary>
+	/// <param name="views">Widoki shardow globalnej wersji.</param>
+	/// <param name="shard">Indeks shardu.</param>
+	/// <param name="current">Iterator w widoku shardu.</param>
+	ShardedTreeIterator(std::shared_ptr<Views const> views, std::size_t shard, TreeIterator current)
+		: views(views), shard(shard), current(current)
+	{
+		skipEmpty();
+	}
+
+	reference operator * () const
+	{
+		return *current;
+	}
+
+	pointer operator -> () const
+	{
+		return &**this;
+	}
+
+	ShardedTreeIterator & operator ++ ()
+	{
+		++current;
+		skipEmpty();
+		return *this;
+	}
+
+	ShardedTreeIterator operator ++ (int)
+	{
+		ShardedTreeIterator it(*this);
+		++*this;
+		return it;
+	}
+
+	bool operator == (ShardedTreeIterator const & rhs) const
+	{
+		if (views == nullptr || rhs.views == nullptr)
+			return views == rhs.views;
+		return shard == rhs.shard && current == rhs.current;
+	}
+
+	bool operator != (ShardedTreeIterator const & rhs) const
+	{
+		return !(*this == rhs);
+	}
+
+private:
+	/// <summary>
+	/// Przechodzi do pierwszego elementu kolejnych shardow, jezeli biezacy shard sie skonczyl.
+	/// </summary>
+	void skipEmpty()
+	{
+		while (current == (*views)[shard].end())
+		{
+			if (++shard == views->size())
+			{
+				views.reset();
+				return;
+			}
+			current = (*views)[shard].begin();
+		}
+	}
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+/// <summary>
+/// Okresla, czy wartosci typu sa wspoldzielone przez kopie wezlow zamiast kopiowane.
+/// Male, trywialnie kopiowalne wartosci kopiuja sie taniej niz licznik odwolan, dlatego sa kopiowane.
+/// </summary>
+template<class Type>
+struct IsSharedValue : std::integral_constant<bool, !std::is_trivially_copyable<Type>::value || (sizeof(Type) > 2 * sizeof(void*))>
+{
+};
+
+/// <summary>
+/// Uklad bloku wartosci wspoldzielonej: licznik odwolan, a za nim, z wyrownaniem typu, sama wartosc.
+/// Wezly przechowuja wskaznik na wartosc, a licznik znajduje sie pod stalym przesunieciem przed nia,
+/// dzieki czemu wezel nie potrzebuje dodatkowego pola. Blok jest trywialnie kopiowalny, wiec moze byc
+/// przydzielany tak jak wezly, rowniez w stercie pliku.
+/// </summary>
+template<class Type>
+class SharedValue
+{
+	typedef std::atomic<int> Counter;
+
+	static const std::size_t ALIGNMENT = alignof(Type) > alignof(Counter) ? alignof(Type) : alignof(Counter);
+
+	/// <summary>
+	/// Przesuniecie wartosci wzgledem poczatku bloku
+	/// </summary>
+	static const std::size_t OFFSET = (sizeof(Counter) + alignof(Type) - 1) / alignof(Type) * alignof(Type);
+
+public:
+	typedef typename std::aligned_storage<OFFSET + sizeof(Type), ALIGNMENT>::type Block;
+
+	/// <summary>
+	/// Inicjalizuje licznik nowego bloku jednym odwolaniem i zwraca miejsce na wartosc.
+	/// </summary>
+	/// <param name="block">Blok.</param>
+	/// <returns></returns>
+	static Type * initialize(Block * block)
+	{
+		new ((void*)block) Counter(1);
+		return reinterpret_cast<Type*>(reinterpret_cast<char*>(block) + OFFSET);
+	}
+
+	/// <summary>
+	/// Zwraca blok, w ktorym lezy wartosc.
+	/// </summary>
+	/// <param name="value">Wartosc.</param>
+	/// <returns></returns>
+	static Block * blockOf(Type * value)
+	{
+		return reinterpret_cast<Block*>(reinterpret_cast<char*>(value) - OFFSET);
+	}
+
+	/// <summary>
+	/// Dodaje odwolanie do wartosci.
+	/// </summary>
+	/// <param name="value">Wartosc.</param>
+	static void acquire(Type * value)
+	{
+		counterOf(value).fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/// <summary>
+	/// Usuwa odwolanie do wartosci.
+	/// </summary>
+	/// <param name="value">Wartosc.</param>
+	/// <returns>True, jezeli bylo to ostatnie odwolanie i wartosc nalezy zwolnic.</returns>
+	static bool release(Type * value)
+	{
+		return counterOf(value).fetch_sub(1, std::memory_order_acq_rel) == 1;
+	}
+
+private:
+	static Counter & counterOf(Type * value)
+	{
+		return *reinterpret_cast<Counter*>(blockOf(value));
+	}
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "ArenaAllocator.h"
+#include <memory>
+
+/// <summary>
+/// Strategia przechowywania drzewa w zwyklej pamieci procesu.
+/// </summary>
+struct HeapStorage
+{
+	static const bool MAPPED = false;
+
+	template<class T>
+	struct AllocatorOf
+	{
+		typedef std::allocator<T> type;
+	};
+
+	template<class T>
+	struct ValueAllocatorOf
+	{
+		typedef std::allocator<T> type;
+	};
+
+	template<class Allocator>
+	static Allocator allocator(ArenaHeap *)
+	{
+		return Allocator();
+	}
+};
+
+/// <summary>
+/// Strategia przechowywania drzewa w pliku odwzorowanym w pamieci (patrz MappedArena.h).
+/// Wezly, wartosci i katalog korzeni przydzielane sa ze sterty pliku, a wartosci musza byc
+/// trywialnie kopiowalne albo byc napisami <see cref="MappedString"/>.
+/// </summary>
+struct MappedStorage
+{
+	static const bool MAPPED = true;
+
+	template<class T>
+	struct AllocatorOf
+	{
+		typedef ArenaAllocator<T> type;
+	};
+
+	template<class T>
+	struct ValueAllocatorOf
+	{
+		typedef ArenaValueAllocator<T> type;
+	};
+
+	template<class Allocator>
+	static Allocator allocator(ArenaHeap * heap)
+	{
+		return Allocator(heap);
+	}
+};
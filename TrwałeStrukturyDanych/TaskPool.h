@@ -0,0 +1,259 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Pula watkow z podkradaniem zadan, przeznaczona do rownoleglosci typu fork-join.
+/// Kazdy watek ma wlasna kolejke zadan. Nowe zadania trafiaja na koniec kolejki watku, ktory je utworzyl,
+/// a bezczynne watki podkradaja zadania z poczatku cudzych kolejek. Watek czekajacy na zakonczenie
+/// zadania wykonuje w tym czasie inne zadania, wiec zagniezdzone wywolania nie blokuja puli.
+/// </summary>
+class TaskPool
+{
+	/// <summary>
+	/// Zadanie wraz z informacja o zakonczeniu i ewentualnym wyjatku.
+	/// </summary>
+	struct Task
+	{
+		std::function<void()> function;
+		std::atomic<bool> done;
+		std::exception_ptr error;
+
+		explicit Task(std::function<void()> function) : function(std::move(function)), done(false)
+		{
+		}
+
+		void run()
+		{
+			try
+			{
+				function();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+			done.store(true, std::memory_order_release);
+		}
+	};
+
+	/// <summary>
+	/// Kolejka zadan jednego watku.
+	/// </summary>
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task*> tasks;
+	};
+
+	/// <summary>
+	/// Pula i indeks kolejki biezacego watku.
+	/// </summary>
+	struct WorkerSlot
+	{
+		TaskPool * pool;
+		std::size_t index;
+	};
+
+	/// <summary>
+	/// Kolejki watkow roboczych. Ostatnia kolejka nalezy do watkow spoza puli.
+	/// </summary>
+	std::vector<std::unique_ptr<Queue>> _queues;
+	std::vector<std::thread> _workers;
+	std::atomic<bool> _stop;
+	std::atomic<int> _pending;
+	std::mutex _sleepMutex;
+	std::condition_variable _wakeUp;
+
+public:
+	/// <summary>
+	/// Tworzy pule o podanej liczbie watkow roboczych.
+	/// </summary>
+	/// <param name="threads">Liczba watkow. Zero oznacza liczbe rdzeni.</param>
+	explicit TaskPool(unsigned threads = 0) : _stop(false), _pending(0)
+	{
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned i = 0; i <= threads; ++i)
+			_queues.push_back(std::unique_ptr<Queue>(new Queue()));
+		for (unsigned i = 0; i < threads; ++i)
+			_workers.push_back(std::thread(&TaskPool::work, this, i));
+	}
+
+	~TaskPool()
+	{
+		_stop.store(true);
+		{
+			std::lock_guard<std::mutex> lock(_sleepMutex);
+			_wakeUp.notify_all();
+		}
+		for (auto & worker : _workers)
+			worker.join();
+	}
+
+	TaskPool(TaskPool const &) = delete;
+	TaskPool & operator = (TaskPool const &) = delete;
+
+	/// <summary>
+	/// Zwraca wspolna pule o liczbie watkow rownej liczbie rdzeni.
+	/// </summary>
+	/// <returns></returns>
+	static TaskPool & shared()
+	{
+		static TaskPool pool;
+		return pool;
+	}
+
+	/// <summary>
+	/// Zwraca liczbe watkow roboczych.
+	/// </summary>
+	/// <returns></returns>
+	std::size_t size() const
+	{
+		return _workers.size();
+	}
+
+	/// <summary>
+	/// Wykonuje dwie funkcje rownolegle i czeka na zakonczenie obu. Pierwsza moze zostac podkradziona
+	/// przez inny watek, druga wykonywana jest przez watek wywolujacy.
+	/// </summary>
+	/// <param name="first">Pierwsza funkcja.</param>
+	/// <param name="second">Druga funkcja.</param>
+	template<class First, class Second>
+	void invoke(First && first, Second && second)
+	{
+		Task task{ std::function<void()>(std::forward<First>(first)) };
+		Queue & queue = *_queues[currentIndex()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.push_back(&task);
+		}
+		_pending.fetch_add(1);
+		_wakeUp.notify_one();
+		std::exception_ptr error;
+		try
+		{
+			second();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		if (take(queue, &task))
+			task.run();
+		else
+			wait(task);
+		if (error)
+			std::rethrow_exception(error);
+		if (task.error)
+			std::rethrow_exception(task.error);
+	}
+
+private:
+	static WorkerSlot & currentSlot()
+	{
+		static thread_local WorkerSlot slot = { nullptr, 0 };
+		return slot;
+	}
+
+	/// <summary>
+	/// Zwraca indeks kolejki biezacego watku w tej puli.
+	/// </summary>
+	/// <returns></returns>
+	std::size_t currentIndex() const
+	{
+		WorkerSlot & slot = currentSlot();
+		return slot.pool == this ? slot.index : _queues.size() - 1;
+	}
+
+	/// <summary>
+	/// Wyjmuje wskazane zadanie z kolejki, jezeli nie zostalo jeszcze podkradziane.
+	/// </summary>
+	/// <param name="queue">Kolejka.</param>
+	/// <param name="task">Zadanie.</param>
+	/// <returns></returns>
+	bool take(Queue & queue, Task * task)
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		auto it = std::find(queue.tasks.rbegin(), queue.tasks.rend(), task);
+		if (it == queue.tasks.rend())
+			return false;
+		queue.tasks.erase(std::next(it).base());
+		_pending.fetch_sub(1);
+		return true;
+	}
+
+	/// <summary>
+	/// Czeka na zakonczenie zadania, wykonujac w tym czasie inne zadania.
+	/// </summary>
+	/// <param name="task">Zadanie.</param>
+	void wait(Task & task)
+	{
+		while (!task.done.load(std::memory_order_acquire))
+		{
+			if (!runOne(currentIndex()))
+				std::this_thread::yield();
+		}
+	}
+
+	/// <summary>
+	/// Wykonuje jedno zadanie: najnowsze z wlasnej kolejki albo najstarsze z cudzej.
+	/// </summary>
+	/// <param name="index">Indeks wlasnej kolejki.</param>
+	/// <returns>False, jezeli nie bylo zadan.</returns>
+	bool runOne(std::size_t index)
+	{
+		Task * task = nullptr;
+		{
+			Queue & own = *_queues[index];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.tasks.empty())
+			{
+				task = own.tasks.back();
+				own.tasks.pop_back();
+			}
+		}
+		for (std::size_t i = 1; task == nullptr && i < _queues.size(); ++i)
+		{
+			Queue & victim = *_queues[(index + i) % _queues.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty())
+			{
+				task = victim.tasks.front();
+				victim.tasks.pop_front();
+			}
+		}
+		if (task == nullptr)
+			return false;
+		_pending.fetch_sub(1);
+		task->run();
+		return true;
+	}
+
+	/// <summary>
+	/// Petla watku roboczego.
+	/// </summary>
+	/// <param name="index">Indeks kolejki watku.</param>
+	void work(std::size_t index)
+	{
+		WorkerSlot & slot = currentSlot();
+		slot.pool = this;
+		slot.index = index;
+		while (!_stop.load())
+		{
+			if (runOne(index))
+				continue;
+			std::unique_lock<std::mutex> lock(_sleepMutex);
+			_wakeUp.wait_for(lock, std::chrono::milliseconds(1), [this] { return _stop.load() || _pending.load() > 0; });
+		}
+	}
+};
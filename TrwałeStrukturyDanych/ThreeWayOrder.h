@@ -0,0 +1,99 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <utility>
+
+/// <summary>
+/// Funktor porzadku zbudowany z porownania trojwartosciowego. Compare zwraca wynik porownywalny z zerem:
+/// liczbe ujemna, zero albo dodatnia, jak std::string::compare, albo, w C++20, uporzadkowanie operatora &lt;=&gt;
+/// (np. std::compare_three_way). Funktor dziala wszedzie tam, gdzie predykat mniejszosci, a drzewo wykorzystuje
+/// jego metode compare, aby na kazdym poziomie porownywac klucze tylko raz.
+/// </summary>
+template<class Compare>
+struct ThreeWayOrder : Compare
+{
+	ThreeWayOrder()
+	{
+	}
+
+	ThreeWayOrder(Compare const & compare) : Compare(compare)
+	{
+	}
+
+	/// <summary>
+	/// Porownuje dwie wartosci.
+	/// </summary>
+	/// <param name="lhs">Pierwsza wartosc.</param>
+	/// <param name="rhs">Druga wartosc.</param>
+	/// <returns>-1, 0 albo 1.</returns>
+	template<class Lhs, class Rhs>
+	int compare(Lhs const & lhs, Rhs const & rhs) const
+	{
+		auto order = static_cast<Compare const &>(*this)(lhs, rhs);
+		return order < 0 ? -1 : (order > 0 ? 1 : 0);
+	}
+
+	template<class Lhs, class Rhs>
+	bool operator () (Lhs const & lhs, Rhs const & rhs) const
+	{
+		return compare(lhs, rhs) < 0;
+	}
+};
+
+/// <summary>
+/// Porownanie trojwartosciowe wartosci funktorem porzadku. Wersja ogolna wywoluje predykat mniejszosci
+/// najwyzej dwa razy, w obie strony.
+/// </summary>
+template<class OrderFunctor, class Lhs, class Rhs, class = void>
+struct OrderComparison
+{
+	static int compare(OrderFunctor const & orderFunctor, Lhs const & lhs, Rhs const & rhs)
+	{
+		if (orderFunctor(lhs, rhs))
+			return -1;
+		if (orderFunctor(rhs, lhs))
+			return 1;
+		return 0;
+	}
+};
+
+/// <summary>
+/// Funktor z metoda compare, np. <see cref="ThreeWayOrder"/>, porownuje wartosci jednym wywolaniem.
+/// </summary>
+template<class OrderFunctor, class Lhs, class Rhs>
+struct OrderComparison<OrderFunctor, Lhs, Rhs,
+	decltype(void(std::declval<OrderFunctor const &>().compare(std::declval<Lhs const &>(), std::declval<Rhs const &>())))>
+{
+	static int compare(OrderFunctor const & orderFunctor, Lhs const & lhs, Rhs const & rhs)
+	{
+		return orderFunctor.compare(lhs, rhs);
+	}
+};
+
+/// <summary>
+/// Napisy w porzadku rosnacym porownywane sa jednym wywolaniem std::basic_string::compare.
+/// </summary>
+template<class Char, class Traits, class Allocator>
+struct OrderComparison<std::less<std::basic_string<Char, Traits, Allocator>>,
+	std::basic_string<Char, Traits, Allocator>, std::basic_string<Char, Traits, Allocator>>
+{
+	typedef std::basic_string<Char, Traits, Allocator> String;
+
+	static int compare(std::less<String> const &, String const & lhs, String const & rhs)
+	{
+		return lhs.compare(rhs);
+	}
+};
+
+/// <summary>
+/// Porownuje dwie wartosci funktorem porzadku, wywolujac go mozliwie raz.
+/// </summary>
+/// <param name="orderFunctor">Funktor porzadku.</param>
+/// <param name="lhs">Pierwsza wartosc.</param>
+/// <param name="rhs">Druga wartosc.</param>
+/// <returns>Liczba ujemna, gdy pierwsza wartosc jest mniejsza, zero, gdy sa rownowazne, dodatnia, gdy jest wieksza.</returns>
+template<class OrderFunctor, class Lhs, class Rhs>
+int compareWith(OrderFunctor const & orderFunctor, Lhs const & lhs, Rhs const & rhs)
+{
+	return OrderComparison<OrderFunctor, Lhs, Rhs>::compare(orderFunctor, lhs, rhs);
+}
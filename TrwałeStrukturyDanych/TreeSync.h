@@ -0,0 +1,261 @@
+#pragma once
+#include "ArchiveCodec.h"
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+
+/// <summary>
+/// Strona zdalna dla PersistentTree::reconcile bedaca wersja drzewa w tym samym procesie.
+/// </summary>
+template<class Tree>
+class TreePeer
+{
+	typedef typename Tree::value_type Type;
+	typedef typename Tree::Summary Summary;
+
+	Tree const & _tree;
+	int _version;
+
+public:
+	TreePeer(Tree const & tree, int version) : _tree(tree), _version(version)
+	{
+	}
+
+	Summary aggregateBetween(Type const * lower, Type const * upper)
+	{
+		return _tree.aggregateBetween(lower, upper, _version);
+	}
+
+	template<class Function>
+	void forEachBetween(Type const * lower, Type const * upper, Function function)
+	{
+		_tree.forEachBetween(lower, upper, _version, function);
+	}
+
+	template<class Function>
+	void lookup(Type const & value, Function function)
+	{
+		if (Type const * found = _tree.lookup(value, _version))
+			function(*found);
+	}
+};
+
+/// <summary>
+/// Protokol uzgadniania wersji przez strumien, np. potok lub gniazdo: zapytanie to bajt rodzaju i granice
+/// albo wartosc, odpowiedz to agregat, ciag wartosci zakonczony zerem albo znacznik i wartosc.
+/// Wartosci kodowane sa przez ArchiveCodec, a agregaty zapisywane bajt po bajcie, dlatego obie strony
+/// musza uzywac tego samego typu agregatu na maszynach o tym samym porzadku bajtow.
+/// </summary>
+struct SyncProtocol
+{
+	enum Request : unsigned char
+	{
+		END = 0,
+		AGGREGATE = 1,
+		VALUES = 2,
+		LOOKUP = 3
+	};
+
+	template<class Type>
+	static void writeValue(std::ostream & out, Type const & value)
+	{
+		ArchiveBytes bytes;
+		ArchiveCodec<Type>::encode(Type(), value, bytes);
+		ArchiveBytes length;
+		writeVarint(length, bytes.size());
+		out.write(reinterpret_cast<char const *>(length.data()), length.size());
+		out.write(reinterpret_cast<char const *>(bytes.data()), bytes.size());
+	}
+
+	template<class Type>
+	static bool readValue(std::istream & in, Type & value)
+	{
+		std::uint64_t length = 0;
+		int shift = 0;
+		int byte;
+		do
+		{
+			byte = in.get();
+			if (byte == std::char_traits<char>::eof())
+				return false;
+			length |= std::uint64_t(byte & 0x7f) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+		ArchiveBytes bytes(static_cast<std::size_t>(length) + 1);
+		if (!in.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(length)))
+			return false;
+		unsigned char const * position = bytes.data();
+		value = ArchiveCodec<Type>::decode(Type(), position);
+		return true;
+	}
+
+	template<class Type>
+	static void writeBound(std::ostream & out, Type const * bound)
+	{
+		out.put(bound != nullptr ? 1 : 0);
+		if (bound != nullptr)
+			writeValue(out, *bound);
+	}
+
+	template<class Type>
+	static bool readBound(std::istream & in, Type & storage, Type const * & bound)
+	{
+		int present = in.get();
+		if (present == std::char_traits<char>::eof())
+			return false;
+		bound = present != 0 ? &storage : nullptr;
+		return present == 0 || readValue(in, storage);
+	}
+
+	template<class Summary>
+	static void writeSummary(std::ostream & out, Summary const & summary)
+	{
+		static_assert(std::is_trivially_copyable<Summary>::value, "Only trivially copyable aggregates can be sent");
+		out.write(reinterpret_cast<char const *>(&summary), sizeof(Summary));
+	}
+
+	template<class Summary>
+	static bool readSummary(std::istream & in, Summary & summary)
+	{
+		return static_cast<bool>(in.read(reinterpret_cast<char *>(&summary), sizeof(Summary)));
+	}
+};
+
+/// <summary>
+/// Strona zdalna dla PersistentTree::reconcile rozmawiajaca przez strumienie ze strona obslugiwana przez servePeer.
+/// Dostepna dla wartosci, dla ktorych zdefiniowano ArchiveCodec (liczby calkowite i napisy).
+/// Blad odczytu odpowiedzi zglaszany jest wyjatkiem std::ios_base::failure.
+/// </summary>
+template<class Type, class Summary>
+class StreamPeer
+{
+	std::istream & _in;
+	std::ostream & _out;
+	bool _open;
+
+	void request(SyncProtocol::Request request, Type const * lower, Type const * upper)
+	{
+		_out.put(static_cast<char>(request));
+		SyncProtocol::writeBound(_out, lower);
+		SyncProtocol::writeBound(_out, upper);
+		_out.flush();
+	}
+
+	static void fail()
+	{
+		throw std::ios_base::failure("The peer closed the stream before answering");
+	}
+
+public:
+	StreamPeer(std::istream & in, std::ostream & out) : _in(in), _out(out), _open(true)
+	{
+	}
+
+	~StreamPeer()
+	{
+		close();
+	}
+
+	/// <summary>
+	/// Konczy rozmowe, dzieki czemu servePeer po drugiej stronie wraca.
+	/// </summary>
+	void close()
+	{
+		if (!_open)
+			return;
+		_open = false;
+		_out.put(static_cast<char>(SyncProtocol::END));
+		_out.flush();
+	}
+
+	Summary aggregateBetween(Type const * lower, Type const * upper)
+	{
+		request(SyncProtocol::AGGREGATE, lower, upper);
+		Summary summary;
+		if (!SyncProtocol::readSummary(_in, summary))
+			fail();
+		return summary;
+	}
+
+	template<class Function>
+	void forEachBetween(Type const * lower, Type const * upper, Function function)
+	{
+		request(SyncProtocol::VALUES, lower, upper);
+		Type value;
+		for (int more = _in.get(); more != 0; more = _in.get())
+		{
+			if (more == std::char_traits<char>::eof() || !SyncProtocol::readValue(_in, value))
+				fail();
+			function(value);
+		}
+	}
+
+	template<class Function>
+	void lookup(Type const & value, Function function)
+	{
+		_out.put(static_cast<char>(SyncProtocol::LOOKUP));
+		SyncProtocol::writeValue(_out, value);
+		_out.flush();
+		int found = _in.get();
+		if (found == std::char_traits<char>::eof())
+			fail();
+		Type remote;
+		if (found != 0)
+		{
+			if (!SyncProtocol::readValue(_in, remote))
+				fail();
+			function(remote);
+		}
+	}
+};
+
+/// <summary>
+/// Odpowiada na zapytania StreamPeer o wskazana wersje drzewa, dopoki druga strona nie zakonczy rozmowy
+/// albo strumien sie nie skonczy. Numer wersji nalezy ustalic przed rozmowa, np. CURRENT_VERSION zamieniona
+/// na getCurrentVersion(), bo zmiany drzewa w trakcie rozmowy nie moga zmieniac odpowiedzi.
+/// </summary>
+/// <param name="tree">Drzewo.</param>
+/// <param name="version">Wersja drzewa.</param>
+/// <param name="in">Strumien zapytan.</param>
+/// <param name="out">Strumien odpowiedzi.</param>
+template<class Tree>
+void servePeer(Tree const & tree, int version, std::istream & in, std::ostream & out)
+{
+	typedef typename Tree::value_type Type;
+	TreePeer<Tree> peer(tree, version);
+	Type lowerStorage, upperStorage;
+	Type const * lower;
+	Type const * upper;
+	for (int request = in.get(); request != std::char_traits<char>::eof() && request != SyncProtocol::END; request = in.get())
+	{
+		if (request == SyncProtocol::LOOKUP)
+		{
+			if (!SyncProtocol::readValue(in, lowerStorage))
+				return;
+			Type const * found = tree.lookup(lowerStorage, version);
+			out.put(found != nullptr ? 1 : 0);
+			if (found != nullptr)
+				SyncProtocol::writeValue(out, *found);
+		}
+		else
+		{
+			if (!SyncProtocol::readBound(in, lowerStorage, lower) || !SyncProtocol::readBound(in, upperStorage, upper))
+				return;
+			if (request == SyncProtocol::AGGREGATE)
+			{
+				SyncProtocol::writeSummary(out, peer.aggregateBetween(lower, upper));
+			}
+			else
+			{
+				peer.forEachBetween(lower, upper, [&out](Type const & value)
+				{
+					out.put(1);
+					SyncProtocol::writeValue(out, value);
+				});
+				out.put(0);
+			}
+		}
+		out.flush();
+	}
+}
@@ -0,0 +1,300 @@
+#pragma once
+#include "MpscQueue.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Front zapisu trwalego drzewa dla wielu watkow producentow (grupowe zatwierdzanie).
+/// Producenci wstawiaja operacje do nieblokujacej kolejki i otrzymuja future z numerem wersji.
+/// Jeden watek aplikujacy oproznia kolejke grupami i laczy operacje na tym samym kluczu w jedna
+/// operacje wypadkowa. Operacje wypadkowe grupy zapisywane sa jako jedna wersja drzewa (patrz
+/// PersistentTree::update), wiec zadna wersja nie zawiera czesci grupy, a wszystkie future grupy
+/// otrzymuja te wersje.
+/// Dopoki istnieje front zapisu, drzewo moze byc modyfikowane tylko przez niego.
+/// </summary>
+template<class Tree>
+class TreeWriter
+{
+	typedef typename Tree::value_type Type;
+	typedef typename Tree::value_compare OrderFunctor;
+
+	/// <summary>
+	/// Rodzaj operacji zapisu
+	/// </summary>
+	typedef typename Tree::UpdateKind Kind;
+
+	/// <summary>
+	/// Operacja wypadkowa na jednym kluczu
+	/// </summary>
+	typedef typename Tree::Update Change;
+
+	/// <summary>
+	/// Operacja czekajaca w kolejce wraz z obietnica numeru wersji
+	/// </summary>
+	struct Operation
+	{
+		Kind kind;
+		Type value;
+		std::promise<int> promise;
+
+		Operation(Kind kind, Type const & value) : kind(kind), value(value)
+		{
+		}
+	};
+
+	Tree & _tree;
+	OrderFunctor orderFunctor;
+	MpscQueue<Operation*> _queue;
+	std::size_t _groupSize;
+
+	/// <summary>
+	/// Ostatnia wersja zatwierdzonej grupy
+	/// </summary>
+	std::atomic<int> _published;
+
+	/// <summary>
+	/// Wywolywana w watku aplikujacym po kazdej zatwierdzonej grupie, zanim producenci otrzymaja jej wersje
+	/// </summary>
+	std::function<void(int)> _onPublish;
+	std::atomic<bool> _stop;
+
+	/// <summary>
+	/// Ustawiane przez watek aplikujacy przed zasnieciem. Producent budzi go tylko wtedy, gdy spi,
+	/// wiec w czasie ciaglej pracy wstawienie do kolejki nie dotyka muteksu. Watek aplikujacy ustawia
+	/// znacznik przed sprawdzeniem kolejki, a producent odczytuje go po wstawieniu, i obie strony uzywaja
+	/// operacji sekwencyjnie spojnych, dlatego watek zasypia tylko wtedy, gdy producent go obudzi.
+	/// </summary>
+	std::atomic<bool> _sleeping;
+	std::mutex _sleepMutex;
+	std::condition_variable _wakeUp;
+	std::thread _applier;
+
+public:
+	/// <summary>
+	/// Najwieksza domyslna liczba operacji w jednej grupie
+	/// </summary>
+	static const std::size_t DEFAULT_GROUP_SIZE = 4096;
+
+	/// <summary>
+	/// Tworzy front zapisu i uruchamia watek aplikujacy.
+	/// </summary>
+	/// <param name="tree">Drzewo, do ktorego trafiaja operacje.</param>
+	/// <param name="groupSize">Najwieksza liczba operacji w jednej grupie.</param>
+	/// <param name="onPublish">Funkcja wywolywana z wersja kazdej zatwierdzonej grupy. Jest wykonywana w watku aplikujacym,
+	/// gdy drzewo nie jest modyfikowane, wiec moze je czytac, np. zapisujac widok wersji.</param>
+	explicit TreeWriter(Tree & tree, std::size_t groupSize = DEFAULT_GROUP_SIZE, std::function<void(int)> onPublish = std::function<void(int)>())
+		: _tree(tree), _groupSize(std::max<std::size_t>(groupSize, 1)), _published(tree.getCurrentVersion()), _onPublish(onPublish), _stop(false), _sleeping(false)
+	{
+		_applier = std::thread([this] { run(); });
+	}
+
+	/// <summary>
+	/// Wykonuje wszystkie operacje pozostale w kolejce i zatrzymuje watek aplikujacy.
+	/// </summary>
+	~TreeWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_sleepMutex);
+			_stop = true;
+		}
+		_wakeUp.notify_one();
+		_applier.join();
+	}
+
+	TreeWriter(TreeWriter const &) = delete;
+	TreeWriter & operator = (TreeWriter const &) = delete;
+
+	/// <summary>
+	/// Zleca wstawienie wartosci. Wartosc rownowazna istniejacej nie zmienia drzewa.
+	/// </summary>
+	/// <param name="value">Wartosc do umieszczenia.</param>
+	/// <returns>Future z numerem wersji grupy, w ktorej operacja zostala wykonana.</returns>
+	std::future<int> insert(Type const & value)
+	{
+		return submit(Kind::Insert, value);
+	}
+
+	/// <summary>
+	/// Zleca usuniecie elementu rownowaznego podanej wartosci.
+	/// </summary>
+	/// <param name="value">Wartosc do usuniecia.</param>
+	/// <returns>Future z numerem wersji grupy, w ktorej operacja zostala wykonana.</returns>
+	std::future<int> erase(Type const & value)
+	{
+		return submit(Kind::Erase, value);
+	}
+
+	/// <summary>
+	/// Zleca zastapienie elementu rownowaznego podanej wartosci albo jej wstawienie, gdy takiego nie ma.
+	/// </summary>
+	/// <param name="value">Nowa wartosc.</param>
+	/// <returns>Future z numerem wersji grupy, w ktorej operacja zostala wykonana.</returns>
+	std::future<int> assign(Type const & value)
+	{
+		return submit(Kind::Assign, value);
+	}
+
+	/// <summary>
+	/// Zwraca wersje ostatniej zatwierdzonej grupy.
+	/// </summary>
+	/// <returns></returns>
+	int getPublishedVersion() const
+	{
+		return _published.load(std::memory_order_acquire);
+	}
+
+private:
+	std::future<int> submit(Kind kind, Type const & value)
+	{
+		Operation * operation = new Operation(kind, value);
+		std::future<int> result = operation->promise.get_future();
+		_queue.push(operation);
+		if (_sleeping.load())
+		{
+			std::lock_guard<std::mutex> lock(_sleepMutex);
+			_wakeUp.notify_one();
+		}
+		return result;
+	}
+
+	/// <summary>
+	/// Petla watku aplikujacego.
+	/// </summary>
+	void run()
+	{
+		std::vector<Operation*> group;
+		group.reserve(_groupSize);
+		while (true)
+		{
+			Operation * operation;
+			while (group.size() < _groupSize && _queue.pop(operation))
+				group.push_back(operation);
+			if (!group.empty())
+			{
+				apply(group);
+				group.clear();
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(_sleepMutex);
+			if (_stop && _queue.empty())
+				return;
+			_sleeping = true;
+			// komorka, ktorej producent jeszcze nie dopial, czyni kolejke niepusta, wiec watek nie zasypia
+			_wakeUp.wait(lock, [this] { return _stop || !_queue.empty(); });
+			_sleeping = false;
+		}
+	}
+
+	/// <summary>
+	/// Wykonuje grupe operacji i spelnia ich obietnice.
+	/// </summary>
+	/// <param name="group">Operacje w kolejnosci zgloszenia.</param>
+	void apply(std::vector<Operation*> & group)
+	{
+		std::vector<std::size_t> order(group.size());
+		std::iota(order.begin(), order.end(), 0);
+		// sortowanie stabilne zachowuje kolejnosc zgloszen operacji na tym samym kluczu
+		std::stable_sort(order.begin(), order.end(), [this, &group](std::size_t lhs, std::size_t rhs)
+		{
+			return orderFunctor(group[lhs]->value, group[rhs]->value);
+		});
+		try
+		{
+			std::vector<Change> changes;
+			std::size_t first = 0;
+			while (first < order.size())
+			{
+				std::size_t last = first + 1;
+				while (last < order.size() && !orderFunctor(group[order[first]]->value, group[order[last]]->value))
+					++last;
+				changes.push_back(coalesce(group, order, first, last));
+				first = last;
+			}
+			// pojedyncza zmiana tworzy najwyzej jedna wersje takze wykonana wprost
+			if (changes.size() == 1)
+				execute(changes.front());
+			else
+				_tree.update(changes);
+		}
+		catch (...)
+		{
+			std::exception_ptr error = std::current_exception();
+			for (Operation * operation : group)
+			{
+				operation->promise.set_exception(error);
+				delete operation;
+			}
+			return;
+		}
+		int version = _tree.getCurrentVersion();
+		if (_onPublish)
+			_onPublish(version);
+		_published.store(version, std::memory_order_release);
+		for (Operation * operation : group)
+		{
+			operation->promise.set_value(version);
+			delete operation;
+		}
+	}
+
+	/// <summary>
+	/// Laczy operacje na jednym kluczu w operacje wypadkowa.
+	/// Wstawienie po usunieciu daje przypisanie, a wstawienie po wstawieniu lub przypisaniu nic nie zmienia.
+	/// </summary>
+	/// <param name="group">Operacje grupy.</param>
+	/// <param name="order">Indeksy operacji uporzadkowane wedlug kluczy.</param>
+	/// <param name="first">Poczatek przedzialu operacji na kluczu.</param>
+	/// <param name="last">Koniec przedzialu operacji na kluczu.</param>
+	/// <returns></returns>
+	Change coalesce(std::vector<Operation*> const & group, std::vector<std::size_t> const & order, std::size_t first, std::size_t last) const
+	{
+		Kind kind = group[order[first]]->kind;
+		Type const * value = &group[order[first]]->value;
+		for (std::size_t i = first + 1; i < last; ++i)
+		{
+			Operation const * operation = group[order[i]];
+			if (operation->kind == Kind::Insert)
+			{
+				if (kind != Kind::Erase)
+					continue;
+				kind = Kind::Assign;
+			}
+			else
+			{
+				kind = operation->kind;
+			}
+			value = &operation->value;
+		}
+		return Change(kind, value);
+	}
+
+	/// <summary>
+	/// Wykonuje operacje wypadkowa na drzewie.
+	/// </summary>
+	/// <param name="change">Operacja wypadkowa.</param>
+	void execute(Change const & change)
+	{
+		switch (change.first)
+		{
+		case Kind::Insert:
+			_tree.insert(*change.second);
+			break;
+		case Kind::Erase:
+			_tree.erase(*change.second);
+			break;
+		case Kind::Assign:
+			if (!_tree.replace(*change.second))
+				_tree.insert(*change.second);
+			break;
+		}
+	}
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Znacznik czasu albo identyfikator commitu przypisywany wersji drzewa.
+/// Znaczniki kolejnych wersji musza byc niemalejace.
+/// </summary>
+struct Timestamp
+{
+	long long value;
+
+	explicit Timestamp(long long value) : value(value)
+	{
+	}
+};
+
+/// <summary>
+/// Indeks wiazacy znaczniki czasu z numerami wersji.
+/// Wpisy sa dopisywane w kolejnosci rosnacych wersji, wiec wektor jest posortowany
+/// i wersje dla znacznika wyszukuje sie binarnie.
+/// </summary>
+class VersionIndex
+{
+	/// <summary>
+	/// Pary znacznik czasu - numer wersji, posortowane wg obu wartosci.
+	/// </summary>
+	std::vector<std::pair<long long, int>> _entries;
+
+public:
+	/// <summary>
+	/// Identyfikator zwracany, gdy zadna wersja nie powstala przed podanym znacznikiem
+	/// </summary>
+	static const int NO_VERSION = -2;
+
+	/// <summary>
+	/// Przypisuje znacznik czasu wersji. Ponowne oznaczenie ostatniej wersji zastepuje jej znacznik.
+	/// </summary>
+	/// <param name="timestamp">Znacznik czasu.</param>
+	/// <param name="version">Wersja.</param>
+	/// <returns>False, jezeli znacznik lub wersja sa mniejsze niz ostatnio zapisane.</returns>
+	bool add(Timestamp timestamp, int version)
+	{
+		if (!_entries.empty())
+		{
+			std::pair<long long, int> & last = _entries.back();
+			if (version < last.second)
+				return false;
+			if (version == last.second)
+			{
+				if (_entries.size() > 1 && timestamp.value < _entries[_entries.size() - 2].first)
+					return false;
+				last.first = timestamp.value;
+				return true;
+			}
+			if (timestamp.value < last.first)
+				return false;
+		}
+		_entries.push_back(std::make_pair(timestamp.value, version));
+		return true;
+	}
+
+	/// <summary>
+	/// Zwraca najnowsza wersje oznaczona znacznikiem nie pozniejszym niz podany.
+	/// </summary>
+	/// <param name="timestamp">Znacznik czasu.</param>
+	/// <returns>Numer wersji albo NO_VERSION, jezeli wszystkie wersje sa pozniejsze.</returns>
+	int versionAt(Timestamp timestamp) const
+	{
+		auto it = std::upper_bound(_entries.begin(), _entries.end(), timestamp.value,
+			[](long long value, std::pair<long long, int> const & entry) { return value < entry.first; });
+		if (it == _entries.begin())
+			return NO_VERSION;
+		return (it - 1)->second;
+	}
+
+	void clear()
+	{
+		_entries.clear();
+	}
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+/// <summary>
+/// Statystyki jednej wersji drzewa zapisywane przy jej tworzeniu: liczba elementow, najmniejszy
+/// i najwiekszy element oraz wysokosc, czyli liczba poziomow na najdluzszej sciezce od korzenia.
+/// Wskazniki prowadza do wartosci wezlow tej wersji i sa wazne, dopoki wersja nie zostanie zarchiwizowana.
+/// Wartosc UNKNOWN oznacza, ze statystyka nie zostala zapisana i trzeba ja wyznaczyc z drzewa.
+/// </summary>
+template<class Type>
+struct VersionStatistics
+{
+	static const int UNKNOWN = -1;
+
+	/// <summary>
+	/// Liczba elementow. Jezeli jest znana, znane sa tez najmniejszy i najwiekszy element.
+	/// </summary>
+	int size;
+	Type const * min;
+	Type const * max;
+	int height;
+
+	VersionStatistics() : size(UNKNOWN), min(nullptr), max(nullptr), height(UNKNOWN)
+	{
+	}
+
+	/// <summary>
+	/// Zwraca statystyki pustej wersji.
+	/// </summary>
+	/// <returns></returns>
+	static VersionStatistics empty()
+	{
+		VersionStatistics statistics;
+		statistics.size = 0;
+		statistics.height = 0;
+		return statistics;
+	}
+
+	bool isKnown() const
+	{
+		return size != UNKNOWN;
+	}
+
+	bool isHeightKnown() const
+	{
+		return height != UNKNOWN;
+	}
+};